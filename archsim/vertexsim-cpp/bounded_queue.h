@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace vertexsim {
+
+   /// Blocking multi-producer, multi-consumer FIFO with a fixed capacity.
+   /// Producers wait while it is full, which bounds the memory held by work
+   /// that is produced faster than it is consumed.
+   template <typename T>
+   class BoundedQueue {
+   public:
+      explicit BoundedQueue(std::size_t capacity) : capacity_{capacity} {}
+
+      /// Blocks while the queue is full. Returns false, dropping `value`, if
+      /// the queue was closed.
+      bool Push(T value) {
+         std::unique_lock lock{mutex_};
+         not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+         if (closed_) return false;
+         items_.push_back(std::move(value));
+         not_empty_.notify_one();
+         return true;
+      }
+
+      /// Blocks while the queue is empty. Returns nullopt once the queue is
+      /// closed and drained.
+      std::optional<T> Pop() {
+         std::unique_lock lock{mutex_};
+         not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+         if (items_.empty()) return std::nullopt;
+         T value = std::move(items_.front());
+         items_.pop_front();
+         not_full_.notify_one();
+         return value;
+      }
+
+      /// Wakes all waiters. Pending items can still be popped.
+      void Close() {
+         std::lock_guard lock{mutex_};
+         closed_ = true;
+         not_full_.notify_all();
+         not_empty_.notify_all();
+      }
+
+   private:
+      std::size_t const capacity_;
+      std::mutex mutex_;
+      std::condition_variable not_full_;
+      std::condition_variable not_empty_;
+      std::deque<T> items_;
+      bool closed_ = false;
+   };
+
+} // namespace vertexsim
@@ -1,5 +1,81 @@
+find_package(Threads REQUIRED)
+find_package(Stb REQUIRED)
+find_package(lz4 CONFIG REQUIRED)
+
+if(CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64|amd64")
+   set(VERTEXSIM_SIMD_DEFAULT "AVX2")
+else()
+   set(VERTEXSIM_SIMD_DEFAULT "NONE")
+endif()
+set(VERTEXSIM_SIMD ${VERTEXSIM_SIMD_DEFAULT} CACHE STRING "Instruction set for vertexsim hot paths")
+set_property(CACHE VERTEXSIM_SIMD PROPERTY STRINGS NONE SSE4.2 AVX2 AVX512)
+
+if(VERTEXSIM_SIMD STREQUAL "AVX512")
+   if(MSVC)
+      set(VERTEXSIM_SIMD_FLAGS /arch:AVX512)
+   else()
+      set(VERTEXSIM_SIMD_FLAGS -mavx512f -mavx512vl -mavx512bw -mavx512dq -mavx2 -mfma -mbmi
+                               -mbmi2 -mf16c)
+   endif()
+elseif(VERTEXSIM_SIMD STREQUAL "AVX2")
+   if(MSVC)
+      set(VERTEXSIM_SIMD_FLAGS /arch:AVX2)
+   else()
+      set(VERTEXSIM_SIMD_FLAGS -mavx2 -mfma -mbmi -mbmi2 -mf16c)
+   endif()
+elseif(VERTEXSIM_SIMD STREQUAL "SSE4.2")
+   if(MSVC)
+      # MSVC has no SSE4.2 switch, x64 builds only need the define
+      set(VERTEXSIM_SIMD_FLAGS /D__SSE4_2__)
+   else()
+      set(VERTEXSIM_SIMD_FLAGS -msse4.2)
+   endif()
+endif()
+
 add_executable(
     vertexsim-cpp
     ${CMAKE_CURRENT_LIST_DIR}/main.cc
+    ${CMAKE_CURRENT_LIST_DIR}/clipper.cc
+    ${CMAKE_CURRENT_LIST_DIR}/command_list.cc
+    ${CMAKE_CURRENT_LIST_DIR}/command_processor.cc
+    ${CMAKE_CURRENT_LIST_DIR}/command_trace.cc
+    ${CMAKE_CURRENT_LIST_DIR}/frame_arena.cc
+    ${CMAKE_CURRENT_LIST_DIR}/gpu_device.cc
+    ${CMAKE_CURRENT_LIST_DIR}/gpu_driver.cc
+    ${CMAKE_CURRENT_LIST_DIR}/hash.cc
+    ${CMAKE_CURRENT_LIST_DIR}/indexed_mesh.cc
+    ${CMAKE_CURRENT_LIST_DIR}/input_assembler.cc
+    ${CMAKE_CURRENT_LIST_DIR}/mapped_file.cc
+    ${CMAKE_CURRENT_LIST_DIR}/material.cc
+    ${CMAKE_CURRENT_LIST_DIR}/memory_model.cc
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_cache.cc
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_optimizer.cc
+    ${CMAKE_CURRENT_LIST_DIR}/meshlet.cc
+    ${CMAKE_CURRENT_LIST_DIR}/number_scan.cc
+    ${CMAKE_CURRENT_LIST_DIR}/obj_loader.cc
+    ${CMAKE_CURRENT_LIST_DIR}/obj_stream.cc
+    ${CMAKE_CURRENT_LIST_DIR}/pipeline.cc
+    ${CMAKE_CURRENT_LIST_DIR}/post_transform_cache.cc
+    ${CMAKE_CURRENT_LIST_DIR}/primitive_assembler.cc
+    ${CMAKE_CURRENT_LIST_DIR}/quantized_mesh.cc
+    ${CMAKE_CURRENT_LIST_DIR}/query_pool.cc
+    ${CMAKE_CURRENT_LIST_DIR}/staging_ring.cc
+    ${CMAKE_CURRENT_LIST_DIR}/texture.cc
+    ${CMAKE_CURRENT_LIST_DIR}/vertex_transform.cc
+    ${CMAKE_CURRENT_LIST_DIR}/welder.cc
+)
+target_compile_options(vertexsim-cpp PRIVATE ${VERTEXSIM_SIMD_FLAGS})
+target_include_directories(vertexsim-cpp PRIVATE ${Stb_INCLUDE_DIR})
+target_link_libraries(vertexsim-cpp PRIVATE glm::glm-header-only lz4::lz4 Threads::Threads)
+
+add_executable(
+    vertexsim-scan-bench
+    ${CMAKE_CURRENT_LIST_DIR}/scan_bench.cc
+    ${CMAKE_CURRENT_LIST_DIR}/mapped_file.cc
+    ${CMAKE_CURRENT_LIST_DIR}/number_scan.cc
+)
+target_compile_options(vertexsim-scan-bench PRIVATE ${VERTEXSIM_SIMD_FLAGS})
+target_compile_definitions(
+    vertexsim-scan-bench PRIVATE
+    VERTEXSIM_SPONZA_OBJ="${CMAKE_CURRENT_LIST_DIR}/../third-party/sponza-model/sponza.obj"
 )
-target_link_libraries(vertexsim-cpp PRIVATE glm::glm-header-only)
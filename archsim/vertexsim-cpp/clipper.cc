@@ -0,0 +1,284 @@
+#include "clipper.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace vertexsim {
+
+   namespace {
+
+      /// Bit masks of the triangles in a batch of a packet.
+      struct Classification {
+         // Entirely outside one frustum plane
+         std::uint32_t culled = 0;
+         // A vertex outside the near or far plane or the guard band
+         std::uint32_t needs_clip = 0;
+      };
+
+      // Planes as (a, b, c, d) with a x + b y + c z + d w >= 0 inside, in the
+      // order of the outcode bits. The guard band planes scale d.
+      constexpr std::size_t kClipPlaneCount = 6;
+      enum ClipPlane : std::uint32_t {
+         kNear,
+         kFar,
+         kGuardLeft,
+         kGuardRight,
+         kGuardBottom,
+         kGuardTop,
+      };
+
+      std::array<glm::vec4, kClipPlaneCount> PlanesOf(ClipperConfig const& config) {
+         return {{{0, 0, 1, 1},
+                  {0, 0, -1, 1},
+                  {1, 0, 0, config.guard_band_x},
+                  {-1, 0, 0, config.guard_band_x},
+                  {0, 1, 0, config.guard_band_y},
+                  {0, -1, 0, config.guard_band_y}}};
+      }
+
+      glm::vec4 PositionOf(ClipPositionStreams const& positions, std::uint32_t vertex) {
+         return {positions[0][vertex], positions[1][vertex], positions[2][vertex],
+                 positions[3][vertex]};
+      }
+
+      /// Outcodes of the clip planes in the low bits, then those of the
+      /// left, right, bottom and top frustum planes.
+      std::uint32_t OutcodeOf(ClipperConfig const& config, glm::vec4 const& p) {
+         std::uint32_t code = 0;
+         if (p.z < -p.w) code |= 1u << kNear;
+         if (p.z > p.w) code |= 1u << kFar;
+         if (p.x < -config.guard_band_x * p.w) code |= 1u << kGuardLeft;
+         if (p.x > config.guard_band_x * p.w) code |= 1u << kGuardRight;
+         if (p.y < -config.guard_band_y * p.w) code |= 1u << kGuardBottom;
+         if (p.y > config.guard_band_y * p.w) code |= 1u << kGuardTop;
+         if (p.x < -p.w) code |= 1u << (kClipPlaneCount + 0);
+         if (p.x > p.w) code |= 1u << (kClipPlaneCount + 1);
+         if (p.y < -p.w) code |= 1u << (kClipPlaneCount + 2);
+         if (p.y > p.w) code |= 1u << (kClipPlaneCount + 3);
+         return code;
+      }
+
+      constexpr std::uint32_t kClipPlaneMask = (1u << kClipPlaneCount) - 1;
+      // Near, far and the viewport's sides; the guard band is never outside
+      // the viewport, so leaving it is covered by leaving the side
+      constexpr std::uint32_t kFrustumMask =
+            (1u << kNear) | (1u << kFar) | (0xFu << kClipPlaneCount);
+
+      Classification ClassifyScalar(ClipperConfig const& config, PrimitivePacket const& packet,
+                                    ClipPositionStreams const& positions, std::uint32_t i) {
+         std::uint32_t all = ~0u, any = 0;
+         for (std::uint32_t slot = 0; slot < 3; ++slot) {
+            auto const code =
+                  OutcodeOf(config, PositionOf(positions, packet.vertices[slot][i]));
+            all &= code;
+            any |= code;
+         }
+         return {(all & kFrustumMask) != 0 ? 1u : 0u, (any & kClipPlaneMask) != 0 ? 1u : 0u};
+      }
+
+#if defined(__AVX512F__)
+      constexpr std::uint32_t kBatch = 16;
+
+      /// Classifies the triangles in `lanes` of the 16 starting at `i`. Lanes
+      /// left out gather nothing and classify as accepted.
+      Classification Classify16(ClipperConfig const& config, PrimitivePacket const& packet,
+                                ClipPositionStreams const& positions, std::uint32_t i,
+                                __mmask16 lanes) {
+         __m512 const gx = _mm512_set1_ps(config.guard_band_x);
+         __m512 const gy = _mm512_set1_ps(config.guard_band_y);
+         // Triangles with every vertex outside each frustum plane
+         __mmask16 all_left = 0xFFFF, all_right = 0xFFFF, all_bottom = 0xFFFF;
+         __mmask16 all_top = 0xFFFF, all_near = 0xFFFF, all_far = 0xFFFF;
+         __mmask16 any = 0;
+         for (std::uint32_t slot = 0; slot < 3; ++slot) {
+            __m512i const index = _mm512_maskz_loadu_epi32(lanes, packet.vertices[slot].data() + i);
+            __m512 const zero = _mm512_setzero_ps();
+            __m512 const x = _mm512_mask_i32gather_ps(zero, lanes, index, positions[0].data(), 4);
+            __m512 const y = _mm512_mask_i32gather_ps(zero, lanes, index, positions[1].data(), 4);
+            __m512 const z = _mm512_mask_i32gather_ps(zero, lanes, index, positions[2].data(), 4);
+            __m512 const w = _mm512_mask_i32gather_ps(zero, lanes, index, positions[3].data(), 4);
+            __m512 const neg_w = _mm512_sub_ps(_mm512_setzero_ps(), w);
+            __mmask16 const out_near = _mm512_cmp_ps_mask(z, neg_w, _CMP_LT_OQ);
+            __mmask16 const out_far = _mm512_cmp_ps_mask(z, w, _CMP_GT_OQ);
+            __m512 const gxw = _mm512_mul_ps(gx, w);
+            __m512 const gyw = _mm512_mul_ps(gy, w);
+            any |= out_near | out_far;
+            any |= _mm512_cmp_ps_mask(x, _mm512_sub_ps(_mm512_setzero_ps(), gxw), _CMP_LT_OQ);
+            any |= _mm512_cmp_ps_mask(x, gxw, _CMP_GT_OQ);
+            any |= _mm512_cmp_ps_mask(y, _mm512_sub_ps(_mm512_setzero_ps(), gyw), _CMP_LT_OQ);
+            any |= _mm512_cmp_ps_mask(y, gyw, _CMP_GT_OQ);
+            all_near &= out_near;
+            all_far &= out_far;
+            all_left &= _mm512_cmp_ps_mask(x, neg_w, _CMP_LT_OQ);
+            all_right &= _mm512_cmp_ps_mask(x, w, _CMP_GT_OQ);
+            all_bottom &= _mm512_cmp_ps_mask(y, neg_w, _CMP_LT_OQ);
+            all_top &= _mm512_cmp_ps_mask(y, w, _CMP_GT_OQ);
+         }
+         return {static_cast<std::uint32_t>(
+                       (all_left | all_right | all_bottom | all_top | all_near | all_far) & lanes),
+                 static_cast<std::uint32_t>(any & lanes)};
+      }
+#elif defined(__AVX2__)
+      constexpr std::uint32_t kBatch = 8;
+
+      /// Classifies the 8 triangles starting at `i`.
+      Classification Classify8(ClipperConfig const& config, PrimitivePacket const& packet,
+                               ClipPositionStreams const& positions, std::uint32_t i) {
+         __m256 const gx = _mm256_set1_ps(config.guard_band_x);
+         __m256 const gy = _mm256_set1_ps(config.guard_band_y);
+         __m256 const ones = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+         // Triangles with every vertex outside each frustum plane
+         __m256 all_left = ones, all_right = ones, all_bottom = ones;
+         __m256 all_top = ones, all_near = ones, all_far = ones;
+         __m256 any = _mm256_setzero_ps();
+         for (std::uint32_t slot = 0; slot < 3; ++slot) {
+            __m256i const index = _mm256_loadu_si256(
+                  reinterpret_cast<__m256i const*>(packet.vertices[slot].data() + i));
+            __m256 const x = _mm256_i32gather_ps(positions[0].data(), index, 4);
+            __m256 const y = _mm256_i32gather_ps(positions[1].data(), index, 4);
+            __m256 const z = _mm256_i32gather_ps(positions[2].data(), index, 4);
+            __m256 const w = _mm256_i32gather_ps(positions[3].data(), index, 4);
+            __m256 const neg_w = _mm256_sub_ps(_mm256_setzero_ps(), w);
+            __m256 const out_near = _mm256_cmp_ps(z, neg_w, _CMP_LT_OQ);
+            __m256 const out_far = _mm256_cmp_ps(z, w, _CMP_GT_OQ);
+            __m256 const gxw = _mm256_mul_ps(gx, w);
+            __m256 const gyw = _mm256_mul_ps(gy, w);
+            __m256 const out_guard = _mm256_or_ps(
+                  _mm256_or_ps(
+                        _mm256_cmp_ps(x, _mm256_sub_ps(_mm256_setzero_ps(), gxw), _CMP_LT_OQ),
+                        _mm256_cmp_ps(x, gxw, _CMP_GT_OQ)),
+                  _mm256_or_ps(
+                        _mm256_cmp_ps(y, _mm256_sub_ps(_mm256_setzero_ps(), gyw), _CMP_LT_OQ),
+                        _mm256_cmp_ps(y, gyw, _CMP_GT_OQ)));
+            any = _mm256_or_ps(any, _mm256_or_ps(_mm256_or_ps(out_near, out_far), out_guard));
+            all_near = _mm256_and_ps(all_near, out_near);
+            all_far = _mm256_and_ps(all_far, out_far);
+            all_left = _mm256_and_ps(all_left, _mm256_cmp_ps(x, neg_w, _CMP_LT_OQ));
+            all_right = _mm256_and_ps(all_right, _mm256_cmp_ps(x, w, _CMP_GT_OQ));
+            all_bottom = _mm256_and_ps(all_bottom, _mm256_cmp_ps(y, neg_w, _CMP_LT_OQ));
+            all_top = _mm256_and_ps(all_top, _mm256_cmp_ps(y, w, _CMP_GT_OQ));
+         }
+         __m256 const culled =
+               _mm256_or_ps(_mm256_or_ps(_mm256_or_ps(all_left, all_right),
+                                         _mm256_or_ps(all_bottom, all_top)),
+                            _mm256_or_ps(all_near, all_far));
+         return {static_cast<std::uint32_t>(_mm256_movemask_ps(culled)),
+                 static_cast<std::uint32_t>(_mm256_movemask_ps(any))};
+      }
+#else
+      constexpr std::uint32_t kBatch = 1;
+#endif
+
+      // A triangle gains at most one vertex per plane
+      constexpr std::size_t kMaxClipVertices = 3 + kClipPlaneCount;
+
+      /// Clips triangle `i` of the packet against the planes it crosses and
+      /// hands the resulting fan to `on_clipped`. Returns its triangle count.
+      std::uint32_t ClipTriangle(ClipperConfig const& config, PrimitivePacket const& packet,
+                                 ClipPositionStreams const& positions, std::uint32_t i,
+                                 ClippedTriangleHandler const& on_clipped) {
+         std::array<ClipVertex, kMaxClipVertices> polygon, next;
+         std::uint32_t crossed = 0;
+         for (std::uint32_t slot = 0; slot < 3; ++slot) {
+            polygon[slot].position = PositionOf(positions, packet.vertices[slot][i]);
+            polygon[slot].barycentric = {};
+            polygon[slot].barycentric[slot] = 1;
+            crossed |= OutcodeOf(config, polygon[slot].position);
+         }
+         std::size_t count = 3;
+         auto const planes = PlanesOf(config);
+         for (std::size_t p = 0; p < kClipPlaneCount && count > 0; ++p) {
+            if (!(crossed & (1u << p))) continue;
+            // Sutherland-Hodgman: keep inside vertices and add one where
+            // each edge crosses the plane
+            std::size_t kept = 0;
+            for (std::size_t v = 0; v < count; ++v) {
+               ClipVertex const& a = polygon[v];
+               ClipVertex const& b = polygon[(v + 1) % count];
+               float const da = glm::dot(planes[p], a.position);
+               float const db = glm::dot(planes[p], b.position);
+               if (da >= 0) next[kept++] = a;
+               if ((da >= 0) != (db >= 0)) {
+                  float const t = da / (da - db);
+                  next[kept++] = {glm::mix(a.position, b.position, t),
+                                  glm::mix(a.barycentric, b.barycentric, t)};
+               }
+            }
+            polygon = next;
+            count = kept;
+         }
+         if (count < 3) return 0;
+         if (on_clipped) {
+            for (std::size_t v = 1; v + 1 < count; ++v) {
+               std::array<ClipVertex, 3> const triangle{polygon[0], polygon[v], polygon[v + 1]};
+               on_clipped(i, triangle);
+            }
+         }
+         return static_cast<std::uint32_t>(count - 2);
+      }
+
+   } // namespace
+
+   Clipper::Clipper(ClipperConfig const& config) : config_{config} {
+      if (!(config.guard_band_x >= 1 && config.guard_band_y >= 1))
+         throw std::invalid_argument("Guard band must cover the viewport");
+   }
+
+   ClipResult Clipper::Clip(PrimitivePacket const& packet, ClipPositionStreams const& positions,
+                            ClippedTriangleHandler const& on_clipped) {
+      if (packet.vertices_per_primitive != 3)
+         throw std::invalid_argument("Only triangles are clipped");
+      std::size_t const vertex_count = positions[0].size();
+      for (auto const& stream : positions)
+         if (stream.size() != vertex_count)
+            throw std::invalid_argument("Clip position streams differ in length");
+      for (std::uint32_t slot = 0; slot < 3; ++slot)
+         for (std::uint32_t i = 0; i < packet.count; ++i)
+            if (packet.vertices[slot][i] >= vertex_count)
+               throw std::out_of_range("Primitive vertex past the clip position streams");
+
+      Classification classes;
+      std::uint32_t i = 0;
+#if defined(__AVX512F__)
+      // Masked gathers take the partial last batch too
+      for (; i < packet.count; i += kBatch) {
+         std::uint32_t const lanes = std::min(kBatch, packet.count - i);
+         auto const batch = Classify16(config_, packet, positions, i,
+                                       static_cast<__mmask16>((1u << lanes) - 1));
+         classes.culled |= batch.culled << i;
+         classes.needs_clip |= batch.needs_clip << i;
+      }
+#elif defined(__AVX2__)
+      for (; i + kBatch <= packet.count; i += kBatch) {
+         auto const batch = Classify8(config_, packet, positions, i);
+         classes.culled |= batch.culled << i;
+         classes.needs_clip |= batch.needs_clip << i;
+      }
+#endif
+      for (; i < packet.count; ++i) {
+         auto const one = ClassifyScalar(config_, packet, positions, i);
+         classes.culled |= one.culled << i;
+         classes.needs_clip |= one.needs_clip << i;
+      }
+
+      std::uint32_t const all = packet.count == 32 ? ~0u : (1u << packet.count) - 1;
+      ClipResult result;
+      result.accepted = all & ~classes.culled & ~classes.needs_clip;
+      result.clipped = all & ~classes.culled & classes.needs_clip;
+      stats_.triangles += packet.count;
+      stats_.accepted += std::popcount(result.accepted);
+      stats_.culled += std::popcount(all & classes.culled);
+      stats_.clipped += std::popcount(result.clipped);
+      for (std::uint32_t bits = result.clipped; bits != 0; bits &= bits - 1) {
+         stats_.clipped_output += ClipTriangle(config_, packet, positions,
+                                               std::countr_zero(bits), on_clipped);
+      }
+      return result;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <span>
+
+#include "primitive_assembler.h"
+
+namespace vertexsim {
+
+   /// Clip-space x, y, z and w, indexed by vertex, as TransformVertices()
+   /// writes them.
+   using ClipPositionStreams = std::array<std::span<float const>, 4>;
+
+   struct ClipperConfig {
+      // Half-extent of the guard band in multiples of the viewport's, per
+      // axis. The rasterizer must handle window coordinates this far out.
+      float guard_band_x = 8;
+      float guard_band_y = 8;
+   };
+
+   struct ClipStats {
+      std::uint64_t triangles = 0;
+      // Inside the guard band and depth range; rasterized as is
+      std::uint64_t accepted = 0;
+      // Entirely outside one frustum plane
+      std::uint64_t culled = 0;
+      // Crossing the near or far plane or the guard band
+      std::uint64_t clipped = 0;
+      // Triangles produced by clipping, none for triangles clipped away
+      std::uint64_t clipped_output = 0;
+
+      /// Fraction of the triangles that needed real clipping.
+      double clipped_fraction() const {
+         return triangles ? static_cast<double>(clipped) / triangles : 0;
+      }
+
+      ClipStats& operator+=(ClipStats const& other) {
+         triangles += other.triangles;
+         accepted += other.accepted;
+         culled += other.culled;
+         clipped += other.clipped;
+         clipped_output += other.clipped_output;
+         return *this;
+      }
+   };
+
+   /// A vertex created by clipping: its clip position and its weights of
+   /// the original triangle's vertices, slot order, to interpolate the
+   /// other attributes with.
+   struct ClipVertex {
+      glm::vec4 position;
+      glm::vec3 barycentric;
+   };
+
+   /// Called with each triangle of a clipped primitive's fan; `primitive` is
+   /// its index in the packet. The winding is that of the primitive.
+   using ClippedTriangleHandler =
+         std::function<void(std::uint32_t primitive, std::span<ClipVertex const, 3> triangle)>;
+
+   /// Bit i per primitive i of the packet.
+   struct ClipResult {
+      std::uint32_t accepted = 0;
+      std::uint32_t clipped = 0;
+   };
+   static_assert(kPrimitivePacketSize <= 32);
+
+   /// Homogeneous clipper for triangles, OpenGL conventions: inside is
+   /// -w <= x, y, z <= w. Only the near and far planes and the guard band
+   /// are clipped against; triangles that merely leave the viewport are
+   /// left to the rasterizer's scissor. Triangles are classified a SIMD
+   /// batch at a time, so only those needing real clipping take the slow
+   /// path.
+   class Clipper {
+   public:
+      /// Throws std::invalid_argument unless the guard band covers the
+      /// viewport.
+      explicit Clipper(ClipperConfig const& config = {});
+
+      /// Classifies the triangles of `packet` and clips those that need it,
+      /// passing their pieces to `on_clipped` if set. Throws
+      /// std::invalid_argument for packets of points or lines and
+      /// std::out_of_range for vertices past the streams.
+      ClipResult Clip(PrimitivePacket const& packet, ClipPositionStreams const& positions,
+                      ClippedTriangleHandler const& on_clipped = {});
+
+      ClipperConfig const& config() const { return config_; }
+      ClipStats const& stats() const { return stats_; }
+
+   private:
+      ClipperConfig config_;
+      ClipStats stats_;
+   };
+
+} // namespace vertexsim
@@ -0,0 +1,22 @@
+#include "command_list.h"
+
+namespace vertexsim {
+
+   std::span<std::byte> CommandList::BeginCommand(std::size_t size) {
+      std::byte* const p = arena_->Allocate(size, kCommandAlignment);
+      // Consecutive packets usually land next to each other, unless the
+      // arena moved to a new chunk or another list allocated in between
+      if (!segments_.empty() && segments_.back().data() + segments_.back().size() == p)
+         segments_.back() = {segments_.back().data(), segments_.back().size() + size};
+      else
+         segments_.push_back({p, size});
+      return {p, size};
+   }
+
+   std::size_t CommandList::size_bytes() const {
+      std::size_t size = 0;
+      for (auto const& segment : segments_) size += segment.size();
+      return size;
+   }
+
+} // namespace vertexsim
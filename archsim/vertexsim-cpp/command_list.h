@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "frame_arena.h"
+#include "gpu_command.h"
+
+namespace vertexsim {
+
+   /// Host-side optimizations applied while commands are recorded.
+   struct RecordingOptions {
+      // Drop state changes and bindings that rewrite what is already bound
+      bool filter_redundant_state = true;
+      // Merge runs of draws with nothing in between into multi-draw packets
+      bool coalesce_draws = false;
+   };
+
+   struct RecordingStats {
+      // Recording calls made and packets they turned into
+      std::uint64_t commands = 0;
+      std::uint64_t packets = 0;
+      std::uint64_t redundant_state = 0;
+      // Draws that rode along in another draw's multi-draw packet
+      std::uint64_t coalesced_draws = 0;
+
+      std::uint64_t eliminated() const { return redundant_state + coalesced_draws; }
+
+      RecordingStats& operator+=(RecordingStats const& other) {
+         commands += other.commands;
+         packets += other.packets;
+         redundant_state += other.redundant_state;
+         coalesced_draws += other.coalesced_draws;
+         return *this;
+      }
+   };
+
+   /// Recording methods shared by immediate submission and command lists.
+   /// `Derived` provides BeginCommand(size), returning the bytes to encode
+   /// into, EndCommand() and max_command_size().
+   ///
+   /// The encoder shadows the state its stream has bound so far, like a
+   /// driver's dirty tracking, so setting a register or binding to the value
+   /// it already holds emits nothing. With draw coalescing, draws are held
+   /// back until something other than a draw is recorded or Flush() is
+   /// called.
+   template <typename Derived>
+   class CommandEncoder {
+   public:
+      static constexpr std::uint32_t kMaxDrawBatch = 64;
+
+      explicit CommandEncoder(RecordingOptions const& options = {}) : options_{options} {
+         InvalidateState();
+      }
+
+      void SetState(RenderState state, std::uint32_t value) {
+         ++stats_.commands;
+         auto const i = static_cast<std::size_t>(state);
+         if (i < kRenderStateCount) {
+            if (options_.filter_redundant_state && state_[i] == value) {
+               ++stats_.redundant_state;
+               return;
+            }
+            state_[i] = value;
+         }
+         // The registers no longer match the pipeline, so binding it again
+         // is not redundant
+         pipeline_.reset();
+         Encode(SetStateCommand{state, 0, value});
+      }
+      /// Sets every render state register from `pipeline`.
+      void BindPipeline(PipelineHandle pipeline) {
+         ++stats_.commands;
+         if (options_.filter_redundant_state && pipeline_ == pipeline) {
+            ++stats_.redundant_state;
+            return;
+         }
+         pipeline_ = pipeline;
+         // The encoder cannot see the pipeline's register values
+         state_.fill(kUnknownState);
+         Encode(BindPipelineCommand{pipeline, 0});
+      }
+      void BindVertexBuffer(std::uint32_t slot, BufferHandle buffer, std::uint64_t offset,
+                            std::uint32_t stride) {
+         ++stats_.commands;
+         BindVertexBufferCommand const command{slot, buffer, offset, stride, 0};
+         if (slot < kMaxVertexBuffers) {
+            auto& bound = vertex_buffers_[slot];
+            if (options_.filter_redundant_state && bound && bound->buffer == buffer &&
+                bound->offset == offset && bound->stride == stride) {
+               ++stats_.redundant_state;
+               return;
+            }
+            bound = command;
+         }
+         Encode(command);
+      }
+      void BindIndexBuffer(BufferHandle buffer, std::uint64_t offset, IndexFormat format) {
+         ++stats_.commands;
+         BindIndexBufferCommand const command{buffer, format, {}, offset};
+         if (options_.filter_redundant_state && index_buffer_ && index_buffer_->buffer == buffer &&
+             index_buffer_->offset == offset && index_buffer_->format == format) {
+            ++stats_.redundant_state;
+            return;
+         }
+         index_buffer_ = command;
+         Encode(command);
+      }
+      /// Copies `data` into the command stream; the buffer is written when
+      /// the GPU reaches the command.
+      void UpdateBuffer(BufferHandle buffer, std::uint64_t offset,
+                        std::span<std::byte const> data) {
+         ++stats_.commands;
+         // Large updates are split so each packet fits
+         std::size_t const max_chunk = self().max_command_size() -
+                                       CommandSize<UpdateBufferCommand>() - kCommandAlignment;
+         for (std::size_t done = 0; done < data.size();) {
+            std::size_t const chunk = std::min(max_chunk, data.size() - done);
+            Encode(UpdateBufferCommand{buffer, 0, offset + done, chunk}, data.subspan(done, chunk));
+            done += chunk;
+         }
+      }
+      void CopyBuffer(BufferHandle src, std::uint64_t src_offset, BufferHandle dst,
+                      std::uint64_t dst_offset, std::uint64_t size) {
+         ++stats_.commands;
+         Encode(CopyBufferCommand{src, dst, src_offset, dst_offset, size});
+      }
+      void Draw(std::uint32_t vertex_count, std::uint32_t instance_count = 1,
+                std::uint32_t first_vertex = 0, std::uint32_t first_instance = 0) {
+         ++stats_.commands;
+         DrawCommand const command{vertex_count, instance_count, first_vertex, first_instance};
+         if (!options_.coalesce_draws) return Encode(command);
+         if (pending_indexed_) Flush();
+         draws_[pending_++] = command;
+         if (pending_ == kMaxDrawBatch) Flush();
+      }
+      void DrawIndexed(std::uint32_t index_count, std::uint32_t instance_count = 1,
+                       std::uint32_t first_index = 0, std::int32_t vertex_offset = 0,
+                       std::uint32_t first_instance = 0) {
+         ++stats_.commands;
+         DrawIndexedCommand const command{index_count, instance_count, first_index,
+                                          vertex_offset, first_instance};
+         if (!options_.coalesce_draws) return Encode(command);
+         if (pending_ != 0 && !pending_indexed_) Flush();
+         pending_indexed_ = true;
+         indexed_draws_[pending_++] = command;
+         if (pending_ == kMaxDrawBatch) Flush();
+      }
+      /// Draws with arguments from buffer memory; see DrawIndirectCommand.
+      void DrawIndirect(BufferHandle buffer, std::uint64_t offset, std::uint32_t draw_count = 1,
+                        std::uint32_t stride = sizeof(DrawCommand)) {
+         ++stats_.commands;
+         Encode(DrawIndirectCommand{buffer, draw_count, offset, stride, 0});
+      }
+      /// Up to `max_draw_count` indexed draws with arguments from buffer
+      /// memory. When `count_buffer` is given, the draw count is read from
+      /// it at `count_offset` when the GPU executes the command.
+      void MultiDrawIndexedIndirect(BufferHandle buffer, std::uint64_t offset,
+                                    std::uint32_t max_draw_count,
+                                    std::uint32_t stride = sizeof(DrawIndexedCommand),
+                                    std::optional<BufferHandle> count_buffer = std::nullopt,
+                                    std::uint64_t count_offset = 0) {
+         ++stats_.commands;
+         Encode(MultiDrawIndexedIndirectCommand{
+               buffer, count_buffer.value_or(BufferHandle{}), offset, count_offset,
+               max_draw_count, stride, count_buffer ? kIndirectCountBuffer : 0u, 0});
+      }
+      void SignalFence(FenceHandle fence, std::uint64_t value) {
+         ++stats_.commands;
+         Encode(SignalFenceCommand{fence, 0, value});
+      }
+      void WriteTimestamp(QueryPoolHandle pool, std::uint32_t query) {
+         ++stats_.commands;
+         Encode(WriteTimestampCommand{pool, query});
+      }
+      /// Occlusion and pipeline-statistics queries count the draws between
+      /// BeginQuery() and EndQuery() on the same queue.
+      void BeginQuery(QueryPoolHandle pool, std::uint32_t query) {
+         ++stats_.commands;
+         Encode(BeginQueryCommand{pool, query});
+      }
+      void EndQuery(QueryPoolHandle pool, std::uint32_t query) {
+         ++stats_.commands;
+         Encode(EndQueryCommand{pool, query});
+      }
+
+      /// Emits the draws held back for coalescing.
+      void Flush() {
+         std::uint32_t const count = std::exchange(pending_, 0);
+         bool const indexed = std::exchange(pending_indexed_, false);
+         if (count == 0) return;
+         if (indexed)
+            EncodeDraws<MultiDrawIndexedCommand>(std::span{indexed_draws_}.first(count));
+         else
+            EncodeDraws<MultiDrawCommand>(std::span{draws_}.first(count));
+      }
+      bool has_pending_draws() const { return pending_ != 0; }
+
+      /// Forgets the shadowed state, for when commands recorded elsewhere
+      /// changed what the queue has bound.
+      void InvalidateState() {
+         state_.fill(kUnknownState);
+         pipeline_.reset();
+         vertex_buffers_.fill(std::nullopt);
+         index_buffer_.reset();
+      }
+
+      RecordingStats const& recording_stats() const { return stats_; }
+
+   protected:
+      template <typename T>
+      void Encode(T const& command, std::span<std::byte const> data = {}) {
+         // Held-back draws go first to keep the recorded order
+         if (pending_ != 0) Flush();
+         EncodeCommand(self().BeginCommand(CommandSize<T>(data.size())), command, data);
+         self().EndCommand();
+         ++stats_.packets;
+      }
+
+   private:
+      // No register holds this, so the first write of each one is kept
+      static constexpr std::uint64_t kUnknownState = ~std::uint64_t{0};
+
+      template <typename Multi, typename Draw>
+      void EncodeDraws(std::span<Draw> draws) {
+         if (draws.size() == 1) return Encode(draws[0]);
+         Encode(Multi{static_cast<std::uint32_t>(draws.size()), 0}, std::as_bytes(draws));
+         stats_.coalesced_draws += draws.size() - 1;
+      }
+
+      Derived& self() { return static_cast<Derived&>(*this); }
+
+      RecordingOptions options_;
+      RecordingStats stats_;
+      std::array<std::uint64_t, kRenderStateCount> state_;
+      std::optional<PipelineHandle> pipeline_;
+      std::array<std::optional<BindVertexBufferCommand>, kMaxVertexBuffers> vertex_buffers_{};
+      std::optional<BindIndexBufferCommand> index_buffer_;
+      std::uint32_t pending_ = 0;
+      bool pending_indexed_ = false;
+      std::array<DrawCommand, kMaxDrawBatch> draws_;
+      std::array<DrawIndexedCommand, kMaxDrawBatch> indexed_draws_;
+   };
+
+   /// Commands recorded for later submission to a queue, Vulkan-style.
+   /// Packets live in a FrameArena, so several threads can record at once as
+   /// long as each uses its own arena, and the arena must not be reset before
+   /// the GPU has executed the list.
+   class CommandList : public CommandEncoder<CommandList> {
+   public:
+      explicit CommandList(FrameArena& arena, RecordingOptions const& options = {})
+            : CommandEncoder{options}, arena_{&arena} {}
+
+      /// The recorded packets, as runs of contiguous arena memory.
+      std::span<std::span<std::byte const> const> segments() const { return segments_; }
+      std::size_t size_bytes() const;
+
+   private:
+      friend class CommandEncoder<CommandList>;
+
+      std::span<std::byte> BeginCommand(std::size_t size);
+      void EndCommand() {}
+      std::size_t max_command_size() const { return arena_->chunk_bytes() - kCommandAlignment; }
+
+      FrameArena* arena_;
+      std::vector<std::span<std::byte const>> segments_;
+   };
+
+} // namespace vertexsim
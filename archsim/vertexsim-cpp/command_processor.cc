@@ -0,0 +1,317 @@
+#include "command_processor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace vertexsim {
+
+   namespace {
+
+      std::span<std::byte const> BufferRange(GpuDevice const& device, BufferHandle handle,
+                                             std::uint64_t offset) {
+         auto const data = device.buffer(handle);
+         if (offset > data.size()) throw std::runtime_error("Buffer binding is out of range");
+         return data.subspan(offset);
+      }
+
+      /// Calls `f` with each draw of a multi-draw packet. The bodies are
+      /// copied out one at a time, inline data is not aligned for them.
+      template <typename Multi, typename Draw, typename F>
+      void ForEachDraw(CommandReader const& reader, F&& f) {
+         auto const cmd = reader.Read<Multi>();
+         auto const data = reader.InlineData<Multi>();
+         if (data.size() < std::size_t{cmd.draw_count} * sizeof(Draw))
+            throw std::runtime_error("Truncated multi-draw packet");
+         for (std::uint32_t i = 0; i < cmd.draw_count; ++i) {
+            Draw draw;
+            std::memcpy(&draw, data.data() + i * sizeof(Draw), sizeof(Draw));
+            f(draw);
+         }
+      }
+
+      /// Calls `f` with `count` argument records of type `Args`, read from
+      /// `buffer` starting at `offset`, `stride` bytes apart.
+      template <typename Args, typename F>
+      void ForEachIndirect(GpuDevice const& device, BufferHandle buffer, std::uint64_t offset,
+                           std::uint32_t count, std::uint32_t stride, F&& f) {
+         if (count == 0) return;
+         if (stride < sizeof(Args) || stride % 4 != 0)
+            throw std::runtime_error("Indirect stride is too small or misaligned");
+         auto const data = device.buffer(buffer);
+         std::uint64_t const last = offset + std::uint64_t{count - 1} * stride;
+         if (offset > data.size() || last > data.size() || data.size() - last < sizeof(Args))
+            throw std::runtime_error("Indirect arguments are out of range");
+         for (std::uint32_t i = 0; i < count; ++i) {
+            Args args;
+            std::memcpy(&args, data.data() + offset + std::uint64_t{i} * stride, sizeof(Args));
+            f(args);
+         }
+      }
+
+      std::uint64_t PrimitiveCount(PrimitiveTopology topology, std::uint32_t count) {
+         switch (topology) {
+            case PrimitiveTopology::kPointList:
+               return count;
+            case PrimitiveTopology::kLineList:
+               return count / 2;
+            case PrimitiveTopology::kLineStrip:
+               return count < 2 ? 0 : count - 1;
+            case PrimitiveTopology::kTriangleList:
+               return count / 3;
+            case PrimitiveTopology::kTriangleStrip:
+            case PrimitiveTopology::kTriangleFan:
+               return count < 3 ? 0 : count - 2;
+            case PrimitiveTopology::kLineListWithAdjacency:
+               return count / 4;
+            case PrimitiveTopology::kLineStripWithAdjacency:
+               return count < 4 ? 0 : count - 3;
+            case PrimitiveTopology::kTriangleListWithAdjacency:
+               return count / 6;
+            case PrimitiveTopology::kTriangleStripWithAdjacency:
+               return count < 6 ? 0 : (count - 4) / 2;
+         }
+         return 0;
+      }
+
+   } // namespace
+
+   CommandProcessor::CommandProcessor(GpuDevice& device, DrawHandler on_draw,
+                                      CycleModel const& cycles)
+         : device_{device}, on_draw_{std::move(on_draw)}, cycle_model_{cycles} {
+      if (!(cycles.clock_hz > 0) || cycles.vertices_per_cycle == 0 || cycles.bytes_per_cycle == 0)
+         throw std::invalid_argument("Cycle model rates must be positive");
+      SetCopyBandwidth(0);
+      state_[static_cast<std::size_t>(RenderState::kTopology)] =
+            static_cast<std::uint32_t>(PrimitiveTopology::kTriangleList);
+   }
+
+   void CommandProcessor::SetCopyBandwidth(double bytes_per_second) {
+      if (!(bytes_per_second >= 0)) throw std::invalid_argument("Copy bandwidth is negative");
+      copy_cycles_per_byte_ = bytes_per_second > 0 ? cycle_model_.clock_hz / bytes_per_second
+                                                   : 1.0 / cycle_model_.bytes_per_cycle;
+   }
+
+   void CommandProcessor::Execute(std::span<std::byte const> stream) {
+      for (CommandReader reader{stream}; !reader.AtEnd(); reader.Next()) {
+         // Counted first: once a fence is signalled the host may read stats
+         ++stats_.packets;
+         Charge(cycle_model_.packet_cycles);
+         ExecutePacket(reader, reader.Peek().op);
+      }
+   }
+
+   void CommandProcessor::ExecutePacket(CommandReader const& reader, CommandOp op) {
+      switch (op) {
+         case CommandOp::kNop:
+            return;
+         case CommandOp::kSetState: {
+            auto const cmd = reader.Read<SetStateCommand>();
+            auto const i = static_cast<std::size_t>(cmd.state);
+            if (i >= kRenderStateCount) throw std::runtime_error("Unknown render state");
+            state_[i] = cmd.value;
+            pipeline_ = nullptr;
+            ++stats_.state_changes;
+            return;
+         }
+         case CommandOp::kBindPipeline: {
+            auto const cmd = reader.Read<BindPipelineCommand>();
+            pipeline_ = &device_.pipeline(cmd.pipeline);
+            state_ = pipeline_->desc.state;
+            ++stats_.state_changes;
+            return;
+         }
+         case CommandOp::kBindVertexBuffer: {
+            auto const cmd = reader.Read<BindVertexBufferCommand>();
+            if (cmd.slot >= kMaxVertexBuffers)
+               throw std::runtime_error("Vertex buffer slot out of range");
+            vertex_buffers_[cmd.slot] = {BufferRange(device_, cmd.buffer, cmd.offset), cmd.stride};
+            ++stats_.state_changes;
+            return;
+         }
+         case CommandOp::kBindIndexBuffer: {
+            auto const cmd = reader.Read<BindIndexBufferCommand>();
+            if (cmd.format != IndexFormat::kUint16 && cmd.format != IndexFormat::kUint32)
+               throw std::runtime_error("Unknown index format");
+            index_buffer_ = {BufferRange(device_, cmd.buffer, cmd.offset), cmd.format};
+            ++stats_.state_changes;
+            return;
+         }
+         case CommandOp::kUpdateBuffer: {
+            auto const cmd = reader.Read<UpdateBufferCommand>();
+            auto const data = reader.InlineData<UpdateBufferCommand>();
+            auto const dst = device_.buffer(cmd.buffer);
+            if (cmd.size > data.size() || cmd.offset > dst.size() ||
+                cmd.size > dst.size() - cmd.offset)
+               throw std::runtime_error("Buffer update is out of range");
+            std::memcpy(dst.data() + cmd.offset, data.data(), cmd.size);
+            Charge(cmd.size / cycle_model_.bytes_per_cycle);
+            ++stats_.buffer_updates;
+            return;
+         }
+         case CommandOp::kCopyBuffer: {
+            auto const cmd = reader.Read<CopyBufferCommand>();
+            auto const src = device_.buffer(cmd.src);
+            auto const dst = device_.buffer(cmd.dst);
+            if (cmd.src_offset > src.size() || cmd.size > src.size() - cmd.src_offset ||
+                cmd.dst_offset > dst.size() || cmd.size > dst.size() - cmd.dst_offset)
+               throw std::runtime_error("Buffer copy is out of range");
+            std::memmove(dst.data() + cmd.dst_offset, src.data() + cmd.src_offset, cmd.size);
+            // The engine streams one copy after another at its bandwidth
+            Charge(static_cast<std::uint64_t>(std::ceil(cmd.size * copy_cycles_per_byte_)));
+            ++stats_.copies;
+            stats_.copy_bytes += cmd.size;
+            return;
+         }
+         case CommandOp::kDraw:
+            Draw(reader.Read<DrawCommand>());
+            return;
+         case CommandOp::kDrawIndexed:
+            DrawIndexed(reader.Read<DrawIndexedCommand>());
+            return;
+         case CommandOp::kMultiDraw:
+            ForEachDraw<MultiDrawCommand, DrawCommand>(reader, [&](auto const& cmd) { Draw(cmd); });
+            return;
+         case CommandOp::kMultiDrawIndexed:
+            ForEachDraw<MultiDrawIndexedCommand, DrawIndexedCommand>(
+                  reader, [&](auto const& cmd) { DrawIndexed(cmd); });
+            return;
+         case CommandOp::kDrawIndirect: {
+            auto const cmd = reader.Read<DrawIndirectCommand>();
+            ++stats_.indirect_commands;
+            ForEachIndirect<DrawCommand>(device_, cmd.buffer, cmd.offset, cmd.draw_count,
+                                         cmd.stride, [&](auto const& args) { Draw(args); });
+            return;
+         }
+         case CommandOp::kMultiDrawIndexedIndirect: {
+            auto const cmd = reader.Read<MultiDrawIndexedIndirectCommand>();
+            ++stats_.indirect_commands;
+            std::uint32_t count = cmd.max_draw_count;
+            if (cmd.flags & kIndirectCountBuffer) {
+               ForEachIndirect<std::uint32_t>(
+                     device_, cmd.count_buffer, cmd.count_offset, 1, sizeof(std::uint32_t),
+                     [&](std::uint32_t gpu_count) { count = std::min(count, gpu_count); });
+            }
+            ForEachIndirect<DrawIndexedCommand>(device_, cmd.buffer, cmd.offset, count, cmd.stride,
+                                                [&](auto const& args) { DrawIndexed(args); });
+            return;
+         }
+         case CommandOp::kSignalFence: {
+            auto const cmd = reader.Read<SignalFenceCommand>();
+            TimelineFence& fence = device_.fence(cmd.fence);
+            if (cmd.value < fence.value()) throw std::runtime_error("Fence value moved backwards");
+            ++stats_.fences;
+            fence.Signal(cmd.value, cycle_);
+            return;
+         }
+         case CommandOp::kWaitFence: {
+            auto const cmd = reader.Read<WaitFenceCommand>();
+            ++stats_.fence_waits;
+            TimelineFence const& fence = device_.fence(cmd.fence);
+            fence.Wait(cmd.value);
+            // The queue idles until the signalling queue's clock
+            cycle_ = std::max(cycle_, fence.cycle());
+            return;
+         }
+         case CommandOp::kWriteTimestamp: {
+            auto const cmd = reader.Read<WriteTimestampCommand>();
+            QueryPool& pool = Query(cmd.pool, cmd.query);
+            if (pool.type() != QueryType::kTimestamp)
+               throw std::runtime_error("Timestamp written to a non-timestamp query");
+            pool.Write(cmd.query, {&cycle_, 1});
+            return;
+         }
+         case CommandOp::kBeginQuery: {
+            auto const cmd = reader.Read<BeginQueryCommand>();
+            QueryPool& pool = Query(cmd.pool, cmd.query);
+            if (pool.type() == QueryType::kTimestamp)
+               throw std::runtime_error("Timestamp queries cannot be begun");
+            for (auto const& active : active_queries_)
+               if (active.pool == &pool && active.query == cmd.query)
+                  throw std::runtime_error("Query is already active");
+            pool.Invalidate(cmd.query);
+            active_queries_.push_back({&pool, cmd.query, counters_});
+            return;
+         }
+         case CommandOp::kEndQuery: {
+            auto const cmd = reader.Read<EndQueryCommand>();
+            QueryPool& pool = Query(cmd.pool, cmd.query);
+            auto const active = std::ranges::find_if(active_queries_, [&](auto const& q) {
+               return q.pool == &pool && q.query == cmd.query;
+            });
+            if (active == active_queries_.end()) throw std::runtime_error("Query is not active");
+            PipelineStatistics const& begin = active->begin;
+            std::uint64_t const values[] = {
+                  counters_.input_vertices - begin.input_vertices,
+                  counters_.input_primitives - begin.input_primitives,
+                  counters_.vertex_shader_invocations - begin.vertex_shader_invocations,
+            };
+            static_assert(std::size(values) == kPipelineStatisticsCount);
+            // Occlusion reports the input primitives, counted before any culling
+            if (pool.type() == QueryType::kOcclusion)
+               pool.Write(cmd.query, {values + 1, 1});
+            else
+               pool.Write(cmd.query, values);
+            active_queries_.erase(active);
+            return;
+         }
+         case CommandOp::kExecuteCommands: {
+            auto const cmd = reader.Read<ExecuteCommandsCommand>();
+            if (in_command_list_) throw std::runtime_error("Command lists cannot be nested");
+            ++stats_.command_lists;
+            in_command_list_ = true;
+            Execute({reinterpret_cast<std::byte const*>(cmd.address), cmd.size});
+            in_command_list_ = false;
+            return;
+         }
+      }
+      throw std::runtime_error("Unknown command opcode " +
+                               std::to_string(static_cast<unsigned>(op)));
+   }
+
+   void CommandProcessor::Draw(DrawCommand const& cmd) {
+      DrawCall draw{state_, vertex_buffers_};
+      draw.pipeline = pipeline_;
+      draw.count = cmd.vertex_count;
+      draw.instance_count = cmd.instance_count;
+      draw.first = cmd.first_vertex;
+      draw.first_instance = cmd.first_instance;
+      ExecuteDraw(draw);
+   }
+
+   void CommandProcessor::DrawIndexed(DrawIndexedCommand const& cmd) {
+      std::uint64_t const end = std::uint64_t{cmd.first_index} + cmd.index_count;
+      if (end * static_cast<std::size_t>(index_buffer_.format) > index_buffer_.data.size())
+         throw std::runtime_error("Indexed draw reads past the index buffer");
+      DrawCall draw{state_, vertex_buffers_, &index_buffer_, pipeline_};
+      draw.count = cmd.index_count;
+      draw.instance_count = cmd.instance_count;
+      draw.first = cmd.first_index;
+      draw.vertex_offset = cmd.vertex_offset;
+      draw.first_instance = cmd.first_instance;
+      ExecuteDraw(draw);
+   }
+
+   QueryPool& CommandProcessor::Query(QueryPoolHandle pool, std::uint32_t query) const {
+      QueryPool& queries = device_.query_pool(pool);
+      if (query >= queries.size()) throw std::runtime_error("Query index out of range");
+      return queries;
+   }
+
+   void CommandProcessor::ExecuteDraw(DrawCall const& draw) {
+      std::uint64_t const vertices = std::uint64_t{draw.count} * draw.instance_count;
+      ++stats_.draws;
+      stats_.vertices += vertices;
+      Charge(cycle_model_.draw_cycles + (vertices + cycle_model_.vertices_per_cycle - 1) /
+                                              cycle_model_.vertices_per_cycle);
+      counters_.input_vertices += vertices;
+      counters_.input_primitives +=
+            PrimitiveCount(draw.topology(), draw.count) * draw.instance_count;
+      counters_.vertex_shader_invocations += vertices;
+      if (on_draw_ && draw.count && draw.instance_count) on_draw_(draw);
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "gpu_command.h"
+#include "gpu_device.h"
+#include "pipeline.h"
+#include "query_pool.h"
+
+namespace vertexsim {
+
+   struct VertexBufferBinding {
+      // Starts at the bound offset
+      std::span<std::byte const> data;
+      std::uint32_t stride = 0;
+   };
+
+   struct IndexBufferBinding {
+      std::span<std::byte const> data;
+      IndexFormat format = IndexFormat::kUint32;
+   };
+
+   /// A draw with all of its state resolved, as the front-end hands it to the
+   /// rest of the pipeline.
+   struct DrawCall {
+      std::span<std::uint32_t const, kRenderStateCount> state;
+      std::span<VertexBufferBinding const, kMaxVertexBuffers> vertex_buffers;
+      // Null for non-indexed draws
+      IndexBufferBinding const* index_buffer = nullptr;
+      // The bound pipeline, already decoded, unless SetState has changed a
+      // register since it was bound; `state` is always current
+      Pipeline const* pipeline = nullptr;
+      // Vertices, or indices for indexed draws
+      std::uint32_t count = 0;
+      std::uint32_t instance_count = 1;
+      // First vertex, or first index for indexed draws
+      std::uint32_t first = 0;
+      std::int32_t vertex_offset = 0;
+      std::uint32_t first_instance = 0;
+
+      PrimitiveTopology topology() const {
+         if (pipeline) return pipeline->topology;
+         auto const i = static_cast<std::size_t>(RenderState::kTopology);
+         return static_cast<PrimitiveTopology>(state[i]);
+      }
+
+      /// Whether all-ones indices restart strips; never for non-indexed draws.
+      bool primitive_restart() const {
+         if (!index_buffer) return false;
+         if (pipeline) return pipeline->flags & kPipelinePrimitiveRestart;
+         return state[static_cast<std::size_t>(RenderState::kPrimitiveRestartEnable)] != 0;
+      }
+
+      ProvokingVertex provoking_vertex() const {
+         if (pipeline) return pipeline->provoking_vertex;
+         auto const i = static_cast<std::size_t>(RenderState::kProvokingVertex);
+         return static_cast<ProvokingVertex>(state[i]);
+      }
+   };
+
+   using DrawHandler = std::function<void(DrawCall const&)>;
+
+   struct FrontEndStats {
+      std::uint64_t packets = 0;
+      std::uint64_t state_changes = 0;
+      std::uint64_t buffer_updates = 0;
+      std::uint64_t draws = 0;
+      // Vertices or indices times instances, over all draws
+      std::uint64_t vertices = 0;
+      std::uint64_t fences = 0;
+      std::uint64_t fence_waits = 0;
+      std::uint64_t command_lists = 0;
+      // Indirect packets; the draws they expand to count under `draws`
+      std::uint64_t indirect_commands = 0;
+      std::uint64_t copies = 0;
+      std::uint64_t copy_bytes = 0;
+      // Simulated cycles spent executing, not counting fence waits
+      std::uint64_t busy_cycles = 0;
+
+      FrontEndStats& operator+=(FrontEndStats const& other) {
+         packets += other.packets;
+         state_changes += other.state_changes;
+         buffer_updates += other.buffer_updates;
+         draws += other.draws;
+         vertices += other.vertices;
+         fences += other.fences;
+         fence_waits += other.fence_waits;
+         command_lists += other.command_lists;
+         indirect_commands += other.indirect_commands;
+         copies += other.copies;
+         copy_bytes += other.copy_bytes;
+         busy_cycles += other.busy_cycles;
+         return *this;
+      }
+   };
+
+   /// First-order cost model of a queue, in GPU clock cycles. Each queue has
+   /// its own cycle counter, and a queue that waits on a fence catches up
+   /// with the clock of the queue that signalled it.
+   struct CycleModel {
+      double clock_hz = 1e9;
+      // Decoding any packet
+      std::uint32_t packet_cycles = 4;
+      // Setting up a draw, before its first vertex
+      std::uint32_t draw_cycles = 32;
+      // Input assembly rate, in vertices or indices
+      std::uint32_t vertices_per_cycle = 4;
+      // Buffer updates, and copies unless SetCopyBandwidth() gives the copy
+      // engine a bandwidth of its own
+      std::uint32_t bytes_per_cycle = 64;
+   };
+
+   /// Simulated command processor: decodes a command stream, tracks bound
+   /// state and hands every draw to the pipeline through a DrawHandler.
+   /// Executing commands advances its cycle counter, which timestamp queries
+   /// sample, and its pipeline counters, which the other queries count.
+   class CommandProcessor {
+   public:
+      CommandProcessor(GpuDevice& device, DrawHandler on_draw, CycleModel const& cycles = {});
+
+      /// Executes every packet of `stream`. Invalid commands throw
+      /// std::runtime_error.
+      void Execute(std::span<std::byte const> stream);
+
+      FrontEndStats const& stats() const { return stats_; }
+      /// The queue's clock, like stats() only current once the host has
+      /// synchronized with the queue.
+      std::uint64_t cycle() const { return cycle_; }
+
+      /// Models a DMA engine: CopyBuffer packets advance this queue's clock
+      /// at this rate, and queues waiting on its fences catch up with it.
+      /// Zero copies at the cycle model's bytes_per_cycle.
+      void SetCopyBandwidth(double bytes_per_second);
+
+   private:
+      void ExecutePacket(CommandReader const& reader, CommandOp op);
+      void Draw(DrawCommand const& cmd);
+      void DrawIndexed(DrawIndexedCommand const& cmd);
+      void ExecuteDraw(DrawCall const& draw);
+      void Charge(std::uint64_t cycles) {
+         cycle_ += cycles;
+         stats_.busy_cycles += cycles;
+      }
+      QueryPool& Query(QueryPoolHandle pool, std::uint32_t query) const;
+
+      GpuDevice& device_;
+      DrawHandler on_draw_;
+      std::array<std::uint32_t, kRenderStateCount> state_{};
+      std::array<VertexBufferBinding, kMaxVertexBuffers> vertex_buffers_{};
+      IndexBufferBinding index_buffer_;
+      Pipeline const* pipeline_ = nullptr;
+      FrontEndStats stats_;
+      CycleModel cycle_model_;
+      std::uint64_t cycle_ = 0;
+      PipelineStatistics counters_;
+      struct ActiveQuery {
+         QueryPool* pool;
+         std::uint32_t query;
+         // Counters when the query began
+         PipelineStatistics begin;
+      };
+      std::vector<ActiveQuery> active_queries_;
+      // Command lists may not execute other command lists
+      bool in_command_list_ = false;
+      // The one rate CopyBuffer packets are charged at
+      double copy_cycles_per_byte_;
+   };
+
+} // namespace vertexsim
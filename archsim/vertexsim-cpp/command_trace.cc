@@ -0,0 +1,320 @@
+#include "command_trace.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <lz4.h>
+#include <stdexcept>
+
+#include "gpu_driver.h"
+#include "mapped_file.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      constexpr std::array<char, 8> kTraceMagic = {'V', 'S', 'T', 'R', 'A', 'C', 'E', '\0'};
+      constexpr std::uint32_t kTraceVersion = 7;
+
+      struct TraceHeader {
+         std::array<char, 8> magic;
+         std::uint32_t version;
+         std::uint32_t queue_count;
+      };
+
+      /// Precedes each chunk. A chunk stored with raw_size == stored_size did
+      /// not compress and is kept as is.
+      struct ChunkHeader {
+         std::uint32_t raw_size;
+         std::uint32_t stored_size;
+      };
+
+      enum TraceEvent : std::uint8_t {
+         kCreateBuffer,
+         kCreateFence,
+         kCommands,
+         kHostWrite,
+         kHostWait,
+         kCreatePipeline,
+         kCreateQueryPool,
+         kFinish,
+      };
+
+      struct EventHeader {
+         std::uint8_t kind;
+         std::uint8_t reserved;
+         std::uint16_t queue;
+         std::uint32_t size;
+      };
+
+      struct CreateBody {
+         std::uint32_t handle;
+         std::uint32_t reserved;
+         // Buffer size or initial fence value
+         std::uint64_t value;
+      };
+
+      struct CreatePipelineBody {
+         std::uint32_t handle;
+         std::uint32_t reserved;
+         PipelineDesc desc;
+      };
+
+      struct CreateQueryPoolBody {
+         std::uint32_t handle;
+         QueryType type;
+         std::uint32_t size;
+         std::uint32_t reserved;
+      };
+
+      /// Precedes the written bytes of a kHostWrite event.
+      struct HostWriteBody {
+         std::uint32_t buffer;
+         std::uint32_t reserved;
+         std::uint64_t offset;
+      };
+
+      struct HostWaitBody {
+         std::uint32_t fence;
+         std::uint32_t reserved;
+         std::uint64_t value;
+      };
+
+      static_assert(std::endian::native == std::endian::little,
+                    ".vstrace files are little-endian and read without conversion");
+
+      template <typename T>
+      T ReadAt(std::span<std::byte const> bytes, std::size_t offset, char const* what) {
+         if (bytes.size() < offset + sizeof(T))
+            throw std::runtime_error(std::string{"Truncated trace "} + what);
+         T value;
+         std::memcpy(&value, bytes.data() + offset, sizeof(T));
+         return value;
+      }
+
+   } // namespace
+
+   TraceWriter::TraceWriter(std::filesystem::path const& path, std::uint32_t queue_count)
+         : path_{path}, out_{path, std::ios::binary | std::ios::trunc} {
+      if (!out_) throw std::runtime_error("Failed to create trace: " + path.string());
+      TraceHeader const header{kTraceMagic, kTraceVersion, queue_count};
+      out_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+      chunk_.reserve(kChunkBytes);
+   }
+
+   TraceWriter::~TraceWriter() {
+      try {
+         Close();
+      } catch (std::exception const& e) {
+         std::cerr << "Warning: " << e.what() << std::endl;
+      }
+   }
+
+   void TraceWriter::CreateBuffer(BufferHandle handle, std::size_t size) {
+      CreateBody const body{static_cast<std::uint32_t>(handle), 0, size};
+      Append(kCreateBuffer, 0, std::as_bytes(std::span{&body, 1}));
+   }
+
+   void TraceWriter::CreateFence(FenceHandle handle, std::uint64_t initial_value) {
+      CreateBody const body{static_cast<std::uint32_t>(handle), 0, initial_value};
+      Append(kCreateFence, 0, std::as_bytes(std::span{&body, 1}));
+   }
+
+   void TraceWriter::CreatePipeline(PipelineHandle handle, PipelineDesc const& desc) {
+      CreatePipelineBody const body{static_cast<std::uint32_t>(handle), 0, desc};
+      Append(kCreatePipeline, 0, std::as_bytes(std::span{&body, 1}));
+   }
+
+   void TraceWriter::CreateQueryPool(QueryPoolHandle handle, QueryType type, std::uint32_t size) {
+      CreateQueryPoolBody const body{static_cast<std::uint32_t>(handle), type, size, 0};
+      Append(kCreateQueryPool, 0, std::as_bytes(std::span{&body, 1}));
+   }
+
+   void TraceWriter::Commands(std::uint32_t queue, std::span<std::byte const> packets) {
+      Append(kCommands, queue, packets);
+   }
+
+   void TraceWriter::HostWrite(BufferHandle buffer, std::uint64_t offset,
+                               std::span<std::byte const> data) {
+      // Huge writes are split so that no event outgrows a chunk
+      constexpr std::size_t kMaxPart = kChunkBytes / 2;
+      std::vector<std::byte> body;
+      for (std::size_t done = 0; done < data.size();) {
+         std::size_t const size = std::min(kMaxPart, data.size() - done);
+         HostWriteBody const header{static_cast<std::uint32_t>(buffer), 0, offset + done};
+         auto const* p = reinterpret_cast<std::byte const*>(&header);
+         body.assign(p, p + sizeof(header));
+         body.insert(body.end(), data.begin() + done, data.begin() + done + size);
+         Append(kHostWrite, 0, body);
+         done += size;
+      }
+   }
+
+   void TraceWriter::HostWait(FenceHandle fence, std::uint64_t value) {
+      HostWaitBody const body{static_cast<std::uint32_t>(fence), 0, value};
+      Append(kHostWait, 0, std::as_bytes(std::span{&body, 1}));
+   }
+
+   void TraceWriter::Finish() { Append(kFinish, 0, {}); }
+
+   void TraceWriter::Close() {
+      if (!out_.is_open()) return;
+      FlushChunk();
+      out_.close();
+      if (!out_) throw std::runtime_error("Failed to write trace: " + path_.string());
+   }
+
+   void TraceWriter::Append(std::uint8_t kind, std::uint32_t queue,
+                            std::span<std::byte const> body) {
+      if (!out_.is_open()) throw std::logic_error("Trace is closed");
+      std::size_t const size = sizeof(EventHeader) + body.size();
+      // Events never straddle chunks; a giant one gets a chunk of its own
+      if (chunk_.size() + size > kChunkBytes) FlushChunk();
+      EventHeader const header{kind, 0, static_cast<std::uint16_t>(queue),
+                               static_cast<std::uint32_t>(body.size())};
+      auto const* p = reinterpret_cast<std::byte const*>(&header);
+      chunk_.insert(chunk_.end(), p, p + sizeof(header));
+      chunk_.insert(chunk_.end(), body.begin(), body.end());
+      ++stats_.events;
+   }
+
+   void TraceWriter::FlushChunk() {
+      if (chunk_.empty()) return;
+      auto const raw_size = static_cast<int>(chunk_.size());
+      compressed_.resize(static_cast<std::size_t>(LZ4_compressBound(raw_size)));
+      int const compressed_size =
+            LZ4_compress_default(reinterpret_cast<char const*>(chunk_.data()), compressed_.data(),
+                                 raw_size, static_cast<int>(compressed_.size()));
+      bool const compress = compressed_size > 0 && compressed_size < raw_size;
+      ChunkHeader const header{static_cast<std::uint32_t>(raw_size),
+                               static_cast<std::uint32_t>(compress ? compressed_size : raw_size)};
+      out_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+      out_.write(compress ? compressed_.data() : reinterpret_cast<char const*>(chunk_.data()),
+                 header.stored_size);
+      if (!out_) throw std::runtime_error("Failed to write trace: " + path_.string());
+      ++stats_.chunks;
+      stats_.raw_bytes += header.raw_size;
+      stats_.stored_bytes += header.stored_size;
+      chunk_.clear();
+   }
+
+   TraceStats ReplayTrace(std::filesystem::path const& path, DrawHandler on_draw,
+                          FrontEndStats* front_end) {
+      MappedFile const file{path};
+      auto const bytes = std::as_bytes(std::span{file.data(), file.size()});
+      auto const header = ReadAt<TraceHeader>(bytes, 0, "header");
+      if (header.magic != kTraceMagic || header.version != kTraceVersion || header.queue_count == 0)
+         throw std::runtime_error("Not a supported trace: " + path.string());
+
+      GpuDriverOptions options;
+      options.queue_count = header.queue_count;
+      // The captured driver's staging buffer is created by the trace itself
+      options.staging_bytes = 0;
+      GpuDriver driver{std::move(on_draw), options};
+      TraceStats stats;
+      std::vector<std::byte> chunk;
+      for (std::size_t offset = sizeof(TraceHeader); offset < bytes.size();) {
+         auto const chunk_header = ReadAt<ChunkHeader>(bytes, offset, "chunk");
+         offset += sizeof(ChunkHeader);
+         if (bytes.size() - offset < chunk_header.stored_size)
+            throw std::runtime_error("Truncated trace chunk");
+         auto const stored = bytes.subspan(offset, chunk_header.stored_size);
+         offset += chunk_header.stored_size;
+
+         std::span<std::byte const> events = stored;
+         if (chunk_header.stored_size != chunk_header.raw_size) {
+            chunk.resize(chunk_header.raw_size);
+            int const size = LZ4_decompress_safe(
+                  reinterpret_cast<char const*>(stored.data()),
+                  reinterpret_cast<char*>(chunk.data()), static_cast<int>(stored.size()),
+                  static_cast<int>(chunk.size()));
+            if (size != static_cast<int>(chunk_header.raw_size))
+               throw std::runtime_error("Corrupt trace chunk");
+            events = chunk;
+         }
+         ++stats.chunks;
+         stats.raw_bytes += chunk_header.raw_size;
+         stats.stored_bytes += chunk_header.stored_size;
+
+         while (!events.empty()) {
+            auto const event = ReadAt<EventHeader>(events, 0, "event");
+            if (events.size() - sizeof(EventHeader) < event.size)
+               throw std::runtime_error("Truncated trace event");
+            auto const body = events.subspan(sizeof(EventHeader), event.size);
+            events = events.subspan(sizeof(EventHeader) + event.size);
+            ++stats.events;
+            switch (event.kind) {
+               case kCreateBuffer: {
+                  auto const create = ReadAt<CreateBody>(body, 0, "event");
+                  // Handles are handed out in order, so a replay that
+                  // diverges would misroute every later command
+                  if (static_cast<std::uint32_t>(driver.CreateBuffer(create.value)) !=
+                      create.handle)
+                     throw std::runtime_error("Trace buffer handles are out of order");
+                  break;
+               }
+               case kCreateFence: {
+                  auto const create = ReadAt<CreateBody>(body, 0, "event");
+                  if (static_cast<std::uint32_t>(driver.CreateFence(create.value)) !=
+                      create.handle)
+                     throw std::runtime_error("Trace fence handles are out of order");
+                  break;
+               }
+               case kCreatePipeline: {
+                  auto const create = ReadAt<CreatePipelineBody>(body, 0, "event");
+                  if (static_cast<std::uint32_t>(driver.CreatePipeline(create.desc)) !=
+                      create.handle)
+                     throw std::runtime_error("Trace pipeline handles are out of order");
+                  break;
+               }
+               case kCreateQueryPool: {
+                  auto const create = ReadAt<CreateQueryPoolBody>(body, 0, "event");
+                  if (static_cast<std::uint32_t>(driver.CreateQueryPool(create.type,
+                                                                        create.size)) !=
+                      create.handle)
+                     throw std::runtime_error("Trace query pool handles are out of order");
+                  break;
+               }
+               case kCommands:
+                  // Captures inline command lists, so a packet pointing into
+                  // host memory can only come from a corrupt or hostile file
+                  for (CommandReader reader{body}; !reader.AtEnd(); reader.Next())
+                     if (reader.Peek().op == CommandOp::kExecuteCommands)
+                        throw std::runtime_error("Trace executes a command list by address");
+                  driver.SubmitPackets(event.queue, body);
+                  break;
+               case kHostWrite: {
+                  auto const write = ReadAt<HostWriteBody>(body, 0, "event");
+                  auto const buffer = static_cast<BufferHandle>(write.buffer);
+                  auto const data = body.subspan(sizeof(HostWriteBody));
+                  auto const mapped = driver.MapBuffer(buffer);
+                  if (write.offset > mapped.size() || data.size() > mapped.size() - write.offset)
+                     throw std::runtime_error("Trace host write is out of range");
+                  std::memcpy(mapped.data() + write.offset, data.data(), data.size());
+                  driver.FlushMappedRange(buffer, write.offset, data.size());
+                  break;
+               }
+               case kHostWait: {
+                  auto const wait = ReadAt<HostWaitBody>(body, 0, "event");
+                  driver.WaitFence(static_cast<FenceHandle>(wait.fence), wait.value);
+                  break;
+               }
+               case kFinish:
+                  driver.Finish();
+                  break;
+               default:
+                  throw std::runtime_error("Unknown trace event " + std::to_string(event.kind));
+            }
+         }
+      }
+      driver.Finish();
+      if (front_end) {
+         for (std::uint32_t queue = 0; queue <= driver.copy_queue(); ++queue)
+            *front_end += driver.stats(queue);
+      }
+      return stats;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include "command_processor.h"
+#include "gpu_command.h"
+#include "pipeline.h"
+
+namespace vertexsim {
+
+   struct TraceStats {
+      std::uint64_t events = 0;
+      std::uint64_t chunks = 0;
+      // Event bytes before and after compression
+      std::uint64_t raw_bytes = 0;
+      std::uint64_t stored_bytes = 0;
+   };
+
+   /// Writes a .vstrace capture: every object a GpuDriver creates and every
+   /// packet it sends to each queue, in host submission order, along with
+   /// flushed host writes to mapped buffers and host fence waits. Command
+   /// lists are flattened into their packets, so a trace replays without the
+   /// application. Events are batched into LZ4-compressed chunks. Not
+   /// thread-safe; the driver serializes captures.
+   class TraceWriter {
+   public:
+      static constexpr std::size_t kChunkBytes = std::size_t{1} << 20;
+
+      TraceWriter(std::filesystem::path const& path, std::uint32_t queue_count);
+      /// Flushes the last chunk. Errors are reported to std::cerr; call
+      /// Close() to have them thrown instead.
+      ~TraceWriter();
+
+      TraceWriter(TraceWriter const&) = delete;
+      TraceWriter& operator=(TraceWriter const&) = delete;
+
+      void CreateBuffer(BufferHandle handle, std::size_t size);
+      void CreateFence(FenceHandle handle, std::uint64_t initial_value);
+      void CreatePipeline(PipelineHandle handle, PipelineDesc const& desc);
+      void CreateQueryPool(QueryPoolHandle handle, QueryType type, std::uint32_t size);
+      /// Whole packets sent to `queue`.
+      void Commands(std::uint32_t queue, std::span<std::byte const> packets);
+      /// Host writes to mapped buffer memory, as flushed.
+      void HostWrite(BufferHandle buffer, std::uint64_t offset, std::span<std::byte const> data);
+      /// The host blocked on a fence, e.g. before reusing mapped memory.
+      void HostWait(FenceHandle fence, std::uint64_t value);
+      /// The host waited for every queue to go idle. The fences the driver
+      /// signals for this are its own, so they are left out of the trace.
+      void Finish();
+
+      void Close();
+
+      TraceStats const& stats() const { return stats_; }
+
+   private:
+      void Append(std::uint8_t kind, std::uint32_t queue, std::span<std::byte const> body);
+      void FlushChunk();
+
+      std::filesystem::path path_;
+      std::ofstream out_;
+      std::vector<std::byte> chunk_;
+      std::vector<char> compressed_;
+      TraceStats stats_;
+   };
+
+   /// Replays a .vstrace capture headlessly on a fresh GpuDriver with the
+   /// captured queue count, then waits for the GPU to finish. The front-end
+   /// counters of all queues are summed into `front_end` when given.
+   ///
+   /// Packets are fed from one thread in capture order, so a queue waiting on
+   /// a fence must not have more than a ring's worth of later packets
+   /// captured before the packet that signals it.
+   TraceStats ReplayTrace(std::filesystem::path const& path, DrawHandler on_draw = {},
+                          FrontEndStats* front_end = nullptr);
+
+} // namespace vertexsim
@@ -0,0 +1,66 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace vertexsim {
+
+   namespace {
+
+      std::size_t Padding(std::byte const* p, std::size_t alignment) {
+         return -reinterpret_cast<std::uintptr_t>(p) & (alignment - 1);
+      }
+
+   } // namespace
+
+   FrameArena::FrameArena(std::size_t chunk_bytes) : chunk_bytes_{chunk_bytes} {
+      if (chunk_bytes == 0) throw std::invalid_argument("FrameArena chunks cannot be empty");
+   }
+
+   std::byte* FrameArena::Allocate(std::size_t size, std::size_t alignment) {
+      if (!std::has_single_bit(alignment))
+         throw std::invalid_argument("Alignment must be a power of two");
+      if (size + alignment > chunk_bytes_) {
+         // Rare giant requests get their own block, freed at the end of the frame
+         oversized_.push_back(std::make_unique_for_overwrite<std::byte[]>(size + alignment));
+         oversized_bytes_ += size + alignment;
+         stats_.bytes_reserved += size + alignment;
+         ++stats_.oversized_allocations;
+         frame_bytes_ += size;
+         std::byte* const p = oversized_.back().get();
+         return p + Padding(p, alignment);
+      }
+      if (chunks_.empty()) {
+         chunks_.push_back(std::make_unique_for_overwrite<std::byte[]>(chunk_bytes_));
+         stats_.bytes_reserved += chunk_bytes_;
+      }
+      std::size_t padding = Padding(chunks_[chunk_].get() + used_, alignment);
+      if (used_ + padding + size > chunk_bytes_) {
+         // Chunks kept by Reset() are reused before new ones are allocated
+         if (++chunk_ == chunks_.size()) {
+            chunks_.push_back(std::make_unique_for_overwrite<std::byte[]>(chunk_bytes_));
+            stats_.bytes_reserved += chunk_bytes_;
+         }
+         used_ = 0;
+         padding = Padding(chunks_[chunk_].get(), alignment);
+      }
+      std::byte* const p = chunks_[chunk_].get() + used_ + padding;
+      used_ += padding + size;
+      frame_bytes_ += padding + size;
+      return p;
+   }
+
+   void FrameArena::Reset() {
+      ++stats_.frames;
+      stats_.last_frame_bytes = frame_bytes_;
+      stats_.peak_frame_bytes = std::max(stats_.peak_frame_bytes, frame_bytes_);
+      stats_.bytes_reserved -= oversized_bytes_;
+      oversized_bytes_ = 0;
+      oversized_.clear();
+      chunk_ = 0;
+      used_ = 0;
+      frame_bytes_ = 0;
+   }
+
+} // namespace vertexsim
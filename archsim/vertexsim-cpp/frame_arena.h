@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace vertexsim {
+
+   struct FrameArenaStats {
+      std::uint64_t frames = 0;
+      // Bytes handed out during the last completed frame, and the most in
+      // any one frame, alignment padding included
+      std::size_t last_frame_bytes = 0;
+      std::size_t peak_frame_bytes = 0;
+      std::size_t bytes_reserved = 0;
+      // Requests too large for a chunk, which bypass the chunk list
+      std::uint64_t oversized_allocations = 0;
+   };
+
+   /// Bump allocator for memory that lives for one frame: recorded commands,
+   /// per-draw state and transient vertex batches. Allocation is a pointer
+   /// bump; Reset() ends the frame and makes every chunk reusable without
+   /// returning it to the heap. Not thread-safe: each thread uses its own.
+   class FrameArena {
+   public:
+      static constexpr std::size_t kDefaultChunkBytes = std::size_t{64} << 10;
+
+      explicit FrameArena(std::size_t chunk_bytes = kDefaultChunkBytes);
+
+      FrameArena(FrameArena&&) noexcept = default;
+      FrameArena& operator=(FrameArena&&) noexcept = default;
+      FrameArena(FrameArena const&) = delete;
+      FrameArena& operator=(FrameArena const&) = delete;
+
+      /// Returns `size` bytes aligned to `alignment`, a power of two, valid
+      /// until the next Reset().
+      std::byte* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+      /// Value-initialized array of `count` objects. Nothing is destroyed on
+      /// Reset(), so `T` must be trivially destructible.
+      template <typename T>
+      std::span<T> AllocateArray(std::size_t count) {
+         static_assert(std::is_trivially_destructible_v<T>);
+         auto* const p = reinterpret_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+         std::uninitialized_value_construct_n(p, count);
+         return {p, count};
+      }
+
+      /// Ends the frame: everything allocated since the last Reset() is
+      /// released at once.
+      void Reset();
+
+      std::size_t chunk_bytes() const { return chunk_bytes_; }
+      std::size_t frame_bytes() const { return frame_bytes_; }
+      FrameArenaStats const& stats() const { return stats_; }
+
+   private:
+      std::size_t chunk_bytes_;
+      std::vector<std::unique_ptr<std::byte[]>> chunks_;
+      std::vector<std::unique_ptr<std::byte[]>> oversized_;
+      std::size_t oversized_bytes_ = 0;
+      std::size_t chunk_ = 0;
+      std::size_t used_ = 0;
+      std::size_t frame_bytes_ = 0;
+      FrameArenaStats stats_;
+   };
+
+} // namespace vertexsim
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "indexed_mesh.h"
+
+namespace vertexsim {
+
+   enum class BufferHandle : std::uint32_t {};
+   enum class FenceHandle : std::uint32_t {};
+   enum class PipelineHandle : std::uint32_t {};
+   enum class QueryPoolHandle : std::uint32_t {};
+
+   /// Fixed-function state registers written by SetState.
+   enum class RenderState : std::uint16_t {
+      kTopology,
+      kCullMode,
+      kFrontFace,
+      kDepthTestEnable,
+      kDepthWriteEnable,
+      kDepthCompare,
+      kBlendEnable,
+      kColorWriteMask,
+      kPrimitiveRestartEnable,
+      kProvokingVertex,
+   };
+   inline constexpr std::size_t kRenderStateCount = 10;
+
+   enum class PrimitiveTopology : std::uint32_t {
+      kPointList,
+      kLineList,
+      kLineStrip,
+      kTriangleList,
+      kTriangleStrip,
+      kTriangleFan,
+      // Adjacent vertices are consumed but not assembled, as there is no
+      // geometry stage to read them
+      kLineListWithAdjacency,
+      kLineStripWithAdjacency,
+      kTriangleListWithAdjacency,
+      kTriangleStripWithAdjacency,
+   };
+
+   /// Vertex whose attributes flat-shaded primitives use. Zero is OpenGL's
+   /// default, the last vertex.
+   enum class ProvokingVertex : std::uint32_t {
+      kLast,
+      kFirst,
+   };
+
+   enum class CullMode : std::uint32_t {
+      kNone,
+      kFront,
+      kBack,
+   };
+
+   enum class FrontFace : std::uint32_t {
+      kCounterClockwise,
+      kClockwise,
+   };
+
+   enum class CompareOp : std::uint32_t {
+      kNever,
+      kLess,
+      kEqual,
+      kLessOrEqual,
+      kGreater,
+      kNotEqual,
+      kGreaterOrEqual,
+      kAlways,
+   };
+
+   // One binding per SoA vertex stream
+   inline constexpr std::uint32_t kMaxVertexBuffers = kVertexStreamCount;
+
+   /// Command packet opcodes. A command stream is a sequence of packets, each
+   /// a CommandHeader followed by the matching *Command struct and, for some
+   /// opcodes, inline data.
+   enum class CommandOp : std::uint16_t {
+      kNop,
+      kSetState,
+      kBindVertexBuffer,
+      kBindIndexBuffer,
+      kUpdateBuffer,
+      kDraw,
+      kDrawIndexed,
+      kSignalFence,
+      kWaitFence,
+      kExecuteCommands,
+      kMultiDraw,
+      kMultiDrawIndexed,
+      kDrawIndirect,
+      kMultiDrawIndexedIndirect,
+      kCopyBuffer,
+      kBindPipeline,
+      kWriteTimestamp,
+      kBeginQuery,
+      kEndQuery,
+   };
+
+   struct CommandHeader {
+      CommandOp op;
+      std::uint16_t reserved = 0;
+      // Whole packet in bytes, a multiple of kCommandAlignment
+      std::uint32_t size;
+   };
+   inline constexpr std::size_t kCommandAlignment = 8;
+
+   struct SetStateCommand {
+      static constexpr CommandOp kOp = CommandOp::kSetState;
+      RenderState state;
+      std::uint16_t reserved;
+      std::uint32_t value;
+   };
+
+   /// Loads every render state register from a compiled pipeline at once.
+   struct BindPipelineCommand {
+      static constexpr CommandOp kOp = CommandOp::kBindPipeline;
+      PipelineHandle pipeline;
+      std::uint32_t reserved;
+   };
+
+   struct BindVertexBufferCommand {
+      static constexpr CommandOp kOp = CommandOp::kBindVertexBuffer;
+      std::uint32_t slot;
+      BufferHandle buffer;
+      std::uint64_t offset;
+      std::uint32_t stride;
+      std::uint32_t reserved;
+   };
+
+   struct BindIndexBufferCommand {
+      static constexpr CommandOp kOp = CommandOp::kBindIndexBuffer;
+      BufferHandle buffer;
+      IndexFormat format;
+      std::array<std::uint8_t, 3> reserved;
+      std::uint64_t offset;
+   };
+
+   /// Followed by `size` bytes to copy into the buffer.
+   struct UpdateBufferCommand {
+      static constexpr CommandOp kOp = CommandOp::kUpdateBuffer;
+      BufferHandle buffer;
+      std::uint32_t reserved;
+      std::uint64_t offset;
+      std::uint64_t size;
+   };
+
+   /// GPU-side copy between buffers, or within one as long as the ranges do
+   /// not overlap.
+   struct CopyBufferCommand {
+      static constexpr CommandOp kOp = CommandOp::kCopyBuffer;
+      BufferHandle src;
+      BufferHandle dst;
+      std::uint64_t src_offset;
+      std::uint64_t dst_offset;
+      std::uint64_t size;
+   };
+
+   struct DrawCommand {
+      static constexpr CommandOp kOp = CommandOp::kDraw;
+      std::uint32_t vertex_count;
+      std::uint32_t instance_count;
+      std::uint32_t first_vertex;
+      std::uint32_t first_instance;
+   };
+
+   struct DrawIndexedCommand {
+      static constexpr CommandOp kOp = CommandOp::kDrawIndexed;
+      std::uint32_t index_count;
+      std::uint32_t instance_count;
+      std::uint32_t first_index;
+      std::int32_t vertex_offset;
+      std::uint32_t first_instance;
+   };
+
+   /// Stores the queue's cycle counter in a timestamp query once every
+   /// earlier command on the queue has executed.
+   struct WriteTimestampCommand {
+      static constexpr CommandOp kOp = CommandOp::kWriteTimestamp;
+      QueryPoolHandle pool;
+      std::uint32_t query;
+   };
+
+   /// Starts counting for an occlusion or pipeline-statistics query. The
+   /// query is unavailable until the matching EndQuery.
+   struct BeginQueryCommand {
+      static constexpr CommandOp kOp = CommandOp::kBeginQuery;
+      QueryPoolHandle pool;
+      std::uint32_t query;
+   };
+
+   struct EndQueryCommand {
+      static constexpr CommandOp kOp = CommandOp::kEndQuery;
+      QueryPoolHandle pool;
+      std::uint32_t query;
+   };
+
+   struct SignalFenceCommand {
+      static constexpr CommandOp kOp = CommandOp::kSignalFence;
+      FenceHandle fence;
+      std::uint32_t reserved;
+      std::uint64_t value;
+   };
+
+   /// Followed by `draw_count` DrawCommand bodies, executed in order with
+   /// the same bound state.
+   struct MultiDrawCommand {
+      static constexpr CommandOp kOp = CommandOp::kMultiDraw;
+      std::uint32_t draw_count;
+      std::uint32_t reserved;
+   };
+
+   /// Followed by `draw_count` DrawIndexedCommand bodies.
+   struct MultiDrawIndexedCommand {
+      static constexpr CommandOp kOp = CommandOp::kMultiDrawIndexed;
+      std::uint32_t draw_count;
+      std::uint32_t reserved;
+   };
+
+   /// Executes `draw_count` draws whose arguments the command processor
+   /// reads from buffer memory, `stride` bytes apart. Each record has the
+   /// layout of a DrawCommand body, like VkDrawIndirectCommand.
+   struct DrawIndirectCommand {
+      static constexpr CommandOp kOp = CommandOp::kDrawIndirect;
+      BufferHandle buffer;
+      std::uint32_t draw_count;
+      std::uint64_t offset;
+      std::uint32_t stride;
+      std::uint32_t reserved;
+   };
+
+   inline constexpr std::uint32_t kIndirectCountBuffer = 1 << 0;
+
+   /// Indexed draws with arguments in DrawIndexedCommand layout read from
+   /// buffer memory. With kIndirectCountBuffer set, the number of draws is
+   /// a uint32 read from `count_buffer`, clamped to `max_draw_count`, so the
+   /// GPU itself can decide how much to draw.
+   struct MultiDrawIndexedIndirectCommand {
+      static constexpr CommandOp kOp = CommandOp::kMultiDrawIndexedIndirect;
+      BufferHandle buffer;
+      BufferHandle count_buffer;
+      std::uint64_t offset;
+      std::uint64_t count_offset;
+      std::uint32_t max_draw_count;
+      std::uint32_t stride;
+      std::uint32_t flags;
+      std::uint32_t reserved;
+   };
+
+   /// Stalls the queue until the fence reaches `value`.
+   struct WaitFenceCommand {
+      static constexpr CommandOp kOp = CommandOp::kWaitFence;
+      FenceHandle fence;
+      std::uint32_t reserved;
+      std::uint64_t value;
+   };
+
+   /// Executes a recorded command list in place, like an indirect buffer.
+   /// The memory must stay valid until the queue has passed this packet.
+   struct ExecuteCommandsCommand {
+      static constexpr CommandOp kOp = CommandOp::kExecuteCommands;
+      std::uint64_t address;
+      std::uint64_t size;
+   };
+
+   /// Bytes taken by a `T` packet carrying `inline_bytes` of data.
+   template <typename T>
+   constexpr std::size_t CommandSize(std::size_t inline_bytes = 0) {
+      std::size_t const size = sizeof(CommandHeader) + sizeof(T) + inline_bytes;
+      return (size + kCommandAlignment - 1) & ~(kCommandAlignment - 1);
+   }
+
+   /// Writes a `T` packet to the start of `out`, which must hold
+   /// CommandSize<T>(data.size()) bytes.
+   template <typename T>
+   void EncodeCommand(std::span<std::byte> out, T const& command,
+                      std::span<std::byte const> data = {}) {
+      // Padding would carry stale stack bytes into the stream
+      static_assert(std::has_unique_object_representations_v<T>);
+      std::size_t const size = CommandSize<T>(data.size());
+      CommandHeader const header{T::kOp, 0, static_cast<std::uint32_t>(size)};
+      std::byte* p = out.data();
+      std::memcpy(p, &header, sizeof(header));
+      p += sizeof(header);
+      std::memcpy(p, &command, sizeof(command));
+      p += sizeof(command);
+      if (!data.empty()) std::memcpy(p, data.data(), data.size());
+      p += data.size();
+      // Zero the alignment padding so identical streams are byte-identical
+      std::memset(p, 0, out.data() + size - p);
+   }
+
+   /// Walks the packets of a command stream in place.
+   class CommandReader {
+   public:
+      explicit CommandReader(std::span<std::byte const> stream) : stream_{stream} {}
+
+      bool AtEnd() const { return stream_.empty(); }
+
+      /// Header of the current packet.
+      CommandHeader Peek() const {
+         if (stream_.size() < sizeof(CommandHeader))
+            throw std::runtime_error("Truncated command packet");
+         CommandHeader header;
+         std::memcpy(&header, stream_.data(), sizeof(header));
+         if (header.size < sizeof(header) || header.size > stream_.size() ||
+             header.size % kCommandAlignment != 0)
+            throw std::runtime_error("Malformed command packet");
+         return header;
+      }
+
+      /// Body of the current packet, which must be a `T`.
+      template <typename T>
+      T Read() const {
+         if (Peek().size < sizeof(CommandHeader) + sizeof(T))
+            throw std::runtime_error("Truncated command packet");
+         T command;
+         std::memcpy(&command, stream_.data() + sizeof(CommandHeader), sizeof(T));
+         return command;
+      }
+
+      /// Inline data after a `T` packet body, up to the end of the packet.
+      template <typename T>
+      std::span<std::byte const> InlineData() const {
+         return stream_.subspan(sizeof(CommandHeader) + sizeof(T),
+                                Peek().size - sizeof(CommandHeader) - sizeof(T));
+      }
+
+      void Next() { stream_ = stream_.subspan(Peek().size); }
+
+   private:
+      std::span<std::byte const> stream_;
+   };
+
+} // namespace vertexsim
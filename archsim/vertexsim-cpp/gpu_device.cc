@@ -0,0 +1,78 @@
+#include "gpu_device.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace vertexsim {
+
+   BufferHandle GpuDevice::CreateBuffer(std::size_t size) {
+      auto storage = std::make_unique<std::byte[]>(size);
+      std::byte* const data = storage.get();
+      return AddBuffer({data, size, std::move(storage), nullptr});
+   }
+
+   BufferHandle GpuDevice::CreateHostBuffer(std::span<std::byte> memory,
+                                            std::shared_ptr<void> owner) {
+      return AddBuffer({memory.data(), memory.size(), nullptr, std::move(owner)});
+   }
+
+   BufferHandle GpuDevice::AddBuffer(Buffer buffer) {
+      std::lock_guard lock{mutex_};
+      buffers_.push_back(std::move(buffer));
+      return static_cast<BufferHandle>(buffers_.size() - 1);
+   }
+
+   std::span<std::byte> GpuDevice::buffer(BufferHandle handle) const {
+      std::lock_guard lock{mutex_};
+      auto const i = static_cast<std::size_t>(handle);
+      if (i >= buffers_.size()) throw std::out_of_range("Unknown buffer handle");
+      return {buffers_[i].data, buffers_[i].size};
+   }
+
+   FenceHandle GpuDevice::CreateFence(std::uint64_t initial_value) {
+      auto fence = std::make_unique<TimelineFence>(initial_value);
+      std::lock_guard lock{mutex_};
+      fences_.push_back(std::move(fence));
+      return static_cast<FenceHandle>(fences_.size() - 1);
+   }
+
+   TimelineFence& GpuDevice::fence(FenceHandle handle) const {
+      std::lock_guard lock{mutex_};
+      auto const i = static_cast<std::size_t>(handle);
+      if (i >= fences_.size()) throw std::out_of_range("Unknown fence handle");
+      return *fences_[i];
+   }
+
+   PipelineHandle GpuDevice::CreatePipeline(Pipeline const& pipeline) {
+      std::lock_guard lock{mutex_};
+      pipelines_.push_back(pipeline);
+      return static_cast<PipelineHandle>(pipelines_.size() - 1);
+   }
+
+   Pipeline const& GpuDevice::pipeline(PipelineHandle handle) const {
+      std::lock_guard lock{mutex_};
+      auto const i = static_cast<std::size_t>(handle);
+      if (i >= pipelines_.size()) throw std::out_of_range("Unknown pipeline handle");
+      return pipelines_[i];
+   }
+
+   QueryPoolHandle GpuDevice::CreateQueryPool(QueryType type, std::uint32_t size) {
+      auto pool = std::make_unique<QueryPool>(type, size);
+      std::lock_guard lock{mutex_};
+      query_pools_.push_back(std::move(pool));
+      return static_cast<QueryPoolHandle>(query_pools_.size() - 1);
+   }
+
+   QueryPool& GpuDevice::query_pool(QueryPoolHandle handle) const {
+      std::lock_guard lock{mutex_};
+      auto const i = static_cast<std::size_t>(handle);
+      if (i >= query_pools_.size()) throw std::out_of_range("Unknown query pool handle");
+      return *query_pools_[i];
+   }
+
+   void GpuDevice::SignalAllFences() {
+      std::lock_guard lock{mutex_};
+      for (auto& fence : fences_) fence->Signal(std::numeric_limits<std::uint64_t>::max());
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "gpu_command.h"
+#include "pipeline.h"
+#include "query_pool.h"
+
+namespace vertexsim {
+
+   /// Monotonic 64-bit counter that the GPU signals and the host or other
+   /// queues wait on, like a Vulkan timeline semaphore.
+   class TimelineFence {
+   public:
+      explicit TimelineFence(std::uint64_t value = 0) : value_{value} {}
+
+      std::uint64_t value() const { return value_.load(std::memory_order_acquire); }
+      /// Simulated cycle of the latest signal, so that waiting queues can
+      /// catch their clocks up to the signalling queue.
+      std::uint64_t cycle() const { return cycle_.load(std::memory_order_acquire); }
+
+      /// Raises the fence to `value`. Fences only move forward, so a late
+      /// signal cannot undo a lost device forcing every fence to the maximum.
+      void Signal(std::uint64_t value, std::uint64_t cycle = 0) {
+         {
+            // Only the signal that raises the value may set the cycle, and
+            // the cycle must be visible before a waiter sees the new value
+            std::lock_guard lock{signal_mutex_};
+            if (value <= value_.load(std::memory_order_relaxed)) return;
+            cycle_.store(cycle, std::memory_order_relaxed);
+            value_.store(value, std::memory_order_release);
+         }
+         value_.notify_all();
+      }
+
+      /// Blocks until the fence reaches `value`.
+      void Wait(std::uint64_t value) const {
+         for (std::uint64_t current = this->value(); current < value; current = this->value())
+            value_.wait(current, std::memory_order_acquire);
+      }
+
+   private:
+      std::atomic<std::uint64_t> value_;
+      std::atomic<std::uint64_t> cycle_{0};
+      std::mutex signal_mutex_;
+   };
+
+   /// Objects shared by the host-side driver and the simulated GPU. Objects
+   /// live as long as the device, so a looked-up reference stays valid while
+   /// other threads create more.
+   class GpuDevice {
+   public:
+      BufferHandle CreateBuffer(std::size_t size);
+      /// Wraps `memory` as a buffer without copying it. The memory must
+      /// outlive the device unless `owner` keeps it alive.
+      BufferHandle CreateHostBuffer(std::span<std::byte> memory, std::shared_ptr<void> owner = {});
+      /// Throws std::out_of_range for unknown handles.
+      std::span<std::byte> buffer(BufferHandle handle) const;
+
+      FenceHandle CreateFence(std::uint64_t initial_value = 0);
+      TimelineFence& fence(FenceHandle handle) const;
+
+      PipelineHandle CreatePipeline(Pipeline const& pipeline);
+      Pipeline const& pipeline(PipelineHandle handle) const;
+
+      QueryPoolHandle CreateQueryPool(QueryType type, std::uint32_t size);
+      QueryPool& query_pool(QueryPoolHandle handle) const;
+
+      /// Releases every waiter after a fatal GPU error by signalling all
+      /// fences to the maximum value.
+      void SignalAllFences();
+
+   private:
+      struct Buffer {
+         std::byte* data;
+         std::size_t size;
+         // Device-allocated memory, or whatever keeps host memory alive
+         std::unique_ptr<std::byte[]> storage;
+         std::shared_ptr<void> owner;
+      };
+
+      BufferHandle AddBuffer(Buffer buffer);
+
+      mutable std::mutex mutex_;
+      std::vector<Buffer> buffers_;
+      std::vector<std::unique_ptr<TimelineFence>> fences_;
+      std::deque<Pipeline> pipelines_;
+      std::vector<std::unique_ptr<QueryPool>> query_pools_;
+   };
+
+} // namespace vertexsim
@@ -0,0 +1,274 @@
+#include "gpu_driver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace vertexsim {
+
+   GpuDriver::GpuDriver(DrawHandler on_draw, GpuDriverOptions const& options)
+         : CommandEncoder{options.recording},
+           pipeline_cache_{options.pipeline_cache_path},
+           clock_hz_{options.cycles.clock_hz} {
+      if (options.queue_count == 0) throw std::invalid_argument("GpuDriver needs a queue");
+      if (!options.capture_path.empty())
+         trace_ = std::make_unique<TraceWriter>(options.capture_path, options.queue_count);
+      // The last queue is the copy queue, which never draws
+      for (std::uint32_t i = 0; i <= options.queue_count; ++i)
+         queues_.push_back(std::make_unique<Queue>(
+               device_, i < options.queue_count ? on_draw : DrawHandler{}, options));
+      queues_.back()->processor.SetCopyBandwidth(options.copy_bytes_per_second);
+      if (options.staging_bytes != 0) {
+         // Created through the driver so that traces replay them too
+         staging_buffer_ = CreateBuffer(options.staging_bytes);
+         copy_fence_ = CreateFence();
+         staging_.emplace(options.staging_bytes);
+      }
+      // Front-ends start last: once one runs, unwinding must close the rings
+      // or destroying its jthread would never return
+      try {
+         for (auto& queue : queues_)
+            queue->front_end = std::jthread{[this, &queue = *queue] { RunFrontEnd(queue); }};
+      } catch (...) {
+         for (auto& queue : queues_) queue->ring.Close();
+         throw;
+      }
+   }
+
+   GpuDriver::~GpuDriver() {
+      Flush();
+      for (auto& queue : queues_) queue->ring.Close();
+      for (auto& queue : queues_) queue->front_end.join();
+      try {
+         pipeline_cache_.Save();
+      } catch (std::exception const& e) {
+         std::cerr << "Warning: " << e.what() << std::endl;
+      }
+   }
+
+   BufferHandle GpuDriver::CreateBuffer(std::size_t size) {
+      if (!trace_) return device_.CreateBuffer(size);
+      std::lock_guard lock{trace_mutex_};
+      auto const buffer = device_.CreateBuffer(size);
+      trace_->CreateBuffer(buffer, size);
+      return buffer;
+   }
+
+   FenceHandle GpuDriver::CreateFence(std::uint64_t initial_value) {
+      if (!trace_) return device_.CreateFence(initial_value);
+      std::lock_guard lock{trace_mutex_};
+      auto const fence = device_.CreateFence(initial_value);
+      trace_->CreateFence(fence, initial_value);
+      return fence;
+   }
+
+   PipelineHandle GpuDriver::CreatePipeline(PipelineDesc const& desc) {
+      Pipeline const& pipeline = pipeline_cache_.Get(desc);
+      std::lock_guard lock{pipeline_mutex_};
+      if (auto const it = pipelines_.find(&pipeline); it != pipelines_.end()) return it->second;
+      auto const handle = device_.CreatePipeline(pipeline);
+      pipelines_.emplace(&pipeline, handle);
+      if (trace_) {
+         std::lock_guard trace_lock{trace_mutex_};
+         trace_->CreatePipeline(handle, desc);
+      }
+      return handle;
+   }
+
+   QueryPoolHandle GpuDriver::CreateQueryPool(QueryType type, std::uint32_t size) {
+      if (!trace_) return device_.CreateQueryPool(type, size);
+      std::lock_guard lock{trace_mutex_};
+      auto const pool = device_.CreateQueryPool(type, size);
+      trace_->CreateQueryPool(pool, type, size);
+      return pool;
+   }
+
+   bool GpuDriver::GetQueryResults(QueryPoolHandle pool, std::uint32_t first, std::uint32_t count,
+                                   std::span<std::uint64_t> results) {
+      CheckLost();
+      return device_.query_pool(pool).Read(first, count, results);
+   }
+
+   BufferHandle GpuDriver::CreateHostBuffer(std::span<std::byte> memory,
+                                            std::shared_ptr<void> owner) {
+      flushed_bytes_.fetch_add(memory.size(), std::memory_order_relaxed);
+      if (!trace_) return device_.CreateHostBuffer(memory, std::move(owner));
+      // A replay has no host memory to wrap: it creates a plain buffer and
+      // writes the contents into it
+      std::lock_guard lock{trace_mutex_};
+      auto const buffer = device_.CreateHostBuffer(memory, std::move(owner));
+      trace_->CreateBuffer(buffer, memory.size());
+      trace_->HostWrite(buffer, 0, memory);
+      return buffer;
+   }
+
+   void GpuDriver::FlushMappedRange(BufferHandle buffer, std::uint64_t offset,
+                                    std::uint64_t size) {
+      auto const mapped = device_.buffer(buffer);
+      if (offset > mapped.size() || size > mapped.size() - offset)
+         throw std::out_of_range("Flushed range is outside the buffer");
+      // Front-ends acquire the ring after this, which publishes the writes
+      std::atomic_thread_fence(std::memory_order_release);
+      flushed_bytes_.fetch_add(size, std::memory_order_relaxed);
+      if (!trace_) return;
+      std::lock_guard lock{trace_mutex_};
+      trace_->HostWrite(buffer, offset, mapped.subspan(offset, size));
+   }
+
+   template <typename T>
+   void GpuDriver::SubmitTo(std::uint32_t queue, T const& command) {
+      SpscRing& ring = queues_[queue]->ring;
+      auto const packet = ring.BeginWrite(CommandSize<T>());
+      EncodeCommand(packet, command);
+      if (trace_) Capture(queue, packet);
+      ring.EndWrite();
+   }
+
+   void GpuDriver::Submit(std::uint32_t queue, std::span<CommandList const> lists,
+                          std::span<FenceValue const> waits,
+                          std::span<FenceValue const> signals) {
+      if (queue >= queues_.size()) throw std::out_of_range("Unknown queue");
+      for (CommandList const& list : lists)
+         if (list.has_pending_draws()) throw std::logic_error("Command list was not flushed");
+      if (queue == 0) {
+         // Keep immediate draws ahead of the lists, which also change the
+         // state queue 0 has bound
+         Flush();
+         InvalidateState();
+      }
+      for (FenceValue const& wait : waits)
+         SubmitTo(queue, WaitFenceCommand{wait.fence, 0, wait.value});
+      SpscRing& ring = queues_[queue]->ring;
+      for (CommandList const& list : lists) {
+         for (auto const segment : list.segments()) {
+            // Traces get the packets themselves instead, since the list's
+            // memory is long gone when they are replayed
+            if (trace_) Capture(queue, segment);
+            ExecuteCommandsCommand const execute{reinterpret_cast<std::uintptr_t>(segment.data()),
+                                                 segment.size()};
+            EncodeCommand(ring.BeginWrite(CommandSize<ExecuteCommandsCommand>()), execute);
+            ring.EndWrite();
+         }
+      }
+      for (FenceValue const& signal : signals)
+         SubmitTo(queue, SignalFenceCommand{signal.fence, 0, signal.value});
+   }
+
+   FenceValue GpuDriver::UploadBuffer(BufferHandle buffer, std::uint64_t offset,
+                                      std::span<std::byte const> data) {
+      if (!staging_) throw std::logic_error("GpuDriver has no staging ring");
+      std::uint32_t const copy = copy_queue();
+      auto const staging = device_.buffer(staging_buffer_);
+      TimelineFence const& copy_fence = device_.fence(copy_fence_);
+      // Chunks of a quarter ring keep several copies in flight
+      std::size_t const max_chunk = std::max<std::size_t>(staging_->size() / 4, 1);
+      for (std::size_t done = 0; done < data.size();) {
+         std::size_t const chunk = std::min(max_chunk, data.size() - done);
+         std::uint64_t const value = copy_fence_value_ + 1;
+         staging_->Retire(copy_fence.value());
+         auto at = staging_->TryAllocate(chunk, value);
+         while (!at) {
+            WaitFence(copy_fence_, *staging_->oldest_fence_value());
+            staging_->Retire(copy_fence.value());
+            at = staging_->TryAllocate(chunk, value);
+         }
+         std::memcpy(staging.data() + *at, data.data() + done, chunk);
+         if (trace_) {
+            // The host writes staging memory directly, so the trace gets
+            // its contents as updates that each fit a ring record
+            std::size_t const max_update = queues_[copy]->ring.max_record_size() -
+                                           CommandSize<UpdateBufferCommand>() - kCommandAlignment;
+            std::vector<std::byte> update;
+            for (std::size_t part = 0; part < chunk;) {
+               std::size_t const size = std::min(max_update, chunk - part);
+               update.resize(CommandSize<UpdateBufferCommand>(size));
+               EncodeCommand(update, UpdateBufferCommand{staging_buffer_, 0, *at + part, size},
+                             data.subspan(done + part, size));
+               Capture(copy, update);
+               part += size;
+            }
+         }
+         SubmitTo(copy, CopyBufferCommand{staging_buffer_, buffer, *at, offset + done, chunk});
+         SubmitTo(copy, SignalFenceCommand{copy_fence_, 0, value});
+         copy_fence_value_ = value;
+         done += chunk;
+      }
+      return {copy_fence_, copy_fence_value_};
+   }
+
+   void GpuDriver::SubmitPackets(std::uint32_t queue, std::span<std::byte const> packets) {
+      if (queue >= queues_.size()) throw std::out_of_range("Unknown queue");
+      if (queue == 0) {
+         Flush();
+         InvalidateState();
+      }
+      SpscRing& ring = queues_[queue]->ring;
+      // Packets are batched into records as large as the ring allows
+      while (!packets.empty()) {
+         std::size_t size = 0;
+         for (CommandReader reader{packets}; !reader.AtEnd(); reader.Next()) {
+            std::size_t const packet = reader.Peek().size;
+            if (size + packet > ring.max_record_size()) break;
+            size += packet;
+         }
+         if (size == 0) throw std::length_error("Command packet does not fit the ring");
+         auto const record = ring.BeginWrite(size);
+         std::memcpy(record.data(), packets.data(), size);
+         if (trace_) Capture(queue, record);
+         ring.EndWrite();
+         packets = packets.subspan(size);
+      }
+   }
+
+   void GpuDriver::WaitFence(FenceHandle fence, std::uint64_t value) {
+      device_.fence(fence).Wait(value);
+      CheckLost();
+      // Host writes captured after this must not overtake the GPU on replay
+      if (!trace_) return;
+      std::lock_guard lock{trace_mutex_};
+      trace_->HostWait(fence, value);
+   }
+
+   void GpuDriver::Finish() {
+      Flush();
+      // Finish fences stay out of traces: a replaying driver signals its own,
+      // which captured signals would have pushed ahead of its count
+      for (auto& queue : queues_) {
+         SignalFenceCommand const signal{queue->finish_fence, 0, ++queue->finish_value};
+         EncodeCommand(queue->ring.BeginWrite(CommandSize<SignalFenceCommand>()), signal);
+         queue->ring.EndWrite();
+      }
+      for (auto& queue : queues_) device_.fence(queue->finish_fence).Wait(queue->finish_value);
+      CheckLost();
+      if (!trace_) return;
+      std::lock_guard lock{trace_mutex_};
+      trace_->Finish();
+   }
+
+   void GpuDriver::Capture(std::uint32_t queue, std::span<std::byte const> packets) {
+      std::lock_guard lock{trace_mutex_};
+      trace_->Commands(queue, packets);
+   }
+
+   void GpuDriver::RunFrontEnd(Queue& queue) {
+      for (auto record = queue.ring.BeginRead(); !record.empty(); record = queue.ring.BeginRead()) {
+         // After a failure the ring is still drained so the host never blocks
+         if (!lost_.load(std::memory_order_acquire)) {
+            try {
+               queue.processor.Execute(record);
+            } catch (...) {
+               std::call_once(error_once_, [&] { error_ = std::current_exception(); });
+               lost_.store(true, std::memory_order_release);
+               device_.SignalAllFences();
+            }
+         }
+         queue.ring.EndRead();
+      }
+   }
+
+   void GpuDriver::CheckLost() const {
+      if (lost_.load(std::memory_order_acquire)) std::rethrow_exception(error_);
+   }
+
+} // namespace vertexsim
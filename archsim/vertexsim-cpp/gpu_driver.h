@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "command_list.h"
+#include "command_processor.h"
+#include "command_trace.h"
+#include "gpu_command.h"
+#include "gpu_device.h"
+#include "pipeline.h"
+#include "spsc_ring.h"
+#include "staging_ring.h"
+
+namespace vertexsim {
+
+   struct GpuDriverOptions {
+      std::size_t ring_bytes = std::size_t{1} << 20;
+      // Hardware queues, each with its own ring and front-end thread
+      std::uint32_t queue_count = 1;
+      // Applies to the immediate commands; command lists take their own
+      RecordingOptions recording;
+      // When set, everything submitted is captured to this .vstrace file
+      std::filesystem::path capture_path;
+      // Persistent staging memory for UploadBuffer(); zero disables it
+      std::size_t staging_bytes = std::size_t{16} << 20;
+      // Modeled DMA bandwidth of the copy queue, in simulated time; zero
+      // copies at cycles.bytes_per_cycle
+      double copy_bytes_per_second = 0;
+      // Compiled pipelines persist in this file across runs when set
+      std::filesystem::path pipeline_cache_path;
+      // Timing of every queue, for timestamp queries and busy cycles
+      CycleModel cycles;
+   };
+
+   /// A point on a fence's timeline, to wait for or to signal.
+   struct FenceValue {
+      FenceHandle fence;
+      std::uint64_t value;
+   };
+
+   /// Host-side driver for the simulated GPU. Commands are encoded into
+   /// lock-free rings that per-queue front-end threads drain into command
+   /// processors, so command generation overlaps with simulation like a real
+   /// driver and command processor. Besides the graphics queues there is a
+   /// copy queue, index copy_queue(), that models a DMA engine fed from a
+   /// persistent staging ring by UploadBuffer().
+   ///
+   /// The recording methods inherited from CommandEncoder go straight to
+   /// queue 0, apart from draws held back for coalescing, which follow with
+   /// the next non-draw command, Submit() to queue 0, Finish() or Flush().
+   /// Each queue is externally synchronized, like a Vulkan queue: one thread
+   /// at a time may record to or submit to it. The DrawHandler is called
+   /// from every queue's front-end thread, so it must be thread-safe when
+   /// there are several queues.
+   ///
+   /// A command that fails on the GPU side loses the device: later commands
+   /// on all queues are dropped, every fence is released, and the error is
+   /// rethrown from the next WaitFence() or Finish().
+   class GpuDriver : public CommandEncoder<GpuDriver> {
+   public:
+      explicit GpuDriver(DrawHandler on_draw = {}, GpuDriverOptions const& options = {});
+      /// Executes all outstanding commands, then stops the front-ends.
+      ~GpuDriver();
+
+      GpuDriver(GpuDriver const&) = delete;
+      GpuDriver& operator=(GpuDriver const&) = delete;
+
+      GpuDevice& device() { return device_; }
+      /// Graphics queues; the copy queue comes after them.
+      std::uint32_t queue_count() const { return static_cast<std::uint32_t>(queues_.size() - 1); }
+      std::uint32_t copy_queue() const { return queue_count(); }
+
+      BufferHandle CreateBuffer(std::size_t size);
+      FenceHandle CreateFence(std::uint64_t initial_value = 0);
+      /// Compiles `desc` through the pipeline cache. Equal descriptions share
+      /// one handle. Throws std::invalid_argument for invalid descriptions.
+      PipelineHandle CreatePipeline(PipelineDesc const& desc);
+      QueryPoolHandle CreateQueryPool(QueryType type, std::uint32_t size);
+
+      /// Wraps host memory as a buffer without copying it, like memory
+      /// imported from the host. The queues read it in place, so the caller
+      /// must not reuse a range before a fence shows that the GPU is done with
+      /// it. `owner`, if set, keeps the memory alive as long as the device.
+      /// The current contents count as flushed.
+      BufferHandle CreateHostBuffer(std::span<std::byte> memory, std::shared_ptr<void> owner = {});
+      /// Persistent mapping of `buffer`: stays valid for the driver's
+      /// lifetime, with no unmap. Writes through it become visible to the
+      /// queues only once flushed with FlushMappedRange().
+      std::span<std::byte> MapBuffer(BufferHandle buffer) { return device_.buffer(buffer); }
+      /// Makes host writes to [offset, offset + size) of a mapped buffer
+      /// visible to commands submitted afterwards, like
+      /// vkFlushMappedMemoryRanges. Unflushed writes may be missed by the
+      /// queues and are never captured to a trace.
+      void FlushMappedRange(BufferHandle buffer, std::uint64_t offset, std::uint64_t size);
+      /// Bytes wrapped by CreateHostBuffer() or flushed since, which the
+      /// driver never had to copy.
+      std::uint64_t flushed_bytes() const {
+         return flushed_bytes_.load(std::memory_order_relaxed);
+      }
+
+      /// Queues `lists` on `queue`. The queue first waits for every fence in
+      /// `waits`, then executes the lists in order without copying them, then
+      /// signals `signals`. The lists' arenas must not be reset before the
+      /// queue has passed the submission.
+      void Submit(std::uint32_t queue, std::span<CommandList const> lists,
+                  std::span<FenceValue const> waits = {},
+                  std::span<FenceValue const> signals = {});
+
+      /// Writes `data` into the staging ring and has the copy queue move it
+      /// into `buffer`, chunk by chunk, while the graphics queues carry on.
+      /// Blocks only while the staging ring is full. Returns the copy fence
+      /// value that signals completion, for queues or the host to wait on.
+      /// Externally synchronized with the copy queue.
+      FenceValue UploadBuffer(BufferHandle buffer, std::uint64_t offset,
+                              std::span<std::byte const> data);
+
+      /// Copies already encoded packets, such as a replayed trace, to `queue`.
+      void SubmitPackets(std::uint32_t queue, std::span<std::byte const> packets);
+
+      /// Blocks the host until the GPU has signalled `fence` with `value`.
+      void WaitFence(FenceHandle fence, std::uint64_t value);
+      /// Blocks until every command recorded so far on any queue has executed.
+      void Finish();
+
+      /// Copies the results of `count` queries from `first` on into `results`,
+      /// QueryValueCount() values each. Returns false if any of them is not
+      /// available yet; wait on a fence signalled after the queries to be
+      /// sure. Timestamps are in cycles, see timestamp_period().
+      bool GetQueryResults(QueryPoolHandle pool, std::uint32_t first, std::uint32_t count,
+                           std::span<std::uint64_t> results);
+      /// Seconds per timestamp cycle.
+      double timestamp_period() const { return 1 / clock_hz_; }
+
+      /// Front-end counters of one queue, including the copy queue, up to
+      /// date after Finish().
+      FrontEndStats const& stats(std::uint32_t queue = 0) const {
+         return queues_.at(queue)->processor.stats();
+      }
+      PipelineCacheStats pipeline_cache_stats() const { return pipeline_cache_.stats(); }
+
+   private:
+      friend class CommandEncoder<GpuDriver>;
+
+      struct Queue {
+         Queue(GpuDevice& device, DrawHandler on_draw, GpuDriverOptions const& options)
+               : ring{options.ring_bytes},
+                 processor{device, std::move(on_draw), options.cycles},
+                 finish_fence{device.CreateFence()} {}
+
+         SpscRing ring;
+         CommandProcessor processor;
+         FenceHandle finish_fence;
+         std::uint64_t finish_value = 0;
+         std::jthread front_end;
+      };
+
+      std::span<std::byte> BeginCommand(std::size_t size) {
+         return pending_ = queues_[0]->ring.BeginWrite(size);
+      }
+      void EndCommand() {
+         if (trace_) Capture(0, pending_);
+         queues_[0]->ring.EndWrite();
+      }
+      std::size_t max_command_size() const { return queues_[0]->ring.max_record_size(); }
+
+      template <typename T>
+      void SubmitTo(std::uint32_t queue, T const& command);
+      void Capture(std::uint32_t queue, std::span<std::byte const> packets);
+      void RunFrontEnd(Queue& queue);
+      void CheckLost() const;
+
+      GpuDevice device_;
+      std::vector<std::unique_ptr<Queue>> queues_;
+      // The first error on any queue; written before the fences are released
+      std::once_flag error_once_;
+      std::exception_ptr error_;
+      std::atomic<bool> lost_{false};
+      // Packet being encoded on queue 0, captured before it is published
+      std::span<std::byte> pending_;
+      // Captures from all queues and threads go through one lock, so the
+      // trace keeps the host's order and object creation stays in step
+      std::mutex trace_mutex_;
+      std::unique_ptr<TraceWriter> trace_;
+      PipelineCache pipeline_cache_;
+      // Handles by cache entry, so each pipeline reaches the device once
+      std::mutex pipeline_mutex_;
+      std::unordered_map<Pipeline const*, PipelineHandle> pipelines_;
+      std::optional<StagingRing> staging_;
+      BufferHandle staging_buffer_{};
+      FenceHandle copy_fence_{};
+      std::uint64_t copy_fence_value_ = 0;
+      std::atomic<std::uint64_t> flushed_bytes_{0};
+      double clock_hz_;
+   };
+
+} // namespace vertexsim
@@ -0,0 +1,87 @@
+#include "hash.h"
+
+#include <bit>
+#include <cstring>
+
+namespace vertexsim {
+
+   namespace {
+
+      constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87;
+      constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4F;
+      constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9;
+      constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63;
+      constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5;
+
+      static_assert(std::endian::native == std::endian::little,
+                    "Hash64 reads input words in little-endian order");
+
+      template <typename T>
+      T Load(std::byte const* p) {
+         T v;
+         std::memcpy(&v, p, sizeof(v));
+         return v;
+      }
+
+      std::uint64_t Round(std::uint64_t acc, std::uint64_t input) {
+         acc += input * kPrime2;
+         acc = std::rotl(acc, 31);
+         return acc * kPrime1;
+      }
+
+      std::uint64_t MergeRound(std::uint64_t acc, std::uint64_t val) {
+         acc ^= Round(0, val);
+         return acc * kPrime1 + kPrime4;
+      }
+
+   } // namespace
+
+   std::uint64_t Hash64(std::span<std::byte const> data, std::uint64_t seed) {
+      std::byte const* p = data.data();
+      std::byte const* const end = p + data.size();
+      std::uint64_t h;
+
+      if (data.size() >= 32) {
+         std::uint64_t v1 = seed + kPrime1 + kPrime2;
+         std::uint64_t v2 = seed + kPrime2;
+         std::uint64_t v3 = seed;
+         std::uint64_t v4 = seed - kPrime1;
+         for (; end - p >= 32; p += 32) {
+            v1 = Round(v1, Load<std::uint64_t>(p));
+            v2 = Round(v2, Load<std::uint64_t>(p + 8));
+            v3 = Round(v3, Load<std::uint64_t>(p + 16));
+            v4 = Round(v4, Load<std::uint64_t>(p + 24));
+         }
+         h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+         h = MergeRound(h, v1);
+         h = MergeRound(h, v2);
+         h = MergeRound(h, v3);
+         h = MergeRound(h, v4);
+      } else {
+         h = seed + kPrime5;
+      }
+
+      h += static_cast<std::uint64_t>(data.size());
+      for (; end - p >= 8; p += 8) {
+         h ^= Round(0, Load<std::uint64_t>(p));
+         h = std::rotl(h, 27) * kPrime1 + kPrime4;
+      }
+      if (end - p >= 4) {
+         h ^= static_cast<std::uint64_t>(Load<std::uint32_t>(p)) * kPrime1;
+         h = std::rotl(h, 23) * kPrime2 + kPrime3;
+         p += 4;
+      }
+      for (; p != end; ++p) {
+         h ^= static_cast<std::uint64_t>(*p) * kPrime5;
+         h = std::rotl(h, 11) * kPrime1;
+      }
+
+      h ^= h >> 33;
+      h *= kPrime2;
+      h ^= h >> 29;
+      h *= kPrime3;
+      h ^= h >> 32;
+      return h;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace vertexsim {
+
+   /// XXH64 of `data`. Fast enough to fingerprint multi-gigabyte inputs and
+   /// stable across platforms, so it is safe to persist in on-disk caches.
+   std::uint64_t Hash64(std::span<std::byte const> data, std::uint64_t seed = 0);
+
+} // namespace vertexsim
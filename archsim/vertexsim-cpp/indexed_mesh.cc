@@ -0,0 +1,74 @@
+#include "indexed_mesh.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace vertexsim {
+
+   namespace {
+
+      std::size_t AlignUp(std::size_t value) {
+         return (value + kStreamAlignment - 1) & ~(kStreamAlignment - 1);
+      }
+
+   } // namespace
+
+   MeshLayout MeshLayout::Compute(std::uint32_t vertex_count, std::uint64_t index_count,
+                                  IndexFormat index_format, bool has_normals,
+                                  bool has_texcoords) {
+      MeshLayout layout;
+      layout.vertex_count = vertex_count;
+      layout.index_count = index_count;
+      layout.index_format = index_format;
+      layout.has_normals = has_normals;
+      layout.has_texcoords = has_texcoords;
+      std::size_t offset = 0;
+      for (std::size_t i = 0; i < kVertexStreamCount; ++i) {
+         layout.stream_offset[i] = offset;
+         if (layout.HasStream(static_cast<VertexStream>(i)))
+            offset += AlignUp(vertex_count * sizeof(float));
+      }
+      layout.index_offset = offset;
+      layout.size = offset + AlignUp(index_count * static_cast<std::size_t>(index_format));
+      return layout;
+   }
+
+   bool MeshLayout::HasStream(VertexStream stream) const {
+      switch (stream) {
+         case VertexStream::kNormalX:
+         case VertexStream::kNormalY:
+         case VertexStream::kNormalZ:
+            return has_normals;
+         case VertexStream::kTexcoordU:
+         case VertexStream::kTexcoordV:
+            return has_texcoords;
+         default:
+            return true;
+      }
+   }
+
+   IndexedMesh::IndexedMesh(MeshLayout const& layout) : layout_{layout} {
+      auto const align = std::align_val_t{kStreamAlignment};
+      data_ = static_cast<std::byte*>(::operator new(layout.size, align));
+      owner_ = std::shared_ptr<void>(data_, [align](void* p) { ::operator delete(p, align); });
+      std::fill_n(data_, layout.size, std::byte{0});
+   }
+
+   IndexedMesh::IndexedMesh(MeshLayout const& layout, std::byte* data, std::shared_ptr<void> owner)
+         : layout_{layout}, data_{data}, owner_{std::move(owner)} {
+      if (reinterpret_cast<std::uintptr_t>(data) % kStreamAlignment != 0)
+         throw std::invalid_argument("IndexedMesh storage must be 64-byte aligned");
+   }
+
+   std::span<float> IndexedMesh::stream(VertexStream stream) {
+      if (!layout_.HasStream(stream)) return {};
+      auto const i = static_cast<std::size_t>(stream);
+      return {reinterpret_cast<float*>(data_ + layout_.stream_offset[i]), layout_.vertex_count};
+   }
+
+   std::span<float const> IndexedMesh::stream(VertexStream stream) const {
+      return const_cast<IndexedMesh*>(this)->stream(stream);
+   }
+
+} // namespace vertexsim
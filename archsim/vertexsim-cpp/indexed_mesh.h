@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace vertexsim {
+
+   /// One scalar component of a vertex attribute. Vertex data is stored as a
+   /// structure of arrays with one stream per component.
+   enum class VertexStream : std::uint8_t {
+      kPositionX,
+      kPositionY,
+      kPositionZ,
+      kNormalX,
+      kNormalY,
+      kNormalZ,
+      kTexcoordU,
+      kTexcoordV,
+   };
+   inline constexpr std::size_t kVertexStreamCount = 8;
+   inline constexpr std::size_t kStreamAlignment = 64;
+
+   /// Width of one index buffer element, in bytes.
+   enum class IndexFormat : std::uint8_t {
+      kUint16 = 2,
+      kUint32 = 4,
+   };
+
+   /// Byte layout of an IndexedMesh storage block. Every stream starts on a
+   /// kStreamAlignment boundary; absent attributes take no space. The layout
+   /// is the same in memory and in .gmesh files.
+   struct MeshLayout {
+      std::uint32_t vertex_count = 0;
+      std::uint64_t index_count = 0;
+      IndexFormat index_format = IndexFormat::kUint32;
+      bool has_normals = false;
+      bool has_texcoords = false;
+      std::array<std::size_t, kVertexStreamCount> stream_offset{};
+      std::size_t index_offset = 0;
+      std::size_t size = 0;
+
+      static MeshLayout Compute(std::uint32_t vertex_count, std::uint64_t index_count,
+                                IndexFormat index_format, bool has_normals, bool has_texcoords);
+      bool HasStream(VertexStream stream) const;
+   };
+
+   /// Index-buffered triangle list with SoA vertex streams, all held in one
+   /// aligned block. The block is either heap-allocated or borrowed from an
+   /// owner such as a memory-mapped cache file.
+   class IndexedMesh {
+   public:
+      IndexedMesh() = default;
+      /// Allocates zero-initialized storage for `layout`.
+      explicit IndexedMesh(MeshLayout const& layout);
+      /// Adopts `data`, which must be laid out according to `layout` and
+      /// aligned to kStreamAlignment. `owner` keeps the memory alive.
+      IndexedMesh(MeshLayout const& layout, std::byte* data, std::shared_ptr<void> owner);
+
+      IndexedMesh(IndexedMesh&&) noexcept = default;
+      IndexedMesh& operator=(IndexedMesh&&) noexcept = default;
+      IndexedMesh(IndexedMesh const&) = delete;
+      IndexedMesh& operator=(IndexedMesh const&) = delete;
+
+      MeshLayout const& layout() const { return layout_; }
+      std::uint32_t vertex_count() const { return layout_.vertex_count; }
+      std::uint64_t index_count() const { return layout_.index_count; }
+      IndexFormat index_format() const { return layout_.index_format; }
+      bool has_normals() const { return layout_.has_normals; }
+      bool has_texcoords() const { return layout_.has_texcoords; }
+
+      /// Empty if the attribute is absent.
+      std::span<float> stream(VertexStream stream);
+      std::span<float const> stream(VertexStream stream) const;
+      /// Index buffer as `T`, which must match index_format().
+      template <typename T>
+      std::span<T> indices() {
+         static_assert(std::is_same_v<T, std::uint16_t> || std::is_same_v<T, std::uint32_t>);
+         if (sizeof(T) != static_cast<std::size_t>(layout_.index_format))
+            throw std::logic_error("Index buffer accessed with the wrong format");
+         return {reinterpret_cast<T*>(data_ + layout_.index_offset), layout_.index_count};
+      }
+      template <typename T>
+      std::span<T const> indices() const {
+         return const_cast<IndexedMesh*>(this)->indices<T>();
+      }
+
+      /// Calls `fn` with the index buffer as a span of its actual type.
+      template <typename Fn>
+      decltype(auto) VisitIndices(Fn&& fn) {
+         if (layout_.index_format == IndexFormat::kUint16) return fn(indices<std::uint16_t>());
+         return fn(indices<std::uint32_t>());
+      }
+      template <typename Fn>
+      decltype(auto) VisitIndices(Fn&& fn) const {
+         if (layout_.index_format == IndexFormat::kUint16) return fn(indices<std::uint16_t>());
+         return fn(indices<std::uint32_t>());
+      }
+
+      std::uint32_t index(std::size_t i) const {
+         return VisitIndices([i](auto indices) -> std::uint32_t { return indices[i]; });
+      }
+
+      /// The whole storage block, as written to disk.
+      std::span<std::byte const> bytes() const { return {data_, layout_.size}; }
+
+   private:
+      MeshLayout layout_;
+      std::byte* data_ = nullptr;
+      std::shared_ptr<void> owner_;
+   };
+
+} // namespace vertexsim
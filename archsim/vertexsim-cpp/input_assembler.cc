@@ -0,0 +1,173 @@
+#include "input_assembler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "quantized_mesh.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      struct FormatInfo {
+         std::uint32_t components;
+         std::uint32_t component_bytes;
+      };
+
+      FormatInfo InfoOf(VertexFormat format) {
+         switch (format) {
+            case VertexFormat::kFloat32:
+               return {1, 4};
+            case VertexFormat::kFloat32x2:
+               return {2, 4};
+            case VertexFormat::kFloat32x3:
+               return {3, 4};
+            case VertexFormat::kFloat32x4:
+               return {4, 4};
+            case VertexFormat::kFloat16x2:
+               return {2, 2};
+            case VertexFormat::kFloat16x4:
+               return {4, 2};
+            case VertexFormat::kUnorm8x4:
+               return {4, 1};
+            case VertexFormat::kUnorm16x2:
+               return {2, 2};
+            case VertexFormat::kUnorm16x4:
+               return {4, 2};
+            case VertexFormat::kSnorm16x2:
+               return {2, 2};
+            case VertexFormat::kSnorm16x4:
+               return {4, 2};
+         }
+         throw std::invalid_argument("Unknown vertex format");
+      }
+
+      template <typename T>
+      T Load(std::byte const* data) {
+         T value;
+         std::memcpy(&value, data, sizeof value);
+         return value;
+      }
+
+      float DecodeComponent(VertexFormat format, std::byte const* data) {
+         switch (format) {
+            case VertexFormat::kFloat32:
+            case VertexFormat::kFloat32x2:
+            case VertexFormat::kFloat32x3:
+            case VertexFormat::kFloat32x4:
+               return Load<float>(data);
+            case VertexFormat::kFloat16x2:
+            case VertexFormat::kFloat16x4:
+               return HalfToFloat(Load<std::uint16_t>(data));
+            case VertexFormat::kUnorm8x4:
+               return Load<std::uint8_t>(data) / 255.0f;
+            case VertexFormat::kUnorm16x2:
+            case VertexFormat::kUnorm16x4:
+               return Load<std::uint16_t>(data) / 65535.0f;
+            case VertexFormat::kSnorm16x2:
+            case VertexFormat::kSnorm16x4:
+               return std::max(Load<std::int16_t>(data) / 32767.0f, -1.0f);
+         }
+         return 0;
+      }
+
+   } // namespace
+
+   std::uint32_t FormatSize(VertexFormat format) {
+      auto const info = InfoOf(format);
+      return info.components * info.component_bytes;
+   }
+
+   std::uint32_t FormatComponents(VertexFormat format) { return InfoOf(format).components; }
+
+   glm::vec4 DecodeAttribute(VertexFormat format, std::byte const* data) {
+      auto const info = InfoOf(format);
+      glm::vec4 value{0.0f, 0.0f, 0.0f, 1.0f};
+      for (std::uint32_t c = 0; c < info.components; ++c)
+         value[c] = DecodeComponent(format, data + c * info.component_bytes);
+      return value;
+   }
+
+   InputAssembler::InputAssembler(VertexLayout layout) : layout_{std::move(layout)} {
+      for (auto const& binding : layout_.bindings)
+         if (binding.slot >= kMaxVertexBuffers)
+            throw std::invalid_argument("Vertex binding slot out of range");
+      for (auto const& attribute : layout_.attributes) {
+         if (attribute.binding >= layout_.bindings.size())
+            throw std::invalid_argument("Vertex attribute refers to a missing binding");
+         auto const stride = layout_.bindings[attribute.binding].stride;
+         if (attribute.offset + FormatSize(attribute.format) > stride)
+            throw std::invalid_argument("Vertex attribute extends past its stride");
+      }
+      std::ranges::sort(layout_.attributes, {}, &VertexAttributeDesc::location);
+      auto const duplicate = std::ranges::adjacent_find(
+            layout_.attributes, {}, &VertexAttributeDesc::location);
+      if (duplicate != layout_.attributes.end())
+         throw std::invalid_argument("Two vertex attributes share a location");
+   }
+
+   std::uint32_t InputAssembler::vertex_bytes() const {
+      std::uint32_t bytes = 0;
+      for (auto const& attribute : layout_.attributes)
+         if (layout_.bindings[attribute.binding].step_rate == VertexStepRate::kVertex)
+            bytes += FormatSize(attribute.format);
+      return bytes;
+   }
+
+   InputAssemblerStats InputAssembler::Fetch(DrawCall const& draw, MemoryHandler const& memory,
+                                             FetchedVertexHandler const& on_vertex) const {
+      InputAssemblerStats stats;
+      std::vector<glm::vec4> values(on_vertex ? layout_.attributes.size() : 0);
+      // Restart indices are all ones before the vertex offset and fetch nothing
+      bool const restart = draw.primitive_restart();
+      auto const vertex_at = [&](std::uint32_t i) -> std::optional<std::uint32_t> {
+         if (!draw.index_buffer) return draw.first + i;
+         auto const* indices = draw.index_buffer->data.data();
+         std::uint64_t const at = std::uint64_t{draw.first} + i;
+         bool const wide = draw.index_buffer->format == IndexFormat::kUint32;
+         std::uint32_t const index =
+               wide ? Load<std::uint32_t>(indices + at * 4) : Load<std::uint16_t>(indices + at * 2);
+         if (restart && index == (wide ? 0xFFFFFFFFu : 0xFFFFu)) return std::nullopt;
+         return index + static_cast<std::uint32_t>(draw.vertex_offset);
+      };
+
+      for (std::uint32_t i = 0; i < draw.instance_count; ++i) {
+         std::uint32_t const instance = draw.first_instance + i;
+         for (std::uint32_t v = 0; v < draw.count; ++v) {
+            std::optional<std::uint32_t> const index = vertex_at(v);
+            if (!index) continue;
+            std::uint32_t const vertex = *index;
+            for (std::size_t a = 0; a < layout_.attributes.size(); ++a) {
+               auto const& attribute = layout_.attributes[a];
+               auto const& binding = layout_.bindings[attribute.binding];
+               // As in Vulkan, instances step from first_instance, and a
+               // divisor of zero repeats that element for every instance
+               std::uint64_t const element =
+                     binding.step_rate == VertexStepRate::kVertex ? vertex
+                     : binding.divisor == 0 ? draw.first_instance
+                                            : draw.first_instance + i / binding.divisor;
+               auto const data = draw.vertex_buffers[binding.slot].data;
+               std::uint64_t const offset = element * binding.stride + attribute.offset;
+               std::uint32_t const size = FormatSize(attribute.format);
+               ++stats.attributes;
+               if (offset + size > data.size()) {
+                  ++stats.out_of_bounds;
+                  if (on_vertex) values[a] = {0.0f, 0.0f, 0.0f, 0.0f};
+                  continue;
+               }
+               stats.fetched_bytes += size;
+               memory({reinterpret_cast<std::uintptr_t>(data.data() + offset), size,
+                       attribute.binding});
+               if (on_vertex) values[a] = DecodeAttribute(attribute.format, data.data() + offset);
+            }
+            ++stats.vertices;
+            if (on_vertex) on_vertex(instance, vertex, values);
+         }
+      }
+      return stats;
+   }
+
+} // namespace vertexsim
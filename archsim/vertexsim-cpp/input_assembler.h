@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "command_processor.h"
+#include "memory_model.h"
+
+namespace vertexsim {
+
+   /// Vertex attribute formats the fetch unit can convert to float.
+   enum class VertexFormat : std::uint8_t {
+      kFloat32,
+      kFloat32x2,
+      kFloat32x3,
+      kFloat32x4,
+      kFloat16x2,
+      kFloat16x4,
+      kUnorm8x4,
+      kUnorm16x2,
+      kUnorm16x4,
+      kSnorm16x2,
+      kSnorm16x4,
+   };
+
+   std::uint32_t FormatSize(VertexFormat format);
+   std::uint32_t FormatComponents(VertexFormat format);
+
+   /// Converts one attribute, filling missing components from (0, 0, 0, 1).
+   glm::vec4 DecodeAttribute(VertexFormat format, std::byte const* data);
+
+   enum class VertexStepRate : std::uint8_t {
+      kVertex,
+      kInstance,
+   };
+
+   /// How a bound vertex buffer is walked.
+   struct VertexBindingDesc {
+      // Vertex buffer slot of the draw
+      std::uint32_t slot = 0;
+      std::uint32_t stride = 0;
+      VertexStepRate step_rate = VertexStepRate::kVertex;
+      // Instances per element with VertexStepRate::kInstance
+      std::uint32_t divisor = 1;
+   };
+
+   struct VertexAttributeDesc {
+      // Shader input location, the order attributes are handed out in
+      std::uint32_t location = 0;
+      // Index into VertexLayout::bindings
+      std::uint32_t binding = 0;
+      VertexFormat format = VertexFormat::kFloat32x3;
+      // From the start of the element
+      std::uint32_t offset = 0;
+   };
+
+   /// Vertex input state, like a pipeline's: the buffers a draw reads and the
+   /// attributes within them.
+   struct VertexLayout {
+      std::vector<VertexBindingDesc> bindings;
+      std::vector<VertexAttributeDesc> attributes;
+   };
+
+   struct InputAssemblerStats {
+      std::uint64_t vertices = 0;
+      std::uint64_t attributes = 0;
+      std::uint64_t fetched_bytes = 0;
+      // Reads outside the bound range return zero without a memory
+      // request, as with robust buffer access
+      std::uint64_t out_of_bounds = 0;
+
+      InputAssemblerStats& operator+=(InputAssemblerStats const& other) {
+         vertices += other.vertices;
+         attributes += other.attributes;
+         fetched_bytes += other.fetched_bytes;
+         out_of_bounds += other.out_of_bounds;
+         return *this;
+      }
+   };
+
+   /// Called with each fetched vertex: its instance, its vertex index and
+   /// the attributes sorted by location.
+   using FetchedVertexHandler = std::function<void(
+         std::uint32_t instance, std::uint32_t vertex, std::span<glm::vec4 const> attributes)>;
+
+   /// Input assembler stage: walks a draw's indices and instances, reads the
+   /// attributes of each vertex from the bound vertex buffers and issues one
+   /// memory request per attribute read. Every index but primitive restarts
+   /// is fetched; reuse through the post-transform cache is modeled
+   /// separately.
+   class InputAssembler {
+   public:
+      /// Throws std::invalid_argument for layouts referring to missing
+      /// bindings or slots, or attributes not within their stride.
+      explicit InputAssembler(VertexLayout layout);
+
+      /// Fetches every vertex of every instance of `draw`. `on_vertex` is
+      /// optional; leaving it out skips format conversion.
+      InputAssemblerStats Fetch(DrawCall const& draw, MemoryHandler const& memory,
+                                FetchedVertexHandler const& on_vertex = {}) const;
+
+      VertexLayout const& layout() const { return layout_; }
+      /// Bytes read per vertex by per-vertex attributes.
+      std::uint32_t vertex_bytes() const;
+
+   private:
+      VertexLayout layout_;
+   };
+
+} // namespace vertexsim
@@ -1,15 +1,908 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <filesystem>
-#include <fstream>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
-class GpuDriver {
-public:
-};
+#include "clipper.h"
+#include "command_trace.h"
+#include "frame_arena.h"
+#include "gpu_driver.h"
+#include "input_assembler.h"
+#include "material.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "obj_loader.h"
+#include "obj_stream.h"
+#include "post_transform_cache.h"
+#include "primitive_assembler.h"
+#include "quantized_mesh.h"
+#include "texture.h"
+#include "vertex_transform.h"
+#include "welder.h"
 
-static void LoadObj(std::filesystem::path const& path) {
-   std::ifstream ifs{path, std::ios::in};
-   if (!ifs) throw std::runtime_error("Failed to open OBJ file: " + path.string());
-}
+namespace {
+
+   struct Options {
+      std::filesystem::path obj_path;
+      unsigned threads = 1;
+      bool use_cache = true;
+      bool stream = false;
+      bool textures = false;
+      std::optional<vertexsim::VertexCacheAlgorithm> optimize;
+      std::uint32_t cache_size = 16;
+      bool meshlets = false;
+      bool quantize = false;
+      bool transform = false;
+      bool clip = false;
+      bool vertex_fetch = false;
+      bool vertex_cache = false;
+      bool assemble = false;
+      std::uint32_t cache_ways = 0;
+      vertexsim::VertexCachePolicy cache_policy = vertexsim::VertexCachePolicy::kFifo;
+      bool driver = false;
+      std::uint32_t queues = 1;
+      std::uint32_t frames = 1;
+      bool coalesce = false;
+      bool indirect = false;
+      double copy_bandwidth = 0;
+      bool zero_copy = false;
+      std::filesystem::path pipeline_cache_path;
+      bool timings = false;
+      std::filesystem::path capture_path;
+      std::filesystem::path replay_path;
+   };
+
+   void PrintUsage(char const* argv0) {
+      std::cerr << "Usage: " << argv0 << " [options] <mesh.obj>\n"
+                << "       " << argv0 << " --replay <trace.vstrace>\n"
+                << "Options:\n"
+                << "  --threads <n>         Parse the OBJ with n threads (0 = all cores)\n"
+                << "  --no-cache            Always parse the OBJ, never use its .gmesh cache\n"
+                << "  --stream              Parse in bounded-memory batches, for huge meshes,\n"
+                << "                        drawing each batch; not with --driver\n"
+                << "  --textures            Load the OBJ's materials and decode their textures\n"
+                << "  --optimize <algo>     Reorder for the vertex cache (forsyth, tipsify)\n"
+                << "  --cache-size <n>      Post-transform cache entries to optimize for or\n"
+                << "                        model\n"
+                << "  --meshlets            Split the mesh into meshlets and report their fill\n"
+                << "                        and how many cone culling removes\n"
+                << "  --quantize            Compress vertex attributes and report the error\n"
+                << "  --transform           Time the batched vertex transform in Mverts/s\n"
+                << "  --clip                Report the triangles left to the clipper for a\n"
+                << "                        range of guard band sizes\n"
+                << "  --vertex-fetch        Compare vertex fetch traffic of interleaved and\n"
+                << "                        split vertex layouts\n"
+                << "  --vertex-cache        Model the post-transform cache on the mesh, or on\n"
+                << "                        every --driver or --replay draw\n"
+                << "  --cache-ways <n>      Set associativity of the modeled cache (0 = fully)\n"
+                << "  --cache-lru           Replace the least recently used entry, not FIFO\n"
+                << "  --assemble            Run primitive assembly on the mesh, or on every\n"
+                << "                        --driver or --replay draw\n"
+                << "  --driver              Submit the mesh through GpuDriver as many draws\n"
+                << "  --queues <n>          GPU queues for --driver; draws are recorded on\n"
+                << "                        --threads threads\n"
+                << "  --frames <n>          Frames to submit the mesh for with --driver\n"
+                << "  --coalesce            Merge consecutive --driver draws into multi-draws\n"
+                << "  --indirect            Issue the --driver draws from GPU memory instead\n"
+                << "  --copy-bandwidth <n>  Model the --driver copy engine at n GB/s of\n"
+                << "                        simulated time\n"
+                << "  --zero-copy           Map the mesh into --driver buffers, no uploads\n"
+                << "  --pipeline-cache <f>  Keep compiled --driver pipelines in this file\n"
+                << "  --timings             Time each --driver recording thread's pass with\n"
+                << "                        GPU timestamp and statistics queries\n"
+                << "  --capture <file>      Capture the --driver submission to a trace\n"
+                << "  --replay <file>       Replay a captured trace headlessly and time it\n";
+   }
+
+   std::optional<Options> ParseOptions(int argc, char** argv) {
+      Options options;
+      for (int i = 1; i < argc; ++i) {
+         std::string_view const arg = argv[i];
+         bool const has_value = i + 1 < argc;
+         if (arg == "--threads" && has_value) {
+            options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+         } else if (arg == "--no-cache") {
+            options.use_cache = false;
+         } else if (arg == "--stream") {
+            options.stream = true;
+         } else if (arg == "--textures") {
+            options.textures = true;
+         } else if (arg == "--optimize" && has_value) {
+            std::string_view const algo = argv[++i];
+            if (algo == "forsyth")
+               options.optimize = vertexsim::VertexCacheAlgorithm::kForsyth;
+            else if (algo == "tipsify")
+               options.optimize = vertexsim::VertexCacheAlgorithm::kTipsify;
+            else
+               return std::nullopt;
+         } else if (arg == "--cache-size" && has_value) {
+            options.cache_size = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+         } else if (arg == "--meshlets") {
+            options.meshlets = true;
+         } else if (arg == "--quantize") {
+            options.quantize = true;
+         } else if (arg == "--transform") {
+            options.transform = true;
+         } else if (arg == "--clip") {
+            options.clip = true;
+         } else if (arg == "--vertex-fetch") {
+            options.vertex_fetch = true;
+         } else if (arg == "--vertex-cache") {
+            options.vertex_cache = true;
+         } else if (arg == "--cache-ways" && has_value) {
+            options.cache_ways = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+         } else if (arg == "--cache-lru") {
+            options.cache_policy = vertexsim::VertexCachePolicy::kLru;
+         } else if (arg == "--assemble") {
+            options.assemble = true;
+         } else if (arg == "--driver") {
+            options.driver = true;
+         } else if (arg == "--queues" && has_value) {
+            options.queues = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            if (options.queues == 0) return std::nullopt;
+         } else if (arg == "--frames" && has_value) {
+            options.frames = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+         } else if (arg == "--coalesce") {
+            options.coalesce = true;
+         } else if (arg == "--indirect") {
+            options.indirect = true;
+         } else if (arg == "--copy-bandwidth" && has_value) {
+            options.copy_bandwidth = std::strtod(argv[++i], nullptr) * 1e9;
+         } else if (arg == "--zero-copy") {
+            options.zero_copy = true;
+         } else if (arg == "--pipeline-cache" && has_value) {
+            options.pipeline_cache_path = argv[++i];
+         } else if (arg == "--timings") {
+            options.timings = true;
+         } else if (arg == "--capture" && has_value) {
+            options.capture_path = argv[++i];
+         } else if (arg == "--replay" && has_value) {
+            options.replay_path = argv[++i];
+         } else if (!arg.starts_with("--") && options.obj_path.empty()) {
+            options.obj_path = arg;
+         } else {
+            return std::nullopt;
+         }
+      }
+      if (options.obj_path.empty() && options.replay_path.empty()) return std::nullopt;
+      // Streamed batches only feed the per-draw models
+      if (options.stream && options.driver) return std::nullopt;
+      return options;
+   }
+
+   vertexsim::IndexedMesh LoadMesh(Options const& options) {
+      if (options.use_cache) return vertexsim::LoadMesh(options.obj_path, options.threads);
+      return vertexsim::WeldMesh(vertexsim::LoadObj(options.obj_path, options.threads));
+   }
+
+   void LoadMaterials(Options const& options) {
+      auto const materials = vertexsim::LoadObjMaterials(options.obj_path);
+      auto const paths = vertexsim::TexturePaths(materials);
+      vertexsim::TextureLoadStats stats;
+      vertexsim::LoadTextures(paths, options.threads, &stats);
+      std::cout << "Loaded " << materials.size() << " materials, " << paths.size()
+                << " textures (" << stats.decoded << " decoded, " << stats.cached
+                << " from cache), " << stats.bytes / (1 << 20) << " MB with mips" << std::endl;
+   }
+
+   void PrintQuantization(vertexsim::IndexedMesh const& mesh) {
+      using vertexsim::VertexStream;
+      auto const quantized = vertexsim::QuantizeVertices(mesh);
+      constexpr std::uint32_t kBatch = 4096;
+      vertexsim::FrameArena arena;
+      vertexsim::DecodedStreams decoded;
+      for (auto& stream : decoded) stream = arena.AllocateArray<float>(kBatch);
+      auto const read = [](auto const& streams, VertexStream s, std::size_t i) {
+         return streams[static_cast<std::size_t>(s)][i];
+      };
+
+      float position_error = 0, normal_dot = 1, texcoord_error = 0;
+      std::chrono::duration<double> decode_time{0};
+      for (std::uint32_t first = 0; first < mesh.vertex_count(); first += kBatch) {
+         std::uint32_t const count = std::min(kBatch, mesh.vertex_count() - first);
+         auto const start = std::chrono::steady_clock::now();
+         vertexsim::DecodeVertices(quantized, first, count, decoded);
+         decode_time += std::chrono::steady_clock::now() - start;
+         for (std::uint32_t i = 0; i < count; ++i) {
+            for (auto s : {VertexStream::kPositionX, VertexStream::kPositionY,
+                           VertexStream::kPositionZ}) {
+               position_error = std::max(position_error,
+                                         std::abs(read(decoded, s, i) - mesh.stream(s)[first + i]));
+            }
+            if (mesh.has_normals()) {
+               glm::vec3 const a{read(decoded, VertexStream::kNormalX, i),
+                                 read(decoded, VertexStream::kNormalY, i),
+                                 read(decoded, VertexStream::kNormalZ, i)};
+               glm::vec3 const b{mesh.stream(VertexStream::kNormalX)[first + i],
+                                 mesh.stream(VertexStream::kNormalY)[first + i],
+                                 mesh.stream(VertexStream::kNormalZ)[first + i]};
+               // Zero-length source normals have no direction to preserve
+               if (float const len2 = glm::dot(b, b); len2 > 0)
+                  normal_dot = std::min(normal_dot, glm::dot(a, b) / std::sqrt(len2));
+            }
+            if (mesh.has_texcoords()) {
+               for (auto s : {VertexStream::kTexcoordU, VertexStream::kTexcoordV}) {
+                  texcoord_error = std::max(
+                        texcoord_error, std::abs(read(decoded, s, i) - mesh.stream(s)[first + i]));
+               }
+            }
+         }
+      }
+      std::size_t const float_bytes = std::size_t{mesh.vertex_count()} * sizeof(float) *
+                                      (3 + 3 * mesh.has_normals() + 2 * mesh.has_texcoords());
+      double const degrees = std::acos(std::clamp(normal_dot, -1.0f, 1.0f)) * 180.0 / 3.14159265;
+      std::cout << "Quantized vertices: " << float_bytes / 1024 << " KB -> "
+                << quantized.vertex_bytes() / 1024 << " KB\n"
+                << "  max error: position " << position_error << ", normal " << degrees
+                << " deg, texcoord " << texcoord_error << "\n"
+                << "  decode: " << mesh.vertex_count() / decode_time.count() / 1e6
+                << " Mverts/s" << std::endl;
+   }
+
+   /// Corners of the mesh's bounding box.
+   std::array<glm::vec3, 2> BoundsOf(vertexsim::IndexedMesh const& mesh) {
+      using vertexsim::VertexStream;
+      glm::vec3 lo{std::numeric_limits<float>::max()}, hi{-std::numeric_limits<float>::max()};
+      for (std::uint32_t i = 0; i < mesh.vertex_count(); ++i) {
+         glm::vec3 const p{mesh.stream(VertexStream::kPositionX)[i],
+                           mesh.stream(VertexStream::kPositionY)[i],
+                           mesh.stream(VertexStream::kPositionZ)[i]};
+         lo = glm::min(lo, p);
+         hi = glm::max(hi, p);
+      }
+      return {lo, hi};
+   }
+
+   /// Eye of FitCamera(), outside the mesh's bounding sphere on +z.
+   glm::vec3 FitCameraEye(vertexsim::IndexedMesh const& mesh) {
+      auto const [lo, hi] = BoundsOf(mesh);
+      float const radius = std::max(glm::distance(lo, hi) * 0.5f, 1e-3f);
+      return (lo + hi) * 0.5f + glm::vec3{0.0f, 0.0f, 2.5f * radius};
+   }
+
+   /// Camera looking down -z at the whole mesh from outside its bounding
+   /// sphere, with a 60 degree field of view.
+   glm::mat4 FitCamera(vertexsim::IndexedMesh const& mesh, float aspect) {
+      auto const [lo, hi] = BoundsOf(mesh);
+      glm::vec3 const center = (lo + hi) * 0.5f;
+      float const radius = std::max(glm::distance(lo, hi) * 0.5f, 1e-3f);
+      glm::vec3 const eye = FitCameraEye(mesh);
+      return glm::perspective(glm::radians(60.0f), aspect, 0.1f * radius, 10.0f * radius) *
+             glm::lookAt(eye, center, glm::vec3{0.0f, 1.0f, 0.0f});
+   }
+
+   /// Camera at the center of the mesh looking down -z with a 90 degree
+   /// field of view, as in a walk through a scene.
+   glm::mat4 CenterCamera(vertexsim::IndexedMesh const& mesh, float aspect) {
+      auto const [lo, hi] = BoundsOf(mesh);
+      glm::vec3 const center = (lo + hi) * 0.5f;
+      float const radius = std::max(glm::distance(lo, hi) * 0.5f, 1e-3f);
+      return glm::perspective(glm::radians(90.0f), aspect, 0.01f * radius, 2.0f * radius) *
+             glm::lookAt(center, center - glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+   }
+
+   void PrintMeshlets(vertexsim::IndexedMesh const& mesh) {
+      auto const set = vertexsim::BuildMeshlets(mesh);
+      glm::vec3 const eye = FitCameraEye(mesh);
+      std::size_t cullable = 0, backfacing = 0;
+      for (auto const& meshlet : set.meshlets) {
+         cullable += meshlet.cone_cutoff < 1.0f;
+         backfacing += vertexsim::IsMeshletBackfacing(meshlet, eye);
+      }
+      double const count = static_cast<double>(std::max<std::size_t>(set.meshlets.size(), 1));
+      std::cout << "Built " << set.meshlets.size() << " meshlets ("
+                << vertexsim::kDefaultMeshletVertices << "/" << vertexsim::kDefaultMeshletTriangles
+                << "): " << set.vertices.size() / count << " vertices, "
+                << set.triangles.size() / 3 / count << " triangles on average, " << cullable
+                << " with a usable normal cone, " << backfacing
+                << " backfacing from the framing camera" << std::endl;
+   }
+
+   /// Times TransformVertices() over the mesh against a per-vertex glm
+   /// loop, and checks that both agree.
+   void PrintTransform(vertexsim::IndexedMesh const& mesh) {
+      using vertexsim::TransformedStream;
+      using vertexsim::VertexStream;
+      constexpr std::uint32_t kBatch = 4096;
+      vertexsim::Viewport const viewport{0, 0, 1920, 1080, 0, 1};
+      glm::mat4 const mvp = FitCamera(mesh, viewport.width / viewport.height);
+      vertexsim::FrameArena arena;
+      vertexsim::TransformedStreams out;
+      for (auto& stream : out) stream = arena.AllocateArray<float>(kBatch);
+
+      float max_error = 0;
+      std::chrono::duration<double> batched{0}, reference{0};
+      for (std::uint32_t first = 0; first < mesh.vertex_count(); first += kBatch) {
+         std::uint32_t const count = std::min(kBatch, mesh.vertex_count() - first);
+         vertexsim::PositionStreams const positions{
+               mesh.stream(VertexStream::kPositionX).subspan(first, count),
+               mesh.stream(VertexStream::kPositionY).subspan(first, count),
+               mesh.stream(VertexStream::kPositionZ).subspan(first, count)};
+         auto start = std::chrono::steady_clock::now();
+         vertexsim::TransformVertices(mvp, viewport, positions, out);
+         batched += std::chrono::steady_clock::now() - start;
+
+         // What the transform stage would otherwise do: one vec4 at a time
+         std::array<glm::vec3, kBatch> window;
+         start = std::chrono::steady_clock::now();
+         for (std::uint32_t i = 0; i < count; ++i) {
+            glm::vec4 const clip =
+                  mvp * glm::vec4{positions[0][i], positions[1][i], positions[2][i], 1.0f};
+            glm::vec3 const ndc{clip.x / clip.w, clip.y / clip.w, clip.z / clip.w};
+            window[i] = {viewport.x + (ndc.x + 1) * 0.5f * viewport.width,
+                         viewport.y + (ndc.y + 1) * 0.5f * viewport.height,
+                         (ndc.z + 1) * 0.5f};
+         }
+         reference += std::chrono::steady_clock::now() - start;
+         for (std::uint32_t i = 0; i < count; ++i) {
+            // Vertices behind the eye are left to the clipper
+            if (out[static_cast<std::size_t>(TransformedStream::kClipW)][i] <= 0) continue;
+            for (int axis = 0; axis < 2; ++axis) {
+               auto const s = static_cast<std::size_t>(TransformedStream::kWindowX) + axis;
+               max_error = std::max(max_error, std::abs(out[s][i] - window[i][axis]));
+            }
+         }
+      }
+      std::cout << "Vertex transform (" << vertexsim::TransformBatchWidth()
+                << " vertices per batch): " << mesh.vertex_count() / batched.count() / 1e6
+                << " Mverts/s, per-vertex glm " << mesh.vertex_count() / reference.count() / 1e6
+                << " Mverts/s, max difference " << max_error << " px" << std::endl;
+   }
+
+   /// Hands the whole mesh to `on_draw` as a single triangle-list draw.
+   void DrawMesh(vertexsim::IndexedMesh const& mesh, vertexsim::DrawHandler const& on_draw) {
+      std::array<std::uint32_t, vertexsim::kRenderStateCount> state{};
+      state[static_cast<std::size_t>(vertexsim::RenderState::kTopology)] =
+            static_cast<std::uint32_t>(vertexsim::PrimitiveTopology::kTriangleList);
+      std::array<vertexsim::VertexBufferBinding, vertexsim::kMaxVertexBuffers> vertex_buffers;
+      for (std::uint32_t slot = 0; slot < vertexsim::kVertexStreamCount; ++slot)
+         vertex_buffers[slot] = {
+               std::as_bytes(mesh.stream(static_cast<vertexsim::VertexStream>(slot))), 4};
+      vertexsim::IndexBufferBinding const indices{
+            mesh.VisitIndices([](auto span) { return std::as_bytes(span); }), mesh.index_format()};
+      vertexsim::DrawCall draw{state, vertex_buffers, &indices};
+      draw.count = static_cast<std::uint32_t>(mesh.index_count());
+      on_draw(draw);
+   }
+
+   /// Streams the OBJ in batches, drawing each batch through `on_draw` if set
+   /// while the next one is parsed.
+   void StreamMesh(Options const& options, vertexsim::DrawHandler const& on_draw) {
+      auto const stats =
+            vertexsim::StreamObj(options.obj_path, {}, [&](vertexsim::IndexedMesh const& batch) {
+               if (on_draw) DrawMesh(batch, on_draw);
+            });
+      std::cout << "Streamed " << stats.triangles << " triangles in " << stats.batches
+                << " batches, " << stats.vertices << " batch vertices\n"
+                << "  peak attribute memory " << stats.peak_attribute_bytes / (1 << 20)
+                << " MB, " << stats.page_reloads << " page reloads" << std::endl;
+   }
+
+   /// Transforms the mesh, assembles it and reports what the clipper does
+   /// with its triangles for guard bands of increasing size, for a camera
+   /// framing the mesh and one inside it.
+   void PrintClipping(vertexsim::IndexedMesh const& mesh) {
+      using vertexsim::TransformedStream;
+      using vertexsim::VertexStream;
+      vertexsim::Viewport const viewport{0, 0, 1920, 1080, 0, 1};
+      float const aspect = viewport.width / viewport.height;
+      std::uint32_t const vertex_count = mesh.vertex_count();
+      std::vector<float> storage(vertexsim::kTransformedStreamCount * vertex_count);
+      vertexsim::TransformedStreams out;
+      for (std::size_t s = 0; s < out.size(); ++s)
+         out[s] = std::span{storage}.subspan(s * vertex_count, vertex_count);
+      auto const stream = [&](TransformedStream s) {
+         return std::span<float const>{out[static_cast<std::size_t>(s)]};
+      };
+      vertexsim::ClipPositionStreams const clip{
+            stream(TransformedStream::kClipX), stream(TransformedStream::kClipY),
+            stream(TransformedStream::kClipZ), stream(TransformedStream::kClipW)};
+
+      struct Camera {
+         char const* name;
+         glm::mat4 mvp;
+      };
+      for (auto const& camera : {Camera{"framing", FitCamera(mesh, aspect)},
+                                 Camera{"inside", CenterCamera(mesh, aspect)}}) {
+         vertexsim::TransformVertices(camera.mvp, viewport,
+                                      {mesh.stream(VertexStream::kPositionX),
+                                       mesh.stream(VertexStream::kPositionY),
+                                       mesh.stream(VertexStream::kPositionZ)},
+                                      out);
+         std::cout << "Clipping, " << camera.name << " camera:\n";
+         for (float const guard_band : {1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f}) {
+            vertexsim::Clipper clipper{{guard_band, guard_band}};
+            auto const start = std::chrono::steady_clock::now();
+            DrawMesh(mesh, [&](vertexsim::DrawCall const& draw) {
+               vertexsim::AssemblePrimitives(draw, [&](vertexsim::PrimitivePacket const& packet) {
+                  clipper.Clip(packet, clip);
+               });
+            });
+            std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+            auto const& stats = clipper.stats();
+            std::cout << "  guard band " << guard_band << "x (+-" << guard_band * viewport.width / 2
+                      << " x +-" << guard_band * viewport.height / 2 << " px): "
+                      << (stats.triangles ? 100.0 * stats.culled / stats.triangles : 0)
+                      << "% culled, "
+                      << 100 * stats.clipped_fraction() << "% clipped into "
+                      << stats.clipped_output << " triangles, "
+                      << stats.triangles / elapsed.count() / 1e6 << " Mtriangles/s\n";
+         }
+      }
+      std::cout << std::flush;
+   }
+
+   /// Fetches the mesh through the input assembler in two layouts, every
+   /// attribute and positions only, and reports the traffic the fetch cache
+   /// sees. Interleaved packs all attributes of a vertex into one buffer;
+   /// split reads the mesh's own streams, one per component.
+   void PrintVertexFetch(vertexsim::IndexedMesh const& mesh) {
+      using vertexsim::VertexFormat;
+      using vertexsim::VertexStream;
+      struct Attribute {
+         VertexStream first;
+         std::uint32_t components;
+      };
+      std::vector<Attribute> attributes{{VertexStream::kPositionX, 3}};
+      if (mesh.has_normals()) attributes.push_back({VertexStream::kNormalX, 3});
+      if (mesh.has_texcoords()) attributes.push_back({VertexStream::kTexcoordU, 2});
+      constexpr std::array kFloatFormats{VertexFormat::kFloat32, VertexFormat::kFloat32x2,
+                                         VertexFormat::kFloat32x3};
+
+      std::uint32_t stride = 0;
+      for (auto const& attribute : attributes) stride += 4 * attribute.components;
+      std::vector<float> interleaved(std::size_t{mesh.vertex_count()} * stride / 4);
+      std::array<vertexsim::VertexBufferBinding, vertexsim::kMaxVertexBuffers> split_buffers;
+      for (std::uint32_t v = 0, i = 0; v < mesh.vertex_count(); ++v)
+         for (auto const& attribute : attributes)
+            for (std::uint32_t c = 0; c < attribute.components; ++c)
+               interleaved[i++] = mesh.stream(static_cast<VertexStream>(
+                     static_cast<std::uint32_t>(attribute.first) + c))[v];
+      for (std::uint32_t slot = 0; slot < vertexsim::kVertexStreamCount; ++slot)
+         split_buffers[slot] = {std::as_bytes(mesh.stream(static_cast<VertexStream>(slot))), 4};
 
-int main() {}
+      std::array<std::uint32_t, vertexsim::kRenderStateCount> state{};
+      vertexsim::IndexBufferBinding const indices{
+            mesh.VisitIndices([](auto span) { return std::as_bytes(span); }), mesh.index_format()};
+      vertexsim::LineCacheConfig const cache_config;
+      std::cout << "Vertex fetch (" << cache_config.lines << " lines of " << cache_config.line_bytes
+                << " bytes, " << cache_config.associativity << "-way):\n";
+      auto const run = [&](char const* label, vertexsim::VertexLayout layout,
+                           std::span<vertexsim::VertexBufferBinding const> buffers) {
+         vertexsim::InputAssembler const assembler{std::move(layout)};
+         vertexsim::DrawCall draw{state, buffers.first<vertexsim::kMaxVertexBuffers>(), &indices};
+         draw.count = static_cast<std::uint32_t>(mesh.index_count());
+         vertexsim::LineCache cache{cache_config};
+         auto const stats = assembler.Fetch(
+               draw, [&](vertexsim::MemoryRequest const& request) { cache.Access(request); });
+         cache.Flush();
+         auto const& traffic = cache.stats();
+         std::cout << "  " << label << ": " << assembler.vertex_bytes() << " B/vertex, "
+                   << static_cast<double>(traffic.requests) / stats.vertices
+                   << " requests/vertex, "
+                   << static_cast<double>(traffic.fetched_bytes) / stats.vertices
+                   << " B/vertex from memory, " << 100 * traffic.line_utilization()
+                   << "% of fetched bytes used\n";
+      };
+      for (bool const positions_only : {false, true}) {
+         std::size_t const count = positions_only ? 1 : attributes.size();
+         vertexsim::VertexLayout packed{{{0, stride}}, {}};
+         vertexsim::VertexLayout split;
+         for (std::uint32_t a = 0, offset = 0; a < count; ++a) {
+            auto const& attribute = attributes[a];
+            packed.attributes.push_back(
+                  {a, 0, kFloatFormats[attribute.components - 1], offset});
+            offset += 4 * attribute.components;
+            for (std::uint32_t c = 0; c < attribute.components; ++c) {
+               auto const slot = static_cast<std::uint32_t>(attribute.first) + c;
+               auto const binding = static_cast<std::uint32_t>(split.bindings.size());
+               split.bindings.push_back({slot, 4});
+               split.attributes.push_back({binding, binding, VertexFormat::kFloat32, 0});
+            }
+         }
+         std::array<vertexsim::VertexBufferBinding, vertexsim::kMaxVertexBuffers> packed_buffers;
+         packed_buffers[0] = {std::as_bytes(std::span{interleaved}), stride};
+         run(positions_only ? "interleaved, positions" : "interleaved, all", std::move(packed),
+             packed_buffers);
+         run(positions_only ? "split, positions" : "split, all", std::move(split), split_buffers);
+      }
+      std::cout << std::flush;
+   }
+
+   /// Reports the simulated duration and pipeline counters of each recording
+   /// thread's pass in the last frame.
+   void PrintPassTimings(vertexsim::GpuDriver& driver, vertexsim::QueryPoolHandle timestamps,
+                         vertexsim::QueryPoolHandle statistics, unsigned passes) {
+      std::vector<std::uint64_t> times(2 * passes);
+      std::vector<std::uint64_t> counters(passes * vertexsim::kPipelineStatisticsCount);
+      if (!driver.GetQueryResults(timestamps, 0, 2 * passes, times) ||
+          !driver.GetQueryResults(statistics, 0, passes, counters))
+         throw std::runtime_error("GPU queries are not available after Finish");
+      double const us_per_cycle = driver.timestamp_period() * 1e6;
+      std::uint64_t const first = std::ranges::min(times);
+      std::uint64_t const last = std::ranges::max(times);
+      std::cout << "  simulated GPU time: " << (last - first) * us_per_cycle << " us ("
+                << last - first << " cycles) for the last frame, from cycle " << first << "\n";
+      for (unsigned pass = 0; pass < passes; ++pass) {
+         std::uint64_t const* stats = &counters[pass * vertexsim::kPipelineStatisticsCount];
+         std::uint64_t const cycles = times[2 * pass + 1] - times[2 * pass];
+         std::cout << "    pass " << pass << " on queue " << pass % driver.queue_count() << ": "
+                   << cycles * us_per_cycle << " us, " << stats[0] << " vertices, " << stats[1]
+                   << " primitives, " << stats[2] << " shader invocations\n";
+      }
+   }
+
+   /// Runs draws through the post-transform cache model and totals them.
+   /// Every queue's front-end draws from its own thread.
+   class VertexCacheModel {
+   public:
+      explicit VertexCacheModel(Options const& options) : cache_{ConfigOf(options)} {}
+
+      void Draw(vertexsim::DrawCall const& draw) {
+         std::lock_guard lock{mutex_};
+         Add(cache_.Draw(draw));
+      }
+
+      void Print() const {
+         std::lock_guard lock{mutex_};
+         auto const& config = cache_.config();
+         std::cout << "Post-transform cache (" << config.entries << " entries, ";
+         if (config.associativity == 0)
+            std::cout << "fully associative, ";
+         else
+            std::cout << config.associativity << "-way, ";
+         std::cout << (config.policy == vertexsim::VertexCachePolicy::kLru ? "LRU" : "FIFO")
+                   << "): " << draws_ << " draws\n";
+         if (draws_ == 0) return;
+         std::cout << "  hit rate " << 100 * total_.hit_rate() << "%, " << total_.shaded
+                   << " vertices shaded (" << 3.0 * total_.shaded / total_.indices
+                   << " per triangle)\n"
+                   << "  per draw: " << static_cast<double>(total_.stall_cycles) / draws_
+                   << " stall cycles (max " << max_stall_cycles_ << ") in "
+                   << static_cast<double>(total_.cycles) / draws_ << " cycles\n";
+      }
+
+   private:
+      static vertexsim::PostTransformCacheConfig ConfigOf(Options const& options) {
+         vertexsim::PostTransformCacheConfig config;
+         config.entries = options.cache_size;
+         config.associativity = options.cache_ways;
+         config.policy = options.cache_policy;
+         return config;
+      }
+
+      void Add(vertexsim::PostTransformCacheStats const& stats) {
+         total_ += stats;
+         max_stall_cycles_ = std::max(max_stall_cycles_, stats.stall_cycles);
+         ++draws_;
+      }
+
+      mutable std::mutex mutex_;
+      vertexsim::PostTransformCache cache_;
+      vertexsim::PostTransformCacheStats total_;
+      std::uint64_t max_stall_cycles_ = 0;
+      std::uint64_t draws_ = 0;
+   };
+
+   /// Packs draws into primitive packets and totals them.
+   class PrimitiveAssemblyModel {
+   public:
+      void Draw(vertexsim::DrawCall const& draw) {
+         auto const start = std::chrono::steady_clock::now();
+         auto const stats = vertexsim::AssemblePrimitives(draw, {});
+         std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+         std::lock_guard lock{mutex_};
+         total_ += stats;
+         elapsed_ += elapsed;
+         ++draws_;
+      }
+
+      void Print() const {
+         std::lock_guard lock{mutex_};
+         std::cout << "Primitive assembly: " << draws_ << " draws, " << total_.primitives
+                   << " primitives in " << total_.packets << " packets of "
+                   << vertexsim::kPrimitivePacketSize << " ("
+                   << (total_.packets ? 100.0 * total_.primitives /
+                                              (total_.packets * vertexsim::kPrimitivePacketSize)
+                                      : 0)
+                   << "% full), " << total_.restarts << " restarts, " << total_.dropped_vertices
+                   << " vertices dropped, " << total_.primitives / elapsed_.count() / 1e6
+                   << " Mprimitives/s" << std::endl;
+      }
+
+   private:
+      mutable std::mutex mutex_;
+      vertexsim::PrimitiveAssemblyStats total_;
+      std::chrono::duration<double> elapsed_{0};
+      std::uint64_t draws_ = 0;
+   };
+
+   /// Uploads `mesh` and draws it in small pieces, to time the command path
+   /// from the host through the rings to the front-ends. The draws are split
+   /// between recording threads, each filling its own command list, and the
+   /// lists are spread over the queues once the upload has landed.
+   void SubmitThroughDriver(vertexsim::IndexedMesh& mesh, Options const& options,
+                            vertexsim::DrawHandler on_draw) {
+      using vertexsim::VertexStream;
+      constexpr std::uint32_t kDrawIndices = 3 * 256;
+
+      vertexsim::GpuDriverOptions driver_options;
+      driver_options.queue_count = options.queues;
+      driver_options.capture_path = options.capture_path;
+      driver_options.copy_bytes_per_second = options.copy_bandwidth;
+      if (options.zero_copy) driver_options.staging_bytes = 0;
+      driver_options.pipeline_cache_path = options.pipeline_cache_path;
+      vertexsim::GpuDriver driver{std::move(on_draw), driver_options};
+      auto const start = std::chrono::steady_clock::now();
+      // Uploads go through the staging ring to the copy queue, which works
+      // through them while the draws are recorded. Zero-copy instead hands
+      // the mesh's own storage to the device, which stays valid since the
+      // mesh outlives the driver. Nothing waits when nothing was uploaded.
+      std::optional<vertexsim::FenceValue> uploaded;
+      auto const make_buffer = [&](std::span<std::byte> data) {
+         if (options.zero_copy) return driver.CreateHostBuffer(data);
+         auto const buffer = driver.CreateBuffer(data.size());
+         uploaded = driver.UploadBuffer(buffer, 0, data);
+         return buffer;
+      };
+      std::array<std::optional<vertexsim::BufferHandle>, vertexsim::kVertexStreamCount> streams;
+      for (std::uint32_t slot = 0; slot < vertexsim::kVertexStreamCount; ++slot) {
+         auto const stream = mesh.stream(static_cast<VertexStream>(slot));
+         if (stream.empty()) continue;
+         streams[slot] = make_buffer(std::as_writable_bytes(stream));
+      }
+      auto const index_buffer =
+            make_buffer(mesh.VisitIndices([](auto span) { return std::as_writable_bytes(span); }));
+      unsigned const threads = std::max(
+            options.threads == 0 ? std::thread::hardware_concurrency() : options.threads, 1u);
+      std::uint64_t const draw_count = (mesh.index_count() + kDrawIndices - 1) / kDrawIndices;
+      auto const draw_args = [&](std::uint64_t draw) {
+         std::uint64_t const first = draw * kDrawIndices;
+         std::uint64_t const count =
+               std::min<std::uint64_t>(kDrawIndices, mesh.index_count() - first);
+         return vertexsim::DrawIndexedCommand{static_cast<std::uint32_t>(count), 1,
+                                              static_cast<std::uint32_t>(first), 0, 0};
+      };
+      // GPU-driven variant: the draw arguments live in GPU memory
+      std::optional<vertexsim::BufferHandle> indirect_args;
+      if (options.indirect) {
+         std::vector<vertexsim::DrawIndexedCommand> args(draw_count);
+         for (std::uint64_t draw = 0; draw < draw_count; ++draw) args[draw] = draw_args(draw);
+         indirect_args = driver.CreateBuffer(std::span{args}.size_bytes());
+         if (options.zero_copy) {
+            // Written through a persistent mapping and flushed, like a
+            // host-visible argument buffer
+            auto const mapped = driver.MapBuffer(*indirect_args);
+            std::memcpy(mapped.data(), args.data(), mapped.size());
+            driver.FlushMappedRange(*indirect_args, 0, mapped.size());
+         } else {
+            uploaded = driver.UploadBuffer(*indirect_args, 0, std::as_bytes(std::span{args}));
+         }
+      }
+      std::chrono::duration<double> const upload_queued = std::chrono::steady_clock::now() - start;
+
+      vertexsim::PipelineDesc pipeline_desc;
+      pipeline_desc.vertex_streams = 0;
+      for (std::uint32_t slot = 0; slot < streams.size(); ++slot)
+         if (streams[slot]) pipeline_desc.vertex_streams |= 1u << slot;
+      pipeline_desc.shader = mesh.has_normals() ? vertexsim::VertexShader::kTransformLit
+                                                : vertexsim::VertexShader::kTransform;
+      pipeline_desc[vertexsim::RenderState::kCullMode] =
+            static_cast<std::uint32_t>(vertexsim::CullMode::kBack);
+      pipeline_desc[vertexsim::RenderState::kDepthTestEnable] = 1;
+      pipeline_desc[vertexsim::RenderState::kDepthWriteEnable] = 1;
+      pipeline_desc[vertexsim::RenderState::kDepthCompare] =
+            static_cast<std::uint32_t>(vertexsim::CompareOp::kLess);
+      pipeline_desc[vertexsim::RenderState::kColorWriteMask] = 0xF;
+      auto const pipeline = driver.CreatePipeline(pipeline_desc);
+      auto const bind = [&](vertexsim::CommandList& list) {
+         for (std::uint32_t slot = 0; slot < streams.size(); ++slot)
+            if (streams[slot]) list.BindVertexBuffer(slot, *streams[slot], 0, sizeof(float));
+         list.BindIndexBuffer(index_buffer, 0, mesh.index_format());
+         list.BindPipeline(pipeline);
+      };
+      // Each thread's list is one pass, bracketed by two timestamps and a
+      // statistics query
+      std::optional<vertexsim::QueryPoolHandle> timestamps, statistics;
+      if (options.timings) {
+         timestamps = driver.CreateQueryPool(vertexsim::QueryType::kTimestamp, 2 * threads);
+         statistics = driver.CreateQueryPool(vertexsim::QueryType::kPipelineStatistics, threads);
+      }
+      auto const record = [&](vertexsim::CommandList& list, std::size_t thread) {
+         auto const query = static_cast<std::uint32_t>(thread);
+         if (options.timings) {
+            list.WriteTimestamp(*timestamps, 2 * query);
+            list.BeginQuery(*statistics, query);
+         }
+         if (indirect_args) {
+            // One call covers this thread's share: every threads-th record
+            constexpr std::size_t kArgsSize = sizeof(vertexsim::DrawIndexedCommand);
+            bind(list);
+            auto const count = static_cast<std::uint32_t>(
+                  thread < draw_count ? (draw_count - thread + threads - 1) / threads : 0);
+            list.MultiDrawIndexedIndirect(*indirect_args, thread * kArgsSize, count,
+                                          static_cast<std::uint32_t>(threads * kArgsSize));
+         } else {
+            for (std::uint64_t draw = thread; draw < draw_count; draw += threads) {
+               // Like a naive renderer, every draw sets up all of its state;
+               // the encoder drops what is already bound
+               bind(list);
+               auto const args = draw_args(draw);
+               list.DrawIndexed(args.index_count, 1, args.first_index);
+            }
+         }
+         if (options.timings) {
+            list.EndQuery(*statistics, query);
+            list.WriteTimestamp(*timestamps, 2 * query + 1);
+         }
+         list.Flush();
+      };
+
+      // One arena per recording thread and frame in flight. A frame's arenas
+      // are reset once every queue has signalled that it finished the frame.
+      constexpr std::uint32_t kFramesInFlight = 2;
+      std::vector<vertexsim::FrameArena> arenas(kFramesInFlight * threads);
+      std::vector<vertexsim::FenceHandle> frame_done(driver.queue_count());
+      for (auto& fence : frame_done) fence = driver.CreateFence();
+      vertexsim::RecordingOptions recording_options;
+      recording_options.coalesce_draws = options.coalesce;
+      vertexsim::RecordingStats recording;
+      for (std::uint32_t frame = 0; frame < options.frames; ++frame) {
+         std::span const frame_arenas{arenas.data() + frame % kFramesInFlight * threads, threads};
+         if (frame >= kFramesInFlight) {
+            for (auto const fence : frame_done)
+               driver.WaitFence(fence, frame - kFramesInFlight + 1);
+            for (auto& arena : frame_arenas) arena.Reset();
+         }
+         std::vector<vertexsim::CommandList> lists;
+         for (auto& arena : frame_arenas) lists.emplace_back(arena, recording_options);
+         {
+            std::vector<std::jthread> recorders;
+            for (std::size_t t = 0; t < threads; ++t)
+               recorders.emplace_back([&, t] { record(lists[t], t); });
+         }
+         for (std::uint32_t queue = 0; queue < driver.queue_count(); ++queue) {
+            std::vector<vertexsim::CommandList> queue_lists;
+            for (std::size_t t = queue; t < threads; t += driver.queue_count())
+               queue_lists.push_back(std::move(lists[t]));
+            vertexsim::FenceValue const signal{frame_done[queue], frame + std::uint64_t{1}};
+            driver.Submit(queue, queue_lists,
+                          uploaded ? std::span{&*uploaded, 1} : std::span<vertexsim::FenceValue>{},
+                          {&signal, 1});
+            for (auto const& list : queue_lists) recording += list.recording_stats();
+         }
+      }
+      driver.Finish();
+      std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+
+      vertexsim::FrontEndStats stats;
+      for (std::uint32_t queue = 0; queue < driver.queue_count(); ++queue)
+         stats += driver.stats(queue);
+      std::cout << "Driver: " << stats.packets << " packets, " << stats.draws << " draws, "
+                << stats.vertices << " indices in " << elapsed.count() * 1e3 << " ms ("
+                << stats.packets / elapsed.count() / 1e6 << " Mpackets/s) over " << options.frames
+                << " frames on " << threads << " threads, " << driver.queue_count() << " queues\n";
+      auto const& copy = driver.stats(driver.copy_queue());
+      std::cout << "  copy engine: " << copy.copies << " copies, " << copy.copy_bytes / (1 << 20)
+                << " MB in " << copy.busy_cycles * driver.timestamp_period() * 1e6
+                << " simulated us, queued by the host in " << upload_queued.count() * 1e3
+                << " ms\n";
+      if (options.zero_copy)
+         std::cout << "  zero-copy: " << driver.flushed_bytes() / (1 << 20)
+                   << " MB mapped or flushed instead of uploaded\n";
+      std::size_t peak_frame_bytes = 0, reserved = 0;
+      for (auto const& arena : arenas) {
+         // The last frames in flight were never reset, so count them too
+         peak_frame_bytes = std::max(
+               {peak_frame_bytes, arena.stats().peak_frame_bytes, arena.frame_bytes()});
+         reserved += arena.stats().bytes_reserved;
+      }
+      std::cout << "  recording: " << recording.commands << " commands -> " << recording.packets
+                << " packets, " << recording.redundant_state << " redundant state changes and "
+                << recording.coalesced_draws << " coalesced draws eliminated, "
+                << stats.indirect_commands << " indirect commands\n";
+      if (options.timings) PrintPassTimings(driver, *timestamps, *statistics, threads);
+      auto const pipelines = driver.pipeline_cache_stats();
+      std::cout << "  pipelines: " << pipelines.compiles << " compiled, " << pipelines.disk_hits
+                << " from the disk cache, " << pipelines.memory_hits << " memory cache hits\n";
+      std::cout << "  command arenas: peak " << peak_frame_bytes / 1024
+                << " KB per thread and frame, " << reserved / 1024 << " KB reserved" << std::endl;
+   }
+
+   void ReplayTrace(Options const& options, vertexsim::DrawHandler on_draw) {
+      vertexsim::FrontEndStats front_end;
+      auto const start = std::chrono::steady_clock::now();
+      auto const trace =
+            vertexsim::ReplayTrace(options.replay_path, std::move(on_draw), &front_end);
+      std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+      std::cout << "Replayed " << trace.events << " events from " << trace.chunks << " chunks ("
+                << trace.stored_bytes / 1024 << " KB, " << trace.raw_bytes / 1024
+                << " KB uncompressed)\n"
+                << "  " << front_end.packets << " packets, " << front_end.draws << " draws, "
+                << front_end.vertices << " indices in " << elapsed.count() * 1e3 << " ms ("
+                << front_end.packets / elapsed.count() / 1e6 << " Mpackets/s)" << std::endl;
+   }
+
+   void PrintCacheStats(char const* label, vertexsim::VertexCacheStats const& stats) {
+      std::cout << "  " << label << ": ACMR " << stats.acmr << ", ATVR " << stats.atvr << "\n";
+   }
+
+} // namespace
+
+int main(int argc, char** argv) {
+   auto const options = ParseOptions(argc, argv);
+   if (!options) {
+      PrintUsage(argv[0]);
+      return 1;
+   }
+   try {
+      // Per-draw models, constructed up front so bad cache geometry fails
+      // before any work
+      std::optional<VertexCacheModel> vertex_cache;
+      std::optional<PrimitiveAssemblyModel> assembly;
+      if (options->vertex_cache) vertex_cache.emplace(*options);
+      if (options->assemble) assembly.emplace();
+      vertexsim::DrawHandler on_draw;
+      if (vertex_cache || assembly) {
+         on_draw = [&](vertexsim::DrawCall const& draw) {
+            if (vertex_cache) vertex_cache->Draw(draw);
+            if (assembly) assembly->Draw(draw);
+         };
+      }
+      auto const print_models = [&] {
+         if (vertex_cache) vertex_cache->Print();
+         if (assembly) assembly->Print();
+      };
+      if (!options->replay_path.empty()) {
+         ReplayTrace(*options, std::move(on_draw));
+         print_models();
+         return 0;
+      }
+      if (options->stream) {
+         StreamMesh(*options, on_draw);
+         print_models();
+         return 0;
+      }
+      auto mesh = LoadMesh(*options);
+      std::cout << "Loaded " << mesh.vertex_count() << " vertices, " << mesh.index_count() / 3
+                << " triangles, " << 8 * static_cast<int>(mesh.index_format()) << "-bit indices"
+                << std::endl;
+      if (options->textures) LoadMaterials(*options);
+
+      if (options->optimize) {
+         auto const report = vertexsim::OptimizeMesh(mesh, *options->optimize, options->cache_size);
+         std::cout << "Vertex cache optimization (" << options->cache_size << " entries):\n";
+         PrintCacheStats("before", report.before);
+         PrintCacheStats("after", report.after);
+      }
+      if (options->meshlets) PrintMeshlets(mesh);
+      if (options->quantize) PrintQuantization(mesh);
+      if (options->transform) PrintTransform(mesh);
+      if (options->clip) PrintClipping(mesh);
+      if (options->vertex_fetch) PrintVertexFetch(mesh);
+      if (options->driver)
+         SubmitThroughDriver(mesh, *options, std::move(on_draw));
+      else if (on_draw)
+         DrawMesh(mesh, on_draw);
+      print_models();
+   } catch (std::exception const& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+}
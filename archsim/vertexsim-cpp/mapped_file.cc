@@ -0,0 +1,150 @@
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vertexsim {
+
+#ifdef _WIN32
+   MappedFile::MappedFile(std::filesystem::path const& path, Access access) {
+      bool const cow = access == Access::kCopyOnWrite;
+      HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+         throw std::runtime_error("Failed to open file: " + path.string());
+      file_ = file;
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(file, &size)) {
+         Release();
+         throw std::runtime_error("Failed to stat file: " + path.string());
+      }
+      size_ = static_cast<std::size_t>(size.QuadPart);
+      // Zero-length files cannot be mapped, leave them as an empty view
+      if (size_ == 0) return;
+      mapping_ =
+            CreateFileMappingW(file, nullptr, cow ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+      if (!mapping_) {
+         Release();
+         throw std::runtime_error("Failed to map file: " + path.string());
+      }
+      data_ = static_cast<char const*>(
+            MapViewOfFile(mapping_, cow ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+      if (!data_) {
+         Release();
+         throw std::runtime_error("Failed to map file: " + path.string());
+      }
+   }
+
+   void MappedFile::Release() {
+      if (data_) UnmapViewOfFile(data_);
+      if (mapping_) CloseHandle(mapping_);
+      if (file_) CloseHandle(file_);
+      data_ = nullptr;
+      mapping_ = nullptr;
+      file_ = nullptr;
+      size_ = 0;
+   }
+#else
+   MappedFile::MappedFile(std::filesystem::path const& path, Access access) {
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0) throw std::runtime_error("Failed to open file: " + path.string());
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+         close(fd);
+         throw std::runtime_error("Failed to stat file: " + path.string());
+      }
+      size_ = static_cast<std::size_t>(st.st_size);
+      // Zero-length files cannot be mapped, leave them as an empty view
+      if (size_ == 0) {
+         close(fd);
+         return;
+      }
+      int const prot = access == Access::kCopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+      void* addr = mmap(nullptr, size_, prot, MAP_PRIVATE, fd, 0);
+      // The mapping keeps its own reference to the file
+      close(fd);
+      if (addr == MAP_FAILED) {
+         size_ = 0;
+         throw std::runtime_error("Failed to map file: " + path.string());
+      }
+      madvise(addr, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<char const*>(addr);
+   }
+
+   void MappedFile::Release() {
+      if (data_) munmap(const_cast<char*>(data_), size_);
+      data_ = nullptr;
+      size_ = 0;
+   }
+#endif
+
+   MappedFile::~MappedFile() { Release(); }
+
+   MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+   MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+      if (this == &other) return *this;
+      Release();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+      file_ = std::exchange(other.file_, nullptr);
+      mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+      return *this;
+   }
+
+   void ReplaceFile(std::filesystem::path const& path, std::string_view what,
+                    std::initializer_list<std::span<std::byte const>> parts) {
+      // A random suffix keeps concurrent writers, even across processes, off
+      // each other's temporary files
+      std::random_device random;
+      char suffix[32];
+      std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+      auto tmp_path = path;
+      tmp_path += suffix;
+
+      std::error_code ec;
+      try {
+         std::ofstream ofs{tmp_path, std::ios::binary | std::ios::trunc};
+         if (!ofs)
+            throw std::runtime_error("Failed to create " + std::string{what} + ": " +
+                                     tmp_path.string());
+         for (auto const part : parts)
+            ofs.write(reinterpret_cast<char const*>(part.data()),
+                      static_cast<std::streamsize>(part.size()));
+         // Closing flushes; a failed flush must not replace a good file
+         ofs.close();
+         if (!ofs)
+            throw std::runtime_error("Failed to write " + std::string{what} + ": " +
+                                     tmp_path.string());
+      } catch (...) {
+         std::filesystem::remove(tmp_path, ec);
+         throw;
+      }
+      std::filesystem::rename(tmp_path, path, ec);
+      if (!ec) return;
+      std::filesystem::remove(tmp_path, ec);
+      // Renaming over a file another run has open fails on Windows; that
+      // run's file is as good as ours
+      if (std::filesystem::is_regular_file(path, ec)) return;
+      throw std::runtime_error("Failed to replace " + std::string{what} + ": " + path.string());
+   }
+
+} // namespace vertexsim
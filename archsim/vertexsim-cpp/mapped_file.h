@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+
+namespace vertexsim {
+
+   /// Memory mapping of an entire file. The mapping lives as long as the object
+   /// does, so views handed out by view() must not outlive it.
+   class MappedFile {
+   public:
+      enum class Access {
+         kReadOnly,
+         // Pages are writable but private: writes are never flushed to the file
+         kCopyOnWrite,
+      };
+
+      explicit MappedFile(std::filesystem::path const& path, Access access = Access::kReadOnly);
+      ~MappedFile();
+
+      MappedFile(MappedFile&& other) noexcept;
+      MappedFile& operator=(MappedFile&& other) noexcept;
+      MappedFile(MappedFile const&) = delete;
+      MappedFile& operator=(MappedFile const&) = delete;
+
+      char const* data() const { return data_; }
+      /// Only valid for Access::kCopyOnWrite mappings.
+      char* mutable_data() const { return const_cast<char*>(data_); }
+      std::size_t size() const { return size_; }
+      std::string_view view() const { return {data_, size_}; }
+
+   private:
+      void Release();
+
+      char const* data_ = nullptr;
+      std::size_t size_ = 0;
+#ifdef _WIN32
+      void* file_ = nullptr;
+      void* mapping_ = nullptr;
+#endif
+   };
+
+   /// Writes `parts` back to back to a uniquely named sibling of `path` and
+   /// renames it into place, so a crash or a concurrent run never observes a
+   /// half-written file. Concurrent writers are expected to produce the same
+   /// contents: if another one's file is in place and cannot be replaced,
+   /// this one's is discarded. Throws std::runtime_error naming `what` when
+   /// the file cannot be written.
+   void ReplaceFile(std::filesystem::path const& path, std::string_view what,
+                    std::initializer_list<std::span<std::byte const>> parts);
+
+} // namespace vertexsim
@@ -0,0 +1,179 @@
+#include "material.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "mapped_file.h"
+#include "number_scan.h"
+#include "obj_cursor.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+      std::string_view Trim(std::string_view s) {
+         while (!s.empty() && IsBlank(s.front())) s.remove_prefix(1);
+         while (!s.empty() && IsBlank(s.back())) s.remove_suffix(1);
+         return s;
+      }
+
+      /// Splits off the first blank-separated word of `line`.
+      std::string_view NextWord(std::string_view& line) {
+         line = Trim(line);
+         std::size_t n = 0;
+         while (n < line.size() && !IsBlank(line[n])) ++n;
+         std::string_view const word = line.substr(0, n);
+         line.remove_prefix(n);
+         return word;
+      }
+
+      class MtlParser {
+      public:
+         MtlParser(std::string_view text, std::filesystem::path const& base_dir)
+               : text_{text}, base_dir_{base_dir} {}
+
+         std::vector<Material> Parse() {
+            while (!text_.empty()) {
+               std::size_t const eol = std::min(text_.find('\n'), text_.size());
+               std::string_view line = text_.substr(0, eol);
+               text_.remove_prefix(std::min(eol + 1, text_.size()));
+               ++line_;
+               if (std::size_t const hash = line.find('#'); hash != std::string_view::npos)
+                  line = line.substr(0, hash);
+               std::string_view const keyword = NextWord(line);
+               if (!keyword.empty()) ParseStatement(keyword, Trim(line));
+            }
+            return std::move(materials_);
+         }
+
+      private:
+         void ParseStatement(std::string_view keyword, std::string_view args) {
+            if (keyword == "newmtl") {
+               if (args.empty()) Fail("expected a material name");
+               materials_.push_back({});
+               materials_.back().name = args;
+               return;
+            }
+            Material* const m = materials_.empty() ? nullptr : &materials_.back();
+            if (!m) return;
+            if (keyword == "Ka")
+               m->ambient = ReadColor(args);
+            else if (keyword == "Kd")
+               m->diffuse = ReadColor(args);
+            else if (keyword == "Ks")
+               m->specular = ReadColor(args);
+            else if (keyword == "Ke")
+               m->emissive = ReadColor(args);
+            else if (keyword == "Ns")
+               m->shininess = ReadFloat(args);
+            else if (keyword == "d")
+               m->opacity = ReadFloat(args);
+            else if (keyword == "Tr")
+               m->opacity = 1.0f - ReadFloat(args);
+            else if (keyword == "map_Ka")
+               m->ambient_map = ReadMap(args);
+            else if (keyword == "map_Kd")
+               m->diffuse_map = ReadMap(args);
+            else if (keyword == "map_Ks")
+               m->specular_map = ReadMap(args);
+            else if (keyword == "map_d")
+               m->alpha_map = ReadMap(args);
+            else if (keyword == "map_bump" || keyword == "map_Bump" || keyword == "bump")
+               m->bump_map = ReadMap(args);
+         }
+
+         float ReadFloat(std::string_view& args) {
+            std::string_view const word = NextWord(args);
+            float value;
+            char const* const end = word.data() + word.size();
+            if (word.empty() || ScanFloat(word.data(), end, value) != end)
+               Fail("expected a number");
+            return value;
+         }
+
+         /// Reads `r [g b]`; a single value is replicated like other readers do.
+         glm::vec3 ReadColor(std::string_view args) {
+            float const r = ReadFloat(args);
+            if (Trim(args).empty()) return glm::vec3{r};
+            float const g = ReadFloat(args);
+            float const b = ReadFloat(args);
+            return {r, g, b};
+         }
+
+         /// Texture statements may start with options such as `-bm 0.5`; the
+         /// file name is taken to be the last word.
+         std::filesystem::path ReadMap(std::string_view args) {
+            std::size_t const start = args.find_last_of(" \t");
+            std::string file{start == std::string_view::npos ? args : args.substr(start + 1)};
+            if (file.empty()) Fail("expected a texture file name");
+            // Many exporters write Windows separators
+            std::replace(file.begin(), file.end(), '\\', '/');
+            return (base_dir_ / file).lexically_normal();
+         }
+
+         [[noreturn]] void Fail(char const* what) const {
+            throw std::runtime_error("MTL parse error at line " + std::to_string(line_) + ": " +
+                                     what);
+         }
+
+         std::string_view text_;
+         std::filesystem::path const& base_dir_;
+         std::size_t line_ = 0;
+         std::vector<Material> materials_;
+      };
+
+   } // namespace
+
+   std::vector<Material> ParseMtl(std::string_view text, std::filesystem::path const& base_dir) {
+      return MtlParser{text, base_dir}.Parse();
+   }
+
+   std::vector<Material> LoadMtl(std::filesystem::path const& path) {
+      MappedFile file{path};
+      try {
+         return ParseMtl(file.view(), path.parent_path());
+      } catch (std::runtime_error const& e) {
+         throw std::runtime_error(path.string() + ": " + e.what());
+      }
+   }
+
+   std::vector<Material> LoadObjMaterials(std::filesystem::path const& obj_path) {
+      std::vector<std::filesystem::path> libraries;
+      {
+         MappedFile file{obj_path};
+         ObjCursor cursor{file.data(), file.data(), file.data() + file.size()};
+         while (!cursor.AtEnd()) {
+            if (cursor.NextRecord() == ObjRecord::kMaterialLibrary) {
+               // One statement may list several libraries
+               do {
+                  libraries.push_back(obj_path.parent_path() / cursor.ReadName());
+                  cursor.SkipSpaces();
+               } while (!cursor.AtLineEnd());
+            }
+            cursor.NextLine();
+         }
+      }
+      std::vector<Material> materials;
+      for (auto const& library : libraries) {
+         auto loaded = LoadMtl(library);
+         std::move(loaded.begin(), loaded.end(), std::back_inserter(materials));
+      }
+      return materials;
+   }
+
+   std::vector<std::filesystem::path> TexturePaths(std::vector<Material> const& materials) {
+      std::vector<std::filesystem::path> paths;
+      for (Material const& m : materials) {
+         for (auto const* map :
+              {&m.ambient_map, &m.diffuse_map, &m.specular_map, &m.alpha_map, &m.bump_map}) {
+            if (!map->empty() && std::find(paths.begin(), paths.end(), *map) == paths.end())
+               paths.push_back(*map);
+         }
+      }
+      return paths;
+   }
+
+} // namespace vertexsim
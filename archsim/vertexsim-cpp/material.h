@@ -0,0 +1,41 @@
+#pragma once
+
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vertexsim {
+
+   /// One `newmtl` block of a Wavefront .mtl file. Texture paths are resolved
+   /// against the directory of the .mtl and are empty when the map is absent.
+   struct Material {
+      std::string name;
+      glm::vec3 ambient{0.0f};
+      glm::vec3 diffuse{1.0f};
+      glm::vec3 specular{0.0f};
+      glm::vec3 emissive{0.0f};
+      float shininess = 0.0f;
+      float opacity = 1.0f;
+      std::filesystem::path ambient_map;
+      std::filesystem::path diffuse_map;
+      std::filesystem::path specular_map;
+      std::filesystem::path alpha_map;
+      std::filesystem::path bump_map;
+   };
+
+   /// Parses an .mtl document. Unknown statements are ignored.
+   std::vector<Material> ParseMtl(std::string_view text, std::filesystem::path const& base_dir);
+
+   std::vector<Material> LoadMtl(std::filesystem::path const& path);
+
+   /// Loads every material library an OBJ names in its `mtllib` statements.
+   /// Only those statements are read, so this does not require parsing the
+   /// geometry and works alongside a mesh loaded from its cache.
+   std::vector<Material> LoadObjMaterials(std::filesystem::path const& obj_path);
+
+   /// The distinct texture files referenced by `materials`, in first-use order.
+   std::vector<std::filesystem::path> TexturePaths(std::vector<Material> const& materials);
+
+} // namespace vertexsim
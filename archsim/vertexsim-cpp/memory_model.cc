@@ -0,0 +1,65 @@
+#include "memory_model.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace vertexsim {
+
+   LineCache::LineCache(LineCacheConfig const& config)
+         : config_{config},
+           ways_{config.associativity == 0 ? config.lines : config.associativity},
+           sets_{ways_ == 0 ? 0 : config.lines / ways_},
+           lines_(config.lines) {
+      if (!std::has_single_bit(config.line_bytes) || config.line_bytes > 64)
+         throw std::invalid_argument("Cache line size must be a power of two up to 64 bytes");
+      if (config.lines == 0 || ways_ > config.lines || config.lines % ways_ != 0)
+         throw std::invalid_argument("Cache lines must split evenly into sets");
+   }
+
+   void LineCache::Access(MemoryRequest const& request) {
+      ++stats_.requests;
+      stats_.requested_bytes += request.size;
+      std::uint64_t const line_bytes = config_.line_bytes;
+      std::uint64_t address = request.address;
+      std::uint64_t const end = request.address + request.size;
+      while (address < end) {
+         std::uint64_t const line = address / line_bytes;
+         std::uint64_t const first = address % line_bytes;
+         std::uint64_t const last = std::min(end - line * line_bytes, line_bytes);
+         std::uint64_t const bits = last - first;
+         std::uint64_t const mask = (bits == 64 ? ~std::uint64_t{0} : (1ull << bits) - 1) << first;
+         AccessLine(line, mask);
+         address = (line + 1) * line_bytes;
+      }
+   }
+
+   void LineCache::AccessLine(std::uint64_t line, std::uint64_t byte_mask) {
+      Line* const set = &lines_[line % sets_ * ways_];
+      Line* const end = set + ways_;
+      ++clock_;
+      Line* entry = std::find_if(set, end, [&](Line const& l) { return l.valid && l.tag == line; });
+      if (entry == end) {
+         // Free ways first, then the least recently used
+         entry = std::min_element(set, end, [](Line const& a, Line const& b) {
+            return a.valid < b.valid || (a.valid == b.valid && a.used < b.used);
+         });
+         Evict(*entry);
+         *entry = {line, 0, 0, true};
+         ++stats_.misses;
+         stats_.fetched_bytes += config_.line_bytes;
+      }
+      entry->used = clock_;
+      entry->byte_mask |= byte_mask;
+   }
+
+   void LineCache::Evict(Line& line) {
+      if (line.valid) stats_.used_bytes += std::popcount(line.byte_mask);
+      line = {};
+   }
+
+   void LineCache::Flush() {
+      for (auto& line : lines_) Evict(line);
+   }
+
+} // namespace vertexsim
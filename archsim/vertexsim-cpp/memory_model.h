@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vertexsim {
+
+   /// A read issued by a fixed-function unit. Addresses are host addresses of
+   /// the device's buffers, so buffer alignment shows up as it would on the
+   /// GPU.
+   struct MemoryRequest {
+      std::uint64_t address = 0;
+      std::uint32_t size = 0;
+      // Requesting stream or binding, for per-stream breakdowns
+      std::uint32_t source = 0;
+   };
+
+   /// Receives every request a unit issues. Any model of the memory system
+   /// plugs in here, from a byte counter to a cache hierarchy.
+   using MemoryHandler = std::function<void(MemoryRequest const&)>;
+
+   struct LineCacheConfig {
+      // Power of two, at most 64
+      std::uint32_t line_bytes = 64;
+      std::uint32_t lines = 256;
+      // Ways per set; zero makes the cache fully associative
+      std::uint32_t associativity = 4;
+   };
+
+   struct LineCacheStats {
+      std::uint64_t requests = 0;
+      std::uint64_t requested_bytes = 0;
+      // Line fills from memory
+      std::uint64_t misses = 0;
+      std::uint64_t fetched_bytes = 0;
+      // Distinct bytes of the fetched lines that a request asked for
+      std::uint64_t used_bytes = 0;
+
+      /// Fraction of the fetched bytes that were used before eviction.
+      double line_utilization() const {
+         return fetched_bytes ? static_cast<double>(used_bytes) / fetched_bytes : 0;
+      }
+   };
+
+   /// Set-associative LRU cache of memory lines, such as a vertex fetch
+   /// cache. Tracks which bytes of each resident line were requested, so
+   /// line utilization shows how much of the fetched data a layout wastes.
+   class LineCache {
+   public:
+      /// Throws std::invalid_argument for unsupported geometry.
+      explicit LineCache(LineCacheConfig const& config = {});
+
+      /// Splits the request at line boundaries and looks up each line.
+      void Access(MemoryRequest const& request);
+
+      /// Evicts every line, counting its used bytes.
+      void Flush();
+
+      LineCacheConfig const& config() const { return config_; }
+      /// Used bytes are only counted on eviction; Flush() first.
+      LineCacheStats const& stats() const { return stats_; }
+
+   private:
+      struct Line {
+         std::uint64_t tag = 0;
+         std::uint64_t used = 0;
+         // Bit i set when byte i was requested
+         std::uint64_t byte_mask = 0;
+         bool valid = false;
+      };
+
+      void AccessLine(std::uint64_t line, std::uint64_t byte_mask);
+      void Evict(Line& line);
+
+      LineCacheConfig config_;
+      std::uint32_t ways_;
+      std::uint32_t sets_;
+      std::vector<Line> lines_;
+      std::uint64_t clock_ = 0;
+      LineCacheStats stats_;
+   };
+
+} // namespace vertexsim
@@ -0,0 +1,136 @@
+#include "mesh_cache.h"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+
+#include "hash.h"
+#include "mapped_file.h"
+#include "welder.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      constexpr std::array<char, 8> kGmeshMagic = {'V', 'S', 'G', 'M', 'E', 'S', 'H', '\0'};
+      constexpr std::uint32_t kGmeshVersion = 2;
+      // The payload starts on its own cache line, so stream alignment carries
+      // over from the page-aligned mapping
+      constexpr std::size_t kGmeshPayloadOffset = 64;
+
+      constexpr std::uint32_t kGmeshNormals = 1 << 0;
+      constexpr std::uint32_t kGmeshTexcoords = 1 << 1;
+      constexpr std::uint32_t kGmeshIndex16 = 1 << 2;
+
+      struct GmeshHeader {
+         std::array<char, 8> magic;
+         std::uint32_t version;
+         std::uint32_t flags;
+         std::uint64_t source_hash;
+         std::uint64_t source_size;
+         std::int64_t source_mtime;
+         std::uint32_t vertex_count;
+         std::uint32_t reserved;
+         std::uint64_t index_count;
+         std::uint64_t payload_size;
+      };
+      static_assert(sizeof(GmeshHeader) <= kGmeshPayloadOffset);
+      static_assert(kGmeshPayloadOffset % kStreamAlignment == 0);
+      static_assert(std::endian::native == std::endian::little,
+                    ".gmesh files are little-endian and mapped without conversion");
+
+      bool Matches(GmeshHeader const& header, MeshSource const& source) {
+         if (header.source_size != source.size) return false;
+         if (source.hash) return header.source_hash == *source.hash;
+         return header.source_mtime == source.mtime;
+      }
+
+   } // namespace
+
+   std::filesystem::path MeshCachePath(std::filesystem::path const& obj_path) {
+      return std::filesystem::path{obj_path}.replace_extension(".gmesh");
+   }
+
+   std::optional<IndexedMesh> ReadMeshCache(std::filesystem::path const& cache_path,
+                                            MeshSource const& source) {
+      std::error_code ec;
+      if (!std::filesystem::is_regular_file(cache_path, ec)) return std::nullopt;
+
+      // Copy-on-write so later passes may edit the mesh in place without
+      // touching the file
+      auto file = std::make_shared<MappedFile>(cache_path, MappedFile::Access::kCopyOnWrite);
+      if (file->size() < kGmeshPayloadOffset) return std::nullopt;
+      GmeshHeader header;
+      std::memcpy(&header, file->data(), sizeof(header));
+      if (header.magic != kGmeshMagic || header.version != kGmeshVersion) return std::nullopt;
+      if (!Matches(header, source)) return std::nullopt;
+
+      auto const index_format =
+            header.flags & kGmeshIndex16 ? IndexFormat::kUint16 : IndexFormat::kUint32;
+      // Counts that could not fit in the file are rejected before they can
+      // overflow the layout computation
+      std::size_t const available = file->size() - kGmeshPayloadOffset;
+      if (header.vertex_count > available / sizeof(float) ||
+          header.index_count > available / static_cast<std::size_t>(index_format))
+         return std::nullopt;
+      MeshLayout const layout =
+            MeshLayout::Compute(header.vertex_count, header.index_count, index_format,
+                                header.flags & kGmeshNormals, header.flags & kGmeshTexcoords);
+      if (layout.size != header.payload_size || layout.size > available) return std::nullopt;
+
+      auto* payload = reinterpret_cast<std::byte*>(file->mutable_data() + kGmeshPayloadOffset);
+      return IndexedMesh{layout, payload, std::move(file)};
+   }
+
+   void WriteMeshCache(std::filesystem::path const& cache_path, IndexedMesh const& mesh,
+                       MeshSource const& source) {
+      if (!source.hash) throw std::invalid_argument("WriteMeshCache needs the source hash");
+
+      GmeshHeader header{};
+      header.magic = kGmeshMagic;
+      header.version = kGmeshVersion;
+      header.flags = (mesh.has_normals() ? kGmeshNormals : 0u) |
+                     (mesh.has_texcoords() ? kGmeshTexcoords : 0u) |
+                     (mesh.index_format() == IndexFormat::kUint16 ? kGmeshIndex16 : 0u);
+      header.source_hash = *source.hash;
+      header.source_size = source.size;
+      header.source_mtime = source.mtime;
+      header.vertex_count = mesh.vertex_count();
+      header.index_count = mesh.index_count();
+      header.payload_size = mesh.bytes().size();
+
+      std::array<char, kGmeshPayloadOffset> prefix{};
+      std::memcpy(prefix.data(), &header, sizeof(header));
+      ReplaceFile(cache_path, "mesh cache", {std::as_bytes(std::span{prefix}), mesh.bytes()});
+   }
+
+   IndexedMesh LoadMesh(std::filesystem::path const& obj_path, unsigned threads) {
+      auto const cache_path = MeshCachePath(obj_path);
+      MeshSource source;
+      source.size = std::filesystem::file_size(obj_path);
+      source.mtime = std::filesystem::last_write_time(obj_path).time_since_epoch().count();
+      if (auto mesh = ReadMeshCache(cache_path, source)) return std::move(*mesh);
+
+      MappedFile obj{obj_path};
+      source.hash = Hash64(std::as_bytes(std::span{obj.data(), obj.size()}));
+      if (auto mesh = ReadMeshCache(cache_path, source)) return std::move(*mesh);
+
+      IndexedMesh mesh;
+      try {
+         mesh = WeldMesh(ParseObj(obj.view(), threads));
+      } catch (std::runtime_error const& e) {
+         throw std::runtime_error(obj_path.string() + ": " + e.what());
+      }
+      try {
+         WriteMeshCache(cache_path, mesh, source);
+      } catch (std::exception const& e) {
+         std::cerr << "Warning: " << e.what() << std::endl;
+      }
+      return mesh;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+#include "indexed_mesh.h"
+
+namespace vertexsim {
+
+   /// Identifies the OBJ a .gmesh cache was built from. A cache matches when
+   /// the sizes agree and either the content hashes agree or, if no hash is
+   /// given, the modification times do. This lets unchanged files skip
+   /// hashing entirely while touched-but-identical files still hit.
+   struct MeshSource {
+      std::uint64_t size = 0;
+      std::int64_t mtime = 0;
+      std::optional<std::uint64_t> hash;
+   };
+
+   /// `sponza.obj` caches to `sponza.gmesh` in the same directory.
+   std::filesystem::path MeshCachePath(std::filesystem::path const& obj_path);
+
+   /// Maps the cache at `cache_path` and returns the mesh stored in it without
+   /// copying or parsing anything. Returns nullopt if the file is missing,
+   /// malformed, from another format version or built from another source.
+   std::optional<IndexedMesh> ReadMeshCache(std::filesystem::path const& cache_path,
+                                            MeshSource const& source);
+
+   /// Writes `mesh` to `cache_path`, replacing the file atomically. `source`
+   /// must carry the content hash.
+   void WriteMeshCache(std::filesystem::path const& cache_path, IndexedMesh const& mesh,
+                       MeshSource const& source);
+
+   /// Loads `obj_path` through its .gmesh cache, rebuilding the cache when it
+   /// is missing or stale. Failing to write the cache is not an error.
+   IndexedMesh LoadMesh(std::filesystem::path const& obj_path, unsigned threads = 1);
+
+} // namespace vertexsim
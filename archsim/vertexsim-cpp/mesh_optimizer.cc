@@ -0,0 +1,294 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace vertexsim {
+
+   namespace {
+
+      std::vector<std::uint32_t> ReadIndices(IndexedMesh const& mesh) {
+         return mesh.VisitIndices([](auto indices) {
+            return std::vector<std::uint32_t>(indices.begin(), indices.end());
+         });
+      }
+
+      void WriteIndices(IndexedMesh& mesh, std::vector<std::uint32_t> const& indices) {
+         mesh.VisitIndices([&](auto out) {
+            using T = typename decltype(out)::value_type;
+            for (std::size_t i = 0; i < indices.size(); ++i) out[i] = static_cast<T>(indices[i]);
+         });
+      }
+
+      VertexCacheStats Analyze(std::span<std::uint32_t const> indices, std::uint32_t vertex_count,
+                               std::uint32_t cache_size) {
+         // Per-vertex insertion time; a vertex is cached while fewer than
+         // cache_size insertions happened after it
+         std::vector<std::uint64_t> inserted(vertex_count, 0);
+         std::vector<bool> used(vertex_count, false);
+         std::uint64_t time = cache_size + 1;
+         VertexCacheStats stats;
+         std::uint64_t unique = 0;
+         for (std::uint32_t const v : indices) {
+            if (time - inserted[v] > cache_size) {
+               inserted[v] = time++;
+               ++stats.misses;
+            }
+            if (!used[v]) {
+               used[v] = true;
+               ++unique;
+            }
+         }
+         std::size_t const triangles = indices.size() / 3;
+         stats.acmr = triangles ? static_cast<double>(stats.misses) / triangles : 0;
+         stats.atvr = unique ? static_cast<double>(stats.misses) / unique : 0;
+         return stats;
+      }
+
+      /// Triangles incident to each vertex in compressed row form.
+      struct Adjacency {
+         std::vector<std::uint32_t> offsets;
+         std::vector<std::uint32_t> triangles;
+
+         Adjacency(std::span<std::uint32_t const> indices, std::uint32_t vertex_count)
+               : offsets(vertex_count + 1, 0), triangles(indices.size()) {
+            for (std::uint32_t const v : indices) ++offsets[v + 1];
+            for (std::uint32_t v = 0; v < vertex_count; ++v) offsets[v + 1] += offsets[v];
+            std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < indices.size(); ++i)
+               triangles[cursor[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+         }
+
+         std::span<std::uint32_t const> Of(std::uint32_t v) const {
+            return {triangles.data() + offsets[v], offsets[v + 1] - offsets[v]};
+         }
+      };
+
+      std::vector<std::uint32_t> Tipsify(std::span<std::uint32_t const> indices,
+                                         std::uint32_t vertex_count, std::uint32_t cache_size) {
+         Adjacency const adjacency{indices, vertex_count};
+         std::vector<std::uint32_t> live(vertex_count);
+         for (std::uint32_t v = 0; v < vertex_count; ++v)
+            live[v] = static_cast<std::uint32_t>(adjacency.Of(v).size());
+         std::vector<std::uint64_t> stamp(vertex_count, 0);
+         std::vector<bool> emitted(indices.size() / 3, false);
+         std::vector<std::uint32_t> dead_end;
+         std::vector<std::uint32_t> candidates;
+         std::vector<std::uint32_t> out;
+         out.reserve(indices.size());
+
+         std::uint64_t time = cache_size + 1;
+         std::uint32_t cursor = 0;
+         std::int64_t fan = vertex_count ? 0 : -1;
+         while (fan >= 0) {
+            candidates.clear();
+            for (std::uint32_t const t : adjacency.Of(static_cast<std::uint32_t>(fan))) {
+               if (emitted[t]) continue;
+               emitted[t] = true;
+               for (std::uint32_t k = 0; k < 3; ++k) {
+                  std::uint32_t const v = indices[3 * t + k];
+                  out.push_back(v);
+                  dead_end.push_back(v);
+                  candidates.push_back(v);
+                  --live[v];
+                  if (time - stamp[v] > cache_size) stamp[v] = time++;
+               }
+            }
+
+            // Prefer the candidate that stays in cache longest, provided its
+            // remaining fan still fits before it is evicted
+            fan = -1;
+            std::int64_t best = -1;
+            auto const window = static_cast<std::int64_t>(cache_size);
+            for (std::uint32_t const v : candidates) {
+               if (live[v] == 0) continue;
+               std::int64_t priority = 0;
+               auto const age = static_cast<std::int64_t>(time - stamp[v]);
+               if (age + 2 * static_cast<std::int64_t>(live[v]) <= window) priority = age;
+               if (priority > best) {
+                  best = priority;
+                  fan = v;
+               }
+            }
+            if (fan >= 0) continue;
+
+            // Dead end: back up through recently used vertices, then scan
+            while (!dead_end.empty()) {
+               std::uint32_t const v = dead_end.back();
+               dead_end.pop_back();
+               if (live[v] > 0) {
+                  fan = v;
+                  break;
+               }
+            }
+            while (fan < 0 && cursor < vertex_count) {
+               if (live[cursor] > 0) fan = cursor;
+               ++cursor;
+            }
+         }
+         return out;
+      }
+
+      // Scoring constants from Forsyth's reference implementation
+      constexpr std::uint32_t kForsythMaxCache = 32;
+      constexpr float kCacheDecayPower = 1.5f;
+      constexpr float kLastTriangleScore = 0.75f;
+      constexpr float kValenceBoostScale = 2.0f;
+      constexpr float kValenceBoostPower = 0.5f;
+
+      struct ForsythScores {
+         std::array<float, kForsythMaxCache> cache{};
+         std::array<float, 64> valence{};
+
+         explicit ForsythScores(std::uint32_t cache_size) {
+            for (std::uint32_t i = 0; i < cache_size; ++i) {
+               // The three most recent vertices belong to the last triangle and
+               // get a fixed score so it is not immediately repeated
+               cache[i] = i < 3 ? kLastTriangleScore
+                                : std::pow(1.0f - static_cast<float>(i - 3) / (cache_size - 3),
+                                           kCacheDecayPower);
+            }
+            for (std::size_t i = 1; i < valence.size(); ++i)
+               valence[i] =
+                     kValenceBoostScale * std::pow(static_cast<float>(i), -kValenceBoostPower);
+         }
+
+         float Score(std::int32_t cache_position, std::uint32_t live) const {
+            if (live == 0) return -1.0f;
+            float score = cache_position >= 0 ? cache[cache_position] : 0.0f;
+            return score + valence[std::min<std::size_t>(live, valence.size() - 1)];
+         }
+      };
+
+      std::vector<std::uint32_t> Forsyth(std::span<std::uint32_t const> indices,
+                                         std::uint32_t vertex_count, std::uint32_t cache_size) {
+         cache_size = std::clamp<std::uint32_t>(cache_size, 4, kForsythMaxCache);
+         ForsythScores const scores{cache_size};
+         std::size_t const triangle_count = indices.size() / 3;
+
+         // Adjacency lists shrink as triangles are emitted, live[v] is the
+         // current length of v's list
+         Adjacency adjacency{indices, vertex_count};
+         std::vector<std::uint32_t> live(vertex_count);
+         std::vector<std::int32_t> position(vertex_count, -1);
+         std::vector<float> vertex_score(vertex_count);
+         for (std::uint32_t v = 0; v < vertex_count; ++v) {
+            live[v] = static_cast<std::uint32_t>(adjacency.Of(v).size());
+            vertex_score[v] = scores.Score(-1, live[v]);
+         }
+         std::vector<float> triangle_score(triangle_count);
+         std::vector<bool> emitted(triangle_count, false);
+         for (std::size_t t = 0; t < triangle_count; ++t)
+            triangle_score[t] = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] +
+                                vertex_score[indices[3 * t + 2]];
+
+         std::vector<std::uint32_t> cache, next_cache;
+         std::vector<std::uint32_t> out;
+         out.reserve(indices.size());
+         std::size_t cursor = 0;
+         std::int64_t best = triangle_count ? 0 : -1;
+         for (std::size_t t = 0; t < triangle_count; ++t)
+            if (triangle_score[t] > triangle_score[best]) best = static_cast<std::int64_t>(t);
+
+         while (best >= 0) {
+            auto const tri = static_cast<std::uint32_t>(best);
+            emitted[tri] = true;
+            std::uint32_t const* corners = &indices[3 * tri];
+
+            next_cache.assign(corners, corners + 3);
+            for (std::uint32_t k = 0; k < 3; ++k) {
+               std::uint32_t const v = corners[k];
+               // Move the emitted triangle to the dead tail of v's list
+               auto* list = adjacency.triangles.data() + adjacency.offsets[v];
+               std::swap(*std::find(list, list + live[v], tri), list[live[v] - 1]);
+               --live[v];
+            }
+            for (std::uint32_t const v : cache)
+               if (v != corners[0] && v != corners[1] && v != corners[2]) next_cache.push_back(v);
+            for (std::size_t i = cache_size; i < next_cache.size(); ++i) {
+               position[next_cache[i]] = -1;
+               vertex_score[next_cache[i]] = scores.Score(-1, live[next_cache[i]]);
+            }
+            next_cache.resize(std::min<std::size_t>(next_cache.size(), cache_size));
+            cache.swap(next_cache);
+
+            for (std::size_t i = 0; i < cache.size(); ++i) {
+               position[cache[i]] = static_cast<std::int32_t>(i);
+               vertex_score[cache[i]] = scores.Score(static_cast<std::int32_t>(i), live[cache[i]]);
+            }
+
+            // Only triangles touching the cache changed score
+            best = -1;
+            float best_score = -1.0f;
+            for (std::uint32_t const v : cache) {
+               for (std::uint32_t const t : adjacency.Of(v).first(live[v])) {
+                  float const score = vertex_score[indices[3 * t]] +
+                                      vertex_score[indices[3 * t + 1]] +
+                                      vertex_score[indices[3 * t + 2]];
+                  triangle_score[t] = score;
+                  if (score > best_score) {
+                     best_score = score;
+                     best = t;
+                  }
+               }
+            }
+            if (best < 0) {
+               while (cursor < triangle_count && emitted[cursor]) ++cursor;
+               if (cursor < triangle_count) best = static_cast<std::int64_t>(cursor);
+            }
+            out.insert(out.end(), corners, corners + 3);
+         }
+         return out;
+      }
+
+      /// Renumbers vertices in order of first use and permutes every stream to
+      /// match. Unreferenced vertices move to the end.
+      void OptimizeVertexFetch(IndexedMesh& mesh, std::vector<std::uint32_t>& indices) {
+         std::uint32_t const vertex_count = mesh.vertex_count();
+         constexpr std::uint32_t kUnassigned = ~std::uint32_t{0};
+         std::vector<std::uint32_t> remap(vertex_count, kUnassigned);
+         std::uint32_t next = 0;
+         for (std::uint32_t& v : indices) {
+            if (remap[v] == kUnassigned) remap[v] = next++;
+            v = remap[v];
+         }
+         for (std::uint32_t& r : remap)
+            if (r == kUnassigned) r = next++;
+
+         std::vector<float> scratch(vertex_count);
+         for (std::size_t s = 0; s < kVertexStreamCount; ++s) {
+            auto stream = mesh.stream(static_cast<VertexStream>(s));
+            if (stream.empty()) continue;
+            for (std::uint32_t v = 0; v < vertex_count; ++v) scratch[remap[v]] = stream[v];
+            std::copy(scratch.begin(), scratch.end(), stream.begin());
+         }
+      }
+
+   } // namespace
+
+   VertexCacheStats AnalyzeVertexCache(IndexedMesh const& mesh, std::uint32_t cache_size) {
+      return Analyze(ReadIndices(mesh), mesh.vertex_count(), cache_size);
+   }
+
+   MeshOptimizeReport OptimizeMesh(IndexedMesh& mesh, VertexCacheAlgorithm algorithm,
+                                   std::uint32_t cache_size) {
+      if (cache_size < 3) throw std::invalid_argument("Vertex cache must hold a triangle");
+      MeshOptimizeReport report;
+      std::vector<std::uint32_t> indices = ReadIndices(mesh);
+      report.before = Analyze(indices, mesh.vertex_count(), cache_size);
+
+      indices = algorithm == VertexCacheAlgorithm::kForsyth
+                      ? Forsyth(indices, mesh.vertex_count(), cache_size)
+                      : Tipsify(indices, mesh.vertex_count(), cache_size);
+      OptimizeVertexFetch(mesh, indices);
+      WriteIndices(mesh, indices);
+
+      report.after = Analyze(indices, mesh.vertex_count(), cache_size);
+      return report;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,157 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+
+namespace vertexsim {
+
+   namespace {
+
+      class PositionReader {
+      public:
+         explicit PositionReader(IndexedMesh const& mesh)
+               : x_{mesh.stream(VertexStream::kPositionX)},
+                 y_{mesh.stream(VertexStream::kPositionY)},
+                 z_{mesh.stream(VertexStream::kPositionZ)} {}
+
+         glm::vec3 operator[](std::uint32_t v) const { return {x_[v], y_[v], z_[v]}; }
+
+      private:
+         std::span<float const> x_, y_, z_;
+      };
+
+      /// Ritter's bounding sphere: start from the most distant pair of axis
+      /// extremes, then grow to take in any point still outside. Within a few
+      /// percent of the minimal sphere and linear time.
+      void ComputeSphere(Meshlet& m, std::span<std::uint32_t const> vertices,
+                         PositionReader const& positions) {
+         std::uint32_t min_v[3], max_v[3];
+         std::fill(std::begin(min_v), std::end(min_v), vertices[0]);
+         std::fill(std::begin(max_v), std::end(max_v), vertices[0]);
+         for (std::uint32_t const v : vertices) {
+            glm::vec3 const p = positions[v];
+            for (int axis = 0; axis < 3; ++axis) {
+               if (p[axis] < positions[min_v[axis]][axis]) min_v[axis] = v;
+               if (p[axis] > positions[max_v[axis]][axis]) max_v[axis] = v;
+            }
+         }
+         glm::vec3 a{0.0f}, b{0.0f};
+         float longest = -1.0f;
+         for (int axis = 0; axis < 3; ++axis) {
+            glm::vec3 const d = positions[max_v[axis]] - positions[min_v[axis]];
+            if (float const len2 = glm::dot(d, d); len2 > longest) {
+               longest = len2;
+               a = positions[min_v[axis]];
+               b = positions[max_v[axis]];
+            }
+         }
+         glm::vec3 center = (a + b) * 0.5f;
+         float radius = std::sqrt(longest) * 0.5f;
+         for (std::uint32_t const v : vertices) {
+            glm::vec3 const d = positions[v] - center;
+            float const dist = std::sqrt(glm::dot(d, d));
+            if (dist > radius) {
+               float const grown = (radius + dist) * 0.5f;
+               center += d * ((grown - radius) / dist);
+               radius = grown;
+            }
+         }
+         m.center = center;
+         m.radius = radius;
+      }
+
+      /// Averages the face normals into the cone axis and widens the cone
+      /// until it holds all of them. Degenerate triangles face nowhere and are
+      /// skipped.
+      void ComputeCone(Meshlet& m, std::span<std::uint32_t const> vertices,
+                       std::span<std::uint8_t const> triangles, PositionReader const& positions) {
+         std::vector<glm::vec3> normals;
+         normals.reserve(triangles.size() / 3);
+         glm::vec3 sum{0.0f};
+         for (std::size_t t = 0; t < triangles.size(); t += 3) {
+            glm::vec3 const p0 = positions[vertices[triangles[t]]];
+            glm::vec3 const p1 = positions[vertices[triangles[t + 1]]];
+            glm::vec3 const p2 = positions[vertices[triangles[t + 2]]];
+            glm::vec3 const n = glm::cross(p1 - p0, p2 - p0);
+            float const len = std::sqrt(glm::dot(n, n));
+            if (len == 0.0f) continue;
+            normals.push_back(n / len);
+            sum += normals.back();
+         }
+         float const sum_len = std::sqrt(glm::dot(sum, sum));
+         if (normals.empty() || sum_len == 0.0f) return;
+         glm::vec3 const axis = sum / sum_len;
+         float min_dot = 1.0f;
+         for (glm::vec3 const& n : normals) min_dot = std::min(min_dot, glm::dot(n, axis));
+         m.cone_axis = axis;
+         // Faces more than 90 degrees apart can face any direction between
+         // them; otherwise store the sine of the cone half-angle
+         m.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+      }
+
+   } // namespace
+
+   MeshletSet BuildMeshlets(IndexedMesh const& mesh, std::uint32_t max_vertices,
+                            std::uint32_t max_triangles) {
+      if (max_vertices < 3 || max_vertices > kMaxMeshletVertices || max_triangles < 1)
+         throw std::invalid_argument("Meshlet limits must fit at least one triangle");
+
+      PositionReader const positions{mesh};
+      MeshletSet set;
+      // Local number of each mesh vertex in the open meshlet
+      constexpr std::uint32_t kAbsent = ~0u;
+      std::vector<std::uint32_t> local(mesh.vertex_count(), kAbsent);
+      Meshlet open;
+
+      auto const close = [&] {
+         if (open.triangle_count == 0) return;
+         std::span<std::uint32_t const> const vertices{set.vertices.data() + open.vertex_offset,
+                                                       open.vertex_count};
+         std::span<std::uint8_t const> const triangles{
+               set.triangles.data() + std::size_t{open.triangle_offset} * 3,
+               std::size_t{open.triangle_count} * 3};
+         ComputeSphere(open, vertices, positions);
+         ComputeCone(open, vertices, triangles, positions);
+         for (std::uint32_t const v : vertices) local[v] = kAbsent;
+         set.meshlets.push_back(open);
+         open = {};
+         open.vertex_offset = static_cast<std::uint32_t>(set.vertices.size());
+         open.triangle_offset = static_cast<std::uint32_t>(set.triangles.size() / 3);
+      };
+
+      mesh.VisitIndices([&](auto indices) {
+         for (std::size_t t = 0; t + 3 <= indices.size(); t += 3) {
+            std::uint32_t const tri[3] = {indices[t], indices[t + 1], indices[t + 2]};
+            std::uint32_t const added = (local[tri[0]] == kAbsent) +
+                                        (local[tri[1]] == kAbsent && tri[1] != tri[0]) +
+                                        (local[tri[2]] == kAbsent && tri[2] != tri[0] &&
+                                         tri[2] != tri[1]);
+            if (open.vertex_count + added > max_vertices || open.triangle_count == max_triangles)
+               close();
+            for (std::uint32_t const v : tri) {
+               if (local[v] == kAbsent) {
+                  local[v] = open.vertex_count++;
+                  set.vertices.push_back(v);
+               }
+               set.triangles.push_back(static_cast<std::uint8_t>(local[v]));
+            }
+            ++open.triangle_count;
+         }
+      });
+      close();
+      return set;
+   }
+
+   bool IsMeshletBackfacing(Meshlet const& meshlet, glm::vec3 const& camera) {
+      // The whole bounding sphere must lie behind every face plane, so the
+      // view direction to the sphere is tested against the cone widened by
+      // the sphere's angular radius
+      glm::vec3 const view = meshlet.center - camera;
+      float const distance = std::sqrt(glm::dot(view, view));
+      return glm::dot(view, meshlet.cone_axis) >=
+             meshlet.cone_cutoff * distance + meshlet.radius;
+   }
+
+} // namespace vertexsim
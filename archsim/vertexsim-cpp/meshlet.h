@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "indexed_mesh.h"
+
+namespace vertexsim {
+
+   // Limits that suit mesh shader hardware: 64 vertices fit one wave-sized
+   // vertex batch, and 124 triangles keep the primitive block under 512 bytes
+   inline constexpr std::uint32_t kDefaultMeshletVertices = 64;
+   inline constexpr std::uint32_t kDefaultMeshletTriangles = 124;
+   // Local vertex indices are stored as bytes
+   inline constexpr std::uint32_t kMaxMeshletVertices = 256;
+
+   /// A cluster of triangles with its own small vertex list, plus the bounds
+   /// needed to cull it as a unit.
+   struct Meshlet {
+      // Into MeshletSet::vertices
+      std::uint32_t vertex_offset = 0;
+      std::uint32_t vertex_count = 0;
+      // Into MeshletSet::triangles, counted in triangles
+      std::uint32_t triangle_offset = 0;
+      std::uint32_t triangle_count = 0;
+
+      glm::vec3 center{0.0f};
+      float radius = 0.0f;
+      // Normal cone: every front face normal is within the cone around
+      // `cone_axis`. A cutoff of 1 means the cone is too wide to cull with.
+      glm::vec3 cone_axis{0.0f};
+      float cone_cutoff = 1.0f;
+   };
+
+   struct MeshletSet {
+      std::vector<Meshlet> meshlets;
+      // Mesh vertex numbers referenced by each meshlet, in local order
+      std::vector<std::uint32_t> vertices;
+      // Three local vertex numbers per triangle
+      std::vector<std::uint8_t> triangles;
+   };
+
+   /// Partitions the triangles of `mesh` into meshlets of at most
+   /// `max_vertices` unique vertices and `max_triangles` triangles.
+   ///
+   /// Triangles are taken in index buffer order and a meshlet is closed when
+   /// the next triangle does not fit, so clusters are as coherent as the
+   /// triangle order. Running OptimizeMesh() first gives compact clusters
+   /// with high vertex reuse.
+   MeshletSet BuildMeshlets(IndexedMesh const& mesh,
+                            std::uint32_t max_vertices = kDefaultMeshletVertices,
+                            std::uint32_t max_triangles = kDefaultMeshletTriangles);
+
+   /// True if no triangle of `meshlet` can face a camera at `camera`, so the
+   /// whole cluster can be culled. Conservative: false is always safe.
+   bool IsMeshletBackfacing(Meshlet const& meshlet, glm::vec3 const& camera);
+
+} // namespace vertexsim
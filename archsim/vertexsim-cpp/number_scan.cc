@@ -0,0 +1,254 @@
+#include "number_scan.h"
+
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+namespace vertexsim {
+
+   namespace {
+
+      // Every double with a mantissa below 2^53 times a power of ten up to
+      // 10^22 is exact, so one multiply or divide rounds correctly
+      constexpr double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+      constexpr std::uint64_t kMaxExactMantissa = std::uint64_t{1} << 53;
+      constexpr int kMaxExactPow10 = 22;
+      constexpr int kMaxFastDigits = 19;
+      // The vector fast paths read at most this many bytes past the sign
+      constexpr std::ptrdiff_t kFastPathBytes = 24;
+
+      bool IsDigit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+      /// Converts 8 ASCII digits, packed little-endian into `v`, with SWAR
+      /// arithmetic.
+      std::uint32_t EightDigitsValue(std::uint64_t v) {
+         v -= 0x3030303030303030;
+         v = (v * 10) + (v >> 8);
+         v = (((v & 0x000000FF000000FF) * 0x000F424000000064) +
+              (((v >> 16) & 0x000000FF000000FF) * 0x0000271000000001)) >>
+             32;
+         return static_cast<std::uint32_t>(v);
+      }
+
+      std::uint64_t LoadEight(char const* p) {
+         std::uint64_t v;
+         std::memcpy(&v, p, sizeof(v));
+         if constexpr (std::endian::native == std::endian::big) v = __builtin_bswap64(v);
+         return v;
+      }
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+      /// Value of the `count` <= 8 digits at `p`, which must be readable for 8
+      /// bytes. Missing digits are shifted in as leading zeros.
+      std::uint32_t ParseShortDigits(char const* p, unsigned count) {
+         // Shifts are split in two so that a pad of 64 bits stays well defined
+         // and the whole conversion is branch-free
+         unsigned const pad = 8 * (8 - count);
+         std::uint64_t const keep = (~std::uint64_t{0} << (pad / 2)) << (pad - pad / 2);
+         std::uint64_t const v = ((LoadEight(p) << (pad / 2)) << (pad - pad / 2)) |
+                                 (0x3030303030303030 & ~keep);
+         return EightDigitsValue(v);
+      }
+#endif
+
+      /// Appends `count` digits at `p` to `value`. The caller guarantees the
+      /// result cannot overflow.
+      std::uint64_t AccumulateDigits(char const* p, std::size_t count, std::uint64_t value) {
+         for (; count >= 8; p += 8, count -= 8)
+            value = value * 100000000 + EightDigitsValue(LoadEight(p));
+         for (; count > 0; ++p, --count) value = value * 10 + static_cast<unsigned>(*p - '0');
+         return value;
+      }
+
+      /// True when rounding `value` to float could differ from rounding the
+      /// exact decimal, i.e. when the double sits halfway between two floats.
+      bool IsFloatMidpoint(double value) {
+         return (std::bit_cast<std::uint64_t>(value) & 0x1FFFFFFF) == 0x10000000;
+      }
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+      /// Bit i is set when p[i] is an ASCII digit. Reads 16 bytes.
+      std::uint32_t DigitMask16(char const* p) {
+         __m128i const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+         __m128i const digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)),
+                                             _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), chunk));
+         return static_cast<std::uint32_t>(_mm_movemask_epi8(digit));
+      }
+#endif
+
+      char const* LibraryFloat(char const* p, char const* end, float& out) {
+         auto [ptr, ec] = std::from_chars(p, end, out);
+         return ec == std::errc{} ? ptr : nullptr;
+      }
+
+      char const* LibraryInt(char const* p, char const* end, std::int64_t& out) {
+         auto [ptr, ec] = std::from_chars(p, end, out);
+         return ec == std::errc{} ? ptr : nullptr;
+      }
+
+   } // namespace
+
+   std::size_t CountDigits(char const* p, char const* end) {
+      char const* const start = p;
+#if defined(__AVX2__)
+      __m256i const lo = _mm256_set1_epi8('0' - 1);
+      __m256i const hi = _mm256_set1_epi8('9' + 1);
+      for (; end - p >= 32; p += 32) {
+         __m256i const chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+         __m256i const digit = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, lo),
+                                                _mm256_cmpgt_epi8(hi, chunk));
+         auto const mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(digit));
+         if (mask != 0xFFFFFFFF) return (p - start) + std::countr_one(mask);
+      }
+#endif
+#if defined(__AVX2__) || defined(__SSE4_2__)
+      for (; end - p >= 16; p += 16) {
+         std::uint32_t const mask = DigitMask16(p);
+         if (mask != 0xFFFF) return (p - start) + std::countr_one(mask);
+      }
+#endif
+      while (p != end && IsDigit(*p)) ++p;
+      return p - start;
+   }
+
+   namespace {
+
+      /// Handles every input shape the fast paths below reject: long digit
+      /// runs, exponents, inputs near the end of the buffer and anything that
+      /// is not a plain decimal.
+      char const* ScanFloatGeneral(char const* p, char const* end, float& out) {
+         char const* const start = p;
+         bool const negative = p != end && *p == '-';
+         p += negative;
+
+         std::size_t const int_count = CountDigits(p, end);
+         char const* const int_digits = p;
+         p += int_count;
+         std::size_t frac_count = 0;
+         char const* frac_digits = p;
+         if (p != end && *p == '.') {
+            frac_digits = ++p;
+            frac_count = CountDigits(p, end);
+            p += frac_count;
+         }
+         // inf, nan and friends
+         if (int_count + frac_count == 0) return LibraryFloat(start, end, out);
+
+         int exponent = 0;
+         if (p != end && (*p == 'e' || *p == 'E')) {
+            char const* q = p + 1;
+            bool const exp_negative = q != end && *q == '-';
+            if (q != end && (*q == '-' || *q == '+')) ++q;
+            std::size_t const exp_count = CountDigits(q, end);
+            // A dangling 'e' is not part of the number, as with from_chars
+            if (exp_count != 0) {
+               if (exp_count > 4) return LibraryFloat(start, end, out);
+               exponent = static_cast<int>(AccumulateDigits(q, exp_count, 0));
+               if (exp_negative) exponent = -exponent;
+               p = q + exp_count;
+            }
+         }
+
+         // Leading zeros do not count towards the significant digits
+         char const* sig = int_digits;
+         std::size_t sig_int = int_count;
+         while (sig_int > 0 && *sig == '0') ++sig, --sig_int;
+         std::size_t sig_frac = frac_count;
+         if (sig_int == 0)
+            while (sig_frac > 0 && frac_digits[frac_count - sig_frac] == '0') --sig_frac;
+         if (sig_int + sig_frac > kMaxFastDigits) return LibraryFloat(start, end, out);
+
+         std::uint64_t mantissa = AccumulateDigits(sig, sig_int, 0);
+         mantissa = AccumulateDigits(frac_digits + (frac_count - sig_frac), sig_frac, mantissa);
+         exponent -= static_cast<int>(frac_count);
+
+         double value = 0.0;
+         if (mantissa != 0) {
+            if (mantissa > kMaxExactMantissa || exponent < -kMaxExactPow10 ||
+                exponent > kMaxExactPow10)
+               return LibraryFloat(start, end, out);
+            value = exponent < 0 ? static_cast<double>(mantissa) / kPow10[-exponent]
+                                 : static_cast<double>(mantissa) * kPow10[exponent];
+            if (IsFloatMidpoint(value)) return LibraryFloat(start, end, out);
+         }
+         float const result = static_cast<float>(value);
+         out = negative ? -result : result;
+         return p;
+      }
+
+      char const* ScanIntGeneral(char const* p, char const* end, std::int64_t& out) {
+         bool const negative = p != end && *p == '-';
+         char const* const digits = p + negative;
+         std::size_t const count = CountDigits(digits, end);
+         if (count == 0) return nullptr;
+         // Leave anything that might not fit to the library
+         if (count > 18) return LibraryInt(p, end, out);
+         auto const value = static_cast<std::int64_t>(AccumulateDigits(digits, count, 0));
+         out = negative ? -value : value;
+         return digits + count;
+      }
+
+   } // namespace
+
+   char const* ScanInt(char const* p, char const* end, std::int64_t& out) {
+#if defined(__AVX2__) || defined(__SSE4_2__)
+      // Indices almost always have at most 8 digits: classify them with one
+      // vector compare and convert them with one SWAR step
+      bool const negative = p != end && *p == '-';
+      char const* const digits = p + negative;
+      if (end - digits >= kFastPathBytes) {
+         unsigned const count = std::countr_one(DigitMask16(digits));
+         if (count - 1 < 8) {
+            std::int64_t const value = ParseShortDigits(digits, count);
+            out = negative ? -value : value;
+            return digits + count;
+         }
+      }
+#endif
+      return ScanIntGeneral(p, end, out);
+   }
+
+   char const* ScanFloat(char const* p, char const* end, float& out) {
+#if defined(__AVX2__) || defined(__SSE4_2__)
+      // Fast path for the common OBJ shape: at most 8 integer and 8 fraction
+      // digits and no exponent. A single 16-byte digit mask covers both runs
+      // and the value is assembled with two SWAR conversions.
+      bool const negative = p != end && *p == '-';
+      char const* const digits = p + negative;
+      if (end - digits >= kFastPathBytes) {
+         std::uint32_t const mask = DigitMask16(digits);
+         unsigned const int_count = std::countr_one(mask);
+         unsigned frac_count = 0;
+         char const* q = digits + int_count;
+         if (int_count <= 8 && *q == '.') {
+            frac_count = std::countr_one(mask >> (int_count + 1));
+            q += 1 + frac_count;
+         }
+         // The fraction run must also end inside the 16-byte window
+         if (int_count <= 8 && frac_count <= 8 && q - digits < 16 && int_count + frac_count > 0 &&
+             *q != 'e' && *q != 'E') {
+            // Both halves are below 10^8, so the mantissa is exact in a double
+            std::uint64_t const mantissa =
+                  std::uint64_t{ParseShortDigits(digits, int_count)} *
+                        static_cast<std::uint64_t>(kPow10[frac_count]) +
+                  ParseShortDigits(digits + int_count + 1, frac_count);
+            double const value = static_cast<double>(mantissa) / kPow10[frac_count];
+            if (!IsFloatMidpoint(value)) {
+               float const result = static_cast<float>(value);
+               out = negative ? -result : result;
+               return q;
+            }
+         }
+      }
+#endif
+      return ScanFloatGeneral(p, end, out);
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vertexsim {
+
+   /// Parses a decimal float at `p` exactly like std::from_chars in general
+   /// format: same accepted syntax, same correctly rounded result. Digit runs
+   /// are classified with AVX2/SSE when available and decimal strings that fit
+   /// a double are converted without going through the slow path.
+   ///
+   /// Returns the first unconsumed character, or nullptr if no number starts
+   /// at `p` (in which case `out` is left untouched).
+   char const* ScanFloat(char const* p, char const* end, float& out);
+
+   /// Parses an optionally negative decimal integer at `p`. Returns the first
+   /// unconsumed character, or nullptr on a missing number or overflow.
+   char const* ScanInt(char const* p, char const* end, std::int64_t& out);
+
+   /// Number of consecutive ASCII digits starting at `p`.
+   std::size_t CountDigits(char const* p, char const* end);
+
+} // namespace vertexsim
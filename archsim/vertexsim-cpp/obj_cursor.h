@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "number_scan.h"
+
+namespace vertexsim {
+
+   enum class ObjRecord {
+      kPosition,
+      kTexcoord,
+      kNormal,
+      kFace,
+      kMaterialLibrary,
+      kOther,
+   };
+
+   /// Tokenizer shared by the OBJ readers. It walks a range of a larger
+   /// mapped document in place; the document start is only used to report
+   /// line numbers.
+   class ObjCursor {
+   public:
+      ObjCursor(char const* file_begin, char const* begin, char const* end)
+            : file_begin_{file_begin}, cur_{begin}, end_{end} {}
+
+      bool AtEnd() const { return cur_ == end_; }
+      char const* position() const { return cur_; }
+
+      /// Identifies the record at the start of the current line and consumes
+      /// its keyword. The caller must call NextLine() after reading it.
+      ObjRecord NextRecord() {
+         SkipSpaces();
+         if (cur_ == end_) return ObjRecord::kOther;
+         char const c0 = *cur_;
+         char const c1 = cur_ + 1 != end_ ? cur_[1] : '\0';
+         if (c0 == 'v' && IsSpace(c1)) {
+            cur_ += 1;
+            return ObjRecord::kPosition;
+         }
+         if (c0 == 'v' && c1 == 't') {
+            cur_ += 2;
+            return ObjRecord::kTexcoord;
+         }
+         if (c0 == 'v' && c1 == 'n') {
+            cur_ += 2;
+            return ObjRecord::kNormal;
+         }
+         if (c0 == 'f' && IsSpace(c1)) {
+            cur_ += 1;
+            return ObjRecord::kFace;
+         }
+         if (ConsumeKeyword("mtllib")) return ObjRecord::kMaterialLibrary;
+         return ObjRecord::kOther;
+      }
+
+      void NextLine() {
+         auto const* nl = static_cast<char const*>(std::memchr(cur_, '\n', end_ - cur_));
+         cur_ = nl ? nl + 1 : end_;
+      }
+
+      void SkipSpaces() {
+         while (cur_ != end_ && IsSpace(*cur_)) ++cur_;
+      }
+
+      bool AtLineEnd() const {
+         return cur_ == end_ || *cur_ == '\n' || *cur_ == '\r' || *cur_ == '#';
+      }
+
+      bool Consume(char c) {
+         if (cur_ == end_ || *cur_ != c) return false;
+         ++cur_;
+         return true;
+      }
+
+      bool Peek(char c) const { return cur_ != end_ && *cur_ == c; }
+
+      float ReadFloat() {
+         SkipSpaces();
+         // Explicit plus signs are outside the from_chars grammar, but some
+         // exporters emit them
+         if (cur_ != end_ && *cur_ == '+') ++cur_;
+         float value;
+         char const* next = ScanFloat(cur_, end_, value);
+         if (!next) Fail("expected a number");
+         cur_ = next;
+         return value;
+      }
+
+      glm::vec3 ReadVec3() {
+         float const x = ReadFloat();
+         float const y = ReadFloat();
+         float const z = ReadFloat();
+         return {x, y, z};
+      }
+
+      glm::vec2 ReadTexcoord() {
+         float const u = ReadFloat();
+         // The v coordinate is optional for 1D textures
+         SkipSpaces();
+         float const v = AtLineEnd() ? 0.0f : ReadFloat();
+         return {u, v};
+      }
+
+      /// Reads one blank-separated name, as in the file list of `mtllib`.
+      std::string_view ReadName() {
+         SkipSpaces();
+         char const* const begin = cur_;
+         while (!AtLineEnd() && !IsSpace(*cur_)) ++cur_;
+         if (cur_ == begin) Fail("expected a name");
+         return {begin, static_cast<std::size_t>(cur_ - begin)};
+      }
+
+      /// Reads a face index as written: one-based, or negative for indices
+      /// relative to the end of the attribute list.
+      std::int64_t ReadRawIndex() {
+         std::int64_t value;
+         char const* next = ScanInt(cur_, end_, value);
+         if (!next || value == 0) Fail("expected a non-zero index");
+         cur_ = next;
+         return value;
+      }
+
+      [[noreturn]] void Fail(char const* what) const {
+         auto const line = std::count(file_begin_, cur_, '\n') + 1;
+         throw std::runtime_error("OBJ parse error at line " + std::to_string(line) + ": " +
+                                  what);
+      }
+
+   private:
+      static bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+      bool ConsumeKeyword(std::string_view keyword) {
+         std::size_t const n = keyword.size();
+         if (static_cast<std::size_t>(end_ - cur_) <= n || !IsSpace(cur_[n]) ||
+             std::string_view{cur_, n} != keyword)
+            return false;
+         cur_ += n;
+         return true;
+      }
+
+      char const* file_begin_;
+      char const* cur_;
+      char const* end_;
+   };
+
+} // namespace vertexsim
@@ -0,0 +1,263 @@
+#include "obj_loader.h"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "mapped_file.h"
+#include "obj_cursor.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      // Chunks smaller than this are not worth a thread of their own
+      constexpr std::size_t kMinChunkBytes = 1 << 20;
+
+      enum RelativeMask : std::uint8_t { kRelV = 1, kRelVt = 2, kRelVn = 4 };
+
+      /// Corner whose components (per RelativeMask) still need the attribute
+      /// base offset of their chunk added after the merge.
+      struct RelativeRef {
+         std::size_t corner;
+         std::uint8_t mask;
+      };
+
+      class ObjParser {
+      public:
+         ObjParser(std::string_view text, ObjMesh& mesh)
+               : cursor_{text.data(), text.data(), text.data() + text.size()}, mesh_{mesh} {}
+
+         /// Parses one chunk of a larger document. Negative indices cannot be
+         /// resolved without knowing how many attributes preceding chunks
+         /// defined, so they are made chunk-relative and listed in `relative`.
+         ObjParser(char const* file_begin, std::string_view chunk, ObjMesh& mesh,
+                   std::vector<RelativeRef>& relative)
+               : cursor_{file_begin, chunk.data(), chunk.data() + chunk.size()},
+                 mesh_{mesh},
+                 relative_{&relative} {}
+
+         void Parse() {
+            while (!cursor_.AtEnd()) {
+               switch (cursor_.NextRecord()) {
+                  case ObjRecord::kPosition:
+                     mesh_.positions.push_back(cursor_.ReadVec3());
+                     break;
+                  case ObjRecord::kNormal:
+                     mesh_.normals.push_back(cursor_.ReadVec3());
+                     break;
+                  case ObjRecord::kTexcoord:
+                     mesh_.texcoords.push_back(cursor_.ReadTexcoord());
+                     break;
+                  case ObjRecord::kFace:
+                     ParseFace();
+                     break;
+                  // LoadObjMaterials() reads the libraries on its own
+                  case ObjRecord::kMaterialLibrary:
+                  case ObjRecord::kOther:
+                     break;
+               }
+               cursor_.NextLine();
+            }
+         }
+
+      private:
+         std::int32_t ParseIndex(std::size_t count, std::uint8_t rel_bit) {
+            std::int64_t const value = cursor_.ReadRawIndex();
+            if (value > 0) {
+               if (value > INT32_MAX) cursor_.Fail("index out of range");
+               return static_cast<std::int32_t>(value - 1);
+            }
+            // Negative indices are relative to the attributes defined so far
+            std::int64_t const index = static_cast<std::int64_t>(count) + value;
+            if (relative_) {
+               if (index < INT32_MIN) cursor_.Fail("index out of range");
+               rel_mask_ |= rel_bit;
+            } else if (index < 0) {
+               cursor_.Fail("index out of range");
+            }
+            return static_cast<std::int32_t>(index);
+         }
+
+         ObjCorner ParseCorner() {
+            ObjCorner corner;
+            rel_mask_ = 0;
+            corner.v = ParseIndex(mesh_.positions.size(), kRelV);
+            if (cursor_.Consume('/')) {
+               if (!cursor_.Peek('/') && !cursor_.AtLineEnd())
+                  corner.vt = ParseIndex(mesh_.texcoords.size(), kRelVt);
+               if (cursor_.Consume('/')) corner.vn = ParseIndex(mesh_.normals.size(), kRelVn);
+            }
+            return corner;
+         }
+
+         void PushCorner(ObjCorner const& corner, std::uint8_t mask) {
+            if (mask) relative_->push_back({mesh_.corners.size(), mask});
+            mesh_.corners.push_back(corner);
+         }
+
+         void ParseFace() {
+            ObjCorner first, prev;
+            std::uint8_t first_mask = 0, prev_mask = 0;
+            int count = 0;
+            for (cursor_.SkipSpaces(); !cursor_.AtLineEnd(); cursor_.SkipSpaces(), ++count) {
+               ObjCorner const corner = ParseCorner();
+               if (count >= 2) {
+                  PushCorner(first, first_mask);
+                  PushCorner(prev, prev_mask);
+                  PushCorner(corner, rel_mask_);
+               }
+               if (count == 0) {
+                  first = corner;
+                  first_mask = rel_mask_;
+               }
+               prev = corner;
+               prev_mask = rel_mask_;
+            }
+            if (count < 3) cursor_.Fail("face has fewer than 3 vertices");
+         }
+
+         ObjCursor cursor_;
+         ObjMesh& mesh_;
+         std::vector<RelativeRef>* relative_ = nullptr;
+         std::uint8_t rel_mask_ = 0;
+      };
+
+      void ValidateIndices(ObjMesh const& mesh) {
+         for (ObjCorner const& c : mesh.corners) {
+            auto const in_range = [](std::int32_t index, std::size_t size) {
+               return index >= 0 && static_cast<std::size_t>(index) < size;
+            };
+            if (!in_range(c.v, mesh.positions.size()) ||
+                (c.vt != -1 && !in_range(c.vt, mesh.texcoords.size())) ||
+                (c.vn != -1 && !in_range(c.vn, mesh.normals.size())))
+               throw std::runtime_error("OBJ face references an undefined vertex attribute");
+         }
+      }
+
+      /// Splits `text` into at most `count` pieces that each end on a newline.
+      std::vector<std::string_view> SplitLines(std::string_view text, unsigned count) {
+         std::vector<std::string_view> chunks;
+         std::size_t begin = 0;
+         for (unsigned i = 1; i <= count && begin < text.size(); ++i) {
+            std::size_t end = text.size() * i / count;
+            if (end < begin) end = begin;
+            end = i == count ? text.size() : text.find('\n', end);
+            end = end == std::string_view::npos ? text.size() : end + 1;
+            chunks.push_back(text.substr(begin, end - begin));
+            begin = end;
+         }
+         return chunks;
+      }
+
+      struct Chunk {
+         ObjMesh mesh;
+         std::vector<RelativeRef> relative;
+         std::exception_ptr error;
+         // Attribute counts of all preceding chunks
+         std::size_t base_v = 0, base_vt = 0, base_vn = 0, base_corner = 0;
+      };
+
+      template <typename T>
+      void CopyInto(std::vector<T>& dst, std::size_t offset, std::vector<T> const& src) {
+         std::copy(src.begin(), src.end(), dst.begin() + offset);
+      }
+
+      /// Runs `fn(i)` for every chunk index on its own thread and rethrows the
+      /// error of the earliest failing chunk, so failures are deterministic.
+      template <typename Fn>
+      void ForEachChunk(std::vector<Chunk>& chunks, Fn&& fn) {
+         {
+            std::vector<std::jthread> workers;
+            workers.reserve(chunks.size());
+            for (std::size_t i = 0; i < chunks.size(); ++i) {
+               workers.emplace_back([&chunks, &fn, i] {
+                  try {
+                     fn(i);
+                  } catch (...) {
+                     chunks[i].error = std::current_exception();
+                  }
+               });
+            }
+         }
+         for (Chunk const& chunk : chunks)
+            if (chunk.error) std::rethrow_exception(chunk.error);
+      }
+
+      ObjMesh ParseObjParallel(std::string_view text, unsigned threads) {
+         auto const pieces = SplitLines(text, threads);
+         std::vector<Chunk> chunks(pieces.size());
+         ForEachChunk(chunks, [&](std::size_t i) {
+            ObjParser{text.data(), pieces[i], chunks[i].mesh, chunks[i].relative}.Parse();
+         });
+
+         // Exclusive prefix sum over the per-chunk attribute counts
+         ObjMesh mesh;
+         std::size_t v = 0, vt = 0, vn = 0, corners = 0;
+         for (Chunk& chunk : chunks) {
+            chunk.base_v = v;
+            chunk.base_vt = vt;
+            chunk.base_vn = vn;
+            chunk.base_corner = corners;
+            v += chunk.mesh.positions.size();
+            vt += chunk.mesh.texcoords.size();
+            vn += chunk.mesh.normals.size();
+            corners += chunk.mesh.corners.size();
+         }
+         if (std::max({v, vt, vn}) > static_cast<std::size_t>(INT32_MAX))
+            throw std::runtime_error("OBJ has too many vertex attributes");
+         mesh.positions.resize(v);
+         mesh.texcoords.resize(vt);
+         mesh.normals.resize(vn);
+         mesh.corners.resize(corners);
+
+         // Each chunk owns a disjoint slice of the output, so the merge itself
+         // runs in parallel and produces exactly the single-threaded result
+         ForEachChunk(chunks, [&](std::size_t i) {
+            Chunk& chunk = chunks[i];
+            CopyInto(mesh.positions, chunk.base_v, chunk.mesh.positions);
+            CopyInto(mesh.texcoords, chunk.base_vt, chunk.mesh.texcoords);
+            CopyInto(mesh.normals, chunk.base_vn, chunk.mesh.normals);
+            for (RelativeRef const& ref : chunk.relative) {
+               ObjCorner& c = chunk.mesh.corners[ref.corner];
+               if (ref.mask & kRelV) c.v += static_cast<std::int32_t>(chunk.base_v);
+               if (ref.mask & kRelVt) c.vt += static_cast<std::int32_t>(chunk.base_vt);
+               if (ref.mask & kRelVn) c.vn += static_cast<std::int32_t>(chunk.base_vn);
+               // Past this point a vt or vn of -1 reads as absent, so given
+               // ones that resolved before the first attribute fail here
+               if (((ref.mask & kRelVt) && c.vt < 0) || ((ref.mask & kRelVn) && c.vn < 0))
+                  throw std::runtime_error("OBJ face references an undefined vertex attribute");
+            }
+            CopyInto(mesh.corners, chunk.base_corner, chunk.mesh.corners);
+            chunk.mesh = {};
+         });
+         return mesh;
+      }
+
+   } // namespace
+
+   ObjMesh ParseObj(std::string_view text, unsigned threads) {
+      if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+      threads = static_cast<unsigned>(
+            std::clamp<std::size_t>(text.size() / kMinChunkBytes, 1, threads));
+      ObjMesh mesh;
+      if (threads == 1)
+         ObjParser{text, mesh}.Parse();
+      else
+         mesh = ParseObjParallel(text, threads);
+      ValidateIndices(mesh);
+      return mesh;
+   }
+
+   ObjMesh LoadObj(std::filesystem::path const& path, unsigned threads) {
+      MappedFile file{path};
+      try {
+         return ParseObj(file.view(), threads);
+      } catch (std::runtime_error const& e) {
+         throw std::runtime_error(path.string() + ": " + e.what());
+      }
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <string_view>
+#include <vector>
+
+namespace vertexsim {
+
+   /// One face corner of an OBJ `f` record. Indices are zero-based into the
+   /// matching ObjMesh attribute array, or -1 when the attribute is absent.
+   struct ObjCorner {
+      std::int32_t v = -1;
+      std::int32_t vt = -1;
+      std::int32_t vn = -1;
+   };
+
+   struct ObjMesh {
+      std::vector<glm::vec3> positions;
+      std::vector<glm::vec3> normals;
+      std::vector<glm::vec2> texcoords;
+      // Faces are fan-triangulated, so every 3 corners form one triangle
+      std::vector<ObjCorner> corners;
+   };
+
+   /// Parses an OBJ document held entirely in memory. Records are tokenized in
+   /// place; nothing is copied out of `text` except the parsed values.
+   ///
+   /// With `threads` > 1 the text is split at line boundaries and the chunks
+   /// are parsed concurrently, then merged. The result is identical to a
+   /// single-threaded parse. Zero picks the hardware concurrency.
+   ObjMesh ParseObj(std::string_view text, unsigned threads = 1);
+
+   /// Memory-maps the file at `path` and parses it with ParseObj().
+   ObjMesh LoadObj(std::filesystem::path const& path, unsigned threads = 1);
+
+} // namespace vertexsim
@@ -0,0 +1,310 @@
+#include "obj_stream.h"
+
+#include <algorithm>
+#include <exception>
+#include <list>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "mapped_file.h"
+#include "obj_cursor.h"
+#include "welder.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      constexpr std::size_t kPageRecords = 1 << 16;
+
+      template <typename T>
+      T ReadAttribute(ObjCursor& cursor);
+
+      template <>
+      glm::vec3 ReadAttribute<glm::vec3>(ObjCursor& cursor) {
+         return cursor.ReadVec3();
+      }
+
+      template <>
+      glm::vec2 ReadAttribute<glm::vec2>(ObjCursor& cursor) {
+         return cursor.ReadTexcoord();
+      }
+
+      /// One kind of OBJ attribute, held as fixed-size pages of parsed records.
+      /// Only the most recently used pages stay resident; the others are
+      /// dropped and parsed again from the mapping on their next use. The
+      /// page being appended to is always resident.
+      template <typename T>
+      class AttributeStore {
+      public:
+         AttributeStore(ObjRecord kind, char const* file_begin, char const* file_end,
+                        std::size_t max_resident, ObjStreamStats& stats)
+               : kind_{kind},
+                 file_begin_{file_begin},
+                 file_end_{file_end},
+                 max_resident_{std::max<std::size_t>(max_resident, 2)},
+                 stats_{stats} {}
+
+         std::size_t size() const { return size_; }
+         std::size_t resident_bytes() const { return pages_.size() * kPageRecords * sizeof(T); }
+
+         /// Appends the record whose line starts at `line`.
+         void Append(T const& value, char const* line) {
+            std::size_t const page = size_ / kPageRecords;
+            if (size_ % kPageRecords == 0) {
+               page_lines_.push_back(line);
+               Insert(page).reserve(kPageRecords);
+            }
+            pages_[page].records.push_back(value);
+            ++size_;
+         }
+
+         T const& operator[](std::size_t index) {
+            std::size_t const page = index / kPageRecords;
+            auto it = pages_.find(page);
+            if (it == pages_.end()) {
+               Reload(page);
+               it = pages_.find(page);
+            } else {
+               lru_.splice(lru_.begin(), lru_, it->second.lru);
+            }
+            return it->second.records[index % kPageRecords];
+         }
+
+      private:
+         struct Page {
+            std::vector<T> records;
+            typename std::list<std::size_t>::iterator lru;
+         };
+
+         std::vector<T>& Insert(std::size_t page) {
+            if (pages_.size() >= max_resident_) Evict();
+            lru_.push_front(page);
+            Page& entry = pages_[page];
+            entry.lru = lru_.begin();
+            return entry.records;
+         }
+
+         void Evict() {
+            std::size_t const tail = page_lines_.size() - 1;
+            for (auto it = lru_.rbegin(); it != lru_.rend(); ++it) {
+               if (*it == tail) continue;
+               pages_.erase(*it);
+               lru_.erase(std::next(it).base());
+               return;
+            }
+         }
+
+         /// Parses the page again, starting at the line of its first record.
+         void Reload(std::size_t page) {
+            ++stats_.page_reloads;
+            std::size_t const count = std::min(kPageRecords, size_ - page * kPageRecords);
+            std::vector<T>& records = Insert(page);
+            records.reserve(count);
+            ObjCursor cursor{file_begin_, page_lines_[page], file_end_};
+            while (records.size() < count) {
+               if (cursor.NextRecord() == kind_) records.push_back(ReadAttribute<T>(cursor));
+               cursor.NextLine();
+            }
+         }
+
+         ObjRecord const kind_;
+         char const* const file_begin_;
+         char const* const file_end_;
+         std::size_t const max_resident_;
+         ObjStreamStats& stats_;
+         std::size_t size_ = 0;
+         // Line holding the first record of every page
+         std::vector<char const*> page_lines_;
+         std::unordered_map<std::size_t, Page> pages_;
+         // Resident pages, most recently used first
+         std::list<std::size_t> lru_;
+      };
+
+      /// Parses the document front to back and pushes a batch to `queue`
+      /// whenever a batch limit is reached.
+      class ObjStreamParser {
+      public:
+         ObjStreamParser(std::string_view text, ObjStreamOptions const& options,
+                         BoundedQueue<IndexedMesh>& queue, ObjStreamStats& stats)
+               : cursor_{text.data(), text.data(), text.data() + text.size()},
+                 options_{options},
+                 queue_{queue},
+                 stats_{stats},
+                 positions_{ObjRecord::kPosition, text.data(), text.data() + text.size(),
+                            options.resident_attribute_pages, stats},
+                 normals_{ObjRecord::kNormal, text.data(), text.data() + text.size(),
+                          options.resident_attribute_pages, stats},
+                 texcoords_{ObjRecord::kTexcoord, text.data(), text.data() + text.size(),
+                            options.resident_attribute_pages, stats},
+                 welder_{options.max_batch_vertices} {
+            if (options.max_batch_vertices < 3 || options.max_batch_triangles < 1)
+               throw std::invalid_argument("OBJ stream batches must hold at least one triangle");
+         }
+
+         /// Returns false if the consumer stopped early.
+         bool Parse() {
+            while (!cursor_.AtEnd()) {
+               char const* const line = cursor_.position();
+               switch (cursor_.NextRecord()) {
+                  case ObjRecord::kPosition:
+                     positions_.Append(cursor_.ReadVec3(), line);
+                     break;
+                  case ObjRecord::kNormal:
+                     normals_.Append(cursor_.ReadVec3(), line);
+                     break;
+                  case ObjRecord::kTexcoord:
+                     texcoords_.Append(cursor_.ReadTexcoord(), line);
+                     break;
+                  case ObjRecord::kFace:
+                     if (!ParseFace()) return false;
+                     break;
+                  // Batches carry geometry only
+                  case ObjRecord::kMaterialLibrary:
+                  case ObjRecord::kOther:
+                     break;
+               }
+               cursor_.NextLine();
+               UpdatePeak();
+            }
+            return indices_.empty() || Flush();
+         }
+
+      private:
+         std::int32_t ParseIndex(std::size_t count) {
+            std::int64_t const value = cursor_.ReadRawIndex();
+            std::int64_t const index =
+                  value > 0 ? value - 1 : static_cast<std::int64_t>(count) + value;
+            if (index < 0 || index > INT32_MAX) cursor_.Fail("index out of range");
+            // Pages are only parsed once, front to back, so attributes must
+            // be defined before the faces that use them
+            if (static_cast<std::size_t>(index) >= count)
+               cursor_.Fail("face references an attribute defined after it");
+            return static_cast<std::int32_t>(index);
+         }
+
+         ObjCorner ParseCorner() {
+            ObjCorner corner;
+            corner.v = ParseIndex(positions_.size());
+            if (cursor_.Consume('/')) {
+               if (!cursor_.Peek('/') && !cursor_.AtLineEnd())
+                  corner.vt = ParseIndex(texcoords_.size());
+               if (cursor_.Consume('/')) corner.vn = ParseIndex(normals_.size());
+            }
+            return corner;
+         }
+
+         bool ParseFace() {
+            ObjCorner first, prev;
+            int count = 0;
+            for (cursor_.SkipSpaces(); !cursor_.AtLineEnd(); cursor_.SkipSpaces(), ++count) {
+               ObjCorner const corner = ParseCorner();
+               if (count >= 2 && !AddTriangle(first, prev, corner)) return false;
+               if (count == 0) first = corner;
+               prev = corner;
+            }
+            if (count < 3) cursor_.Fail("face has fewer than 3 vertices");
+            return true;
+         }
+
+         bool AddTriangle(ObjCorner const& a, ObjCorner const& b, ObjCorner const& c) {
+            if (welder_.vertices().size() + 3 > options_.max_batch_vertices ||
+                indices_.size() / 3 >= options_.max_batch_triangles) {
+               if (!Flush()) return false;
+            }
+            for (ObjCorner const& corner : {a, b, c}) {
+               std::size_t const before = welder_.vertices().size();
+               std::uint32_t const vertex = welder_.Add(corner);
+               if (vertex == before) AddVertex(corner);
+               indices_.push_back(vertex);
+            }
+            return true;
+         }
+
+         /// Copies the attributes of a newly welded vertex into the batch, so
+         /// the batch does not depend on which pages stay resident.
+         void AddVertex(ObjCorner const& corner) {
+            auto const local = static_cast<std::int32_t>(local_.size());
+            local_.push_back({local, corner.vt >= 0 ? local : -1, corner.vn >= 0 ? local : -1});
+            batch_positions_.push_back(positions_[corner.v]);
+            batch_normals_.push_back(corner.vn >= 0 ? normals_[corner.vn] : glm::vec3{});
+            batch_texcoords_.push_back(corner.vt >= 0 ? texcoords_[corner.vt] : glm::vec2{});
+         }
+
+         bool Flush() {
+            // Batches carry an attribute once the file has defined any, so
+            // all batches after that point share one layout
+            auto const normals = normals_.size() ? std::span{batch_normals_}
+                                                 : std::span<glm::vec3 const>{};
+            auto const texcoords = texcoords_.size() ? std::span{batch_texcoords_}
+                                                     : std::span<glm::vec2 const>{};
+            IndexedMesh batch =
+                  PackWeldedMesh(local_, indices_, batch_positions_, normals, texcoords);
+            ++stats_.batches;
+            stats_.triangles += indices_.size() / 3;
+            stats_.vertices += local_.size();
+
+            welder_.Clear();
+            local_.clear();
+            indices_.clear();
+            batch_positions_.clear();
+            batch_normals_.clear();
+            batch_texcoords_.clear();
+            return queue_.Push(std::move(batch));
+         }
+
+         void UpdatePeak() {
+            std::size_t const bytes = positions_.resident_bytes() + normals_.resident_bytes() +
+                                      texcoords_.resident_bytes();
+            stats_.peak_attribute_bytes = std::max(stats_.peak_attribute_bytes, bytes);
+         }
+
+         ObjCursor cursor_;
+         ObjStreamOptions const& options_;
+         BoundedQueue<IndexedMesh>& queue_;
+         ObjStreamStats& stats_;
+         AttributeStore<glm::vec3> positions_;
+         AttributeStore<glm::vec3> normals_;
+         AttributeStore<glm::vec2> texcoords_;
+
+         // Batch under construction
+         VertexWelder welder_;
+         std::vector<ObjCorner> local_;
+         std::vector<std::uint32_t> indices_;
+         std::vector<glm::vec3> batch_positions_;
+         std::vector<glm::vec3> batch_normals_;
+         std::vector<glm::vec2> batch_texcoords_;
+      };
+
+   } // namespace
+
+   ObjStreamStats StreamObj(std::filesystem::path const& path, ObjStreamOptions const& options,
+                            ObjBatchConsumer const& consumer) {
+      MappedFile const file{path};
+      BoundedQueue<IndexedMesh> queue{std::max<std::size_t>(options.max_queued_batches, 1)};
+      ObjStreamStats stats;
+      std::exception_ptr error;
+      {
+         std::jthread producer{[&] {
+            try {
+               ObjStreamParser{file.view(), options, queue, stats}.Parse();
+            } catch (...) {
+               error = std::current_exception();
+            }
+            queue.Close();
+         }};
+         try {
+            while (auto batch = queue.Pop()) consumer(std::move(*batch));
+         } catch (...) {
+            // Unblocks the producer so it can be joined
+            queue.Close();
+            throw;
+         }
+      }
+      if (error) std::rethrow_exception(error);
+      return stats;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+
+#include "indexed_mesh.h"
+
+namespace vertexsim {
+
+   struct ObjStreamOptions {
+      // Batches stay below the 16-bit primitive restart index
+      std::uint32_t max_batch_vertices = 0xFFFE;
+      std::uint32_t max_batch_triangles = 1 << 16;
+      // Finished batches waiting for the consumer; the parser stalls beyond this
+      std::size_t max_queued_batches = 4;
+      // Parsed attribute pages kept in memory per attribute kind
+      std::size_t resident_attribute_pages = 64;
+   };
+
+   struct ObjStreamStats {
+      std::uint64_t batches = 0;
+      std::uint64_t triangles = 0;
+      // Sum of the per-batch vertex counts; vertices shared across batches
+      // are counted once per batch
+      std::uint64_t vertices = 0;
+      // Attribute pages that had to be parsed again after being evicted
+      std::uint64_t page_reloads = 0;
+      // High-water mark of parsed attribute data held in memory
+      std::size_t peak_attribute_bytes = 0;
+   };
+
+   /// Receives one self-contained batch: welded vertices plus an index buffer
+   /// that only references them.
+   using ObjBatchConsumer = std::function<void(IndexedMesh batch)>;
+
+   /// Streams the OBJ at `path` as bounded-size batches, for meshes that do not
+   /// fit in memory. A background thread parses the mapped file front to back
+   /// while `consumer` runs on the calling thread, so work on one batch
+   /// overlaps with parsing of the next.
+   ///
+   /// Memory use is bounded by the options rather than by the file: parsed
+   /// attributes live in fixed-size pages, and an evicted page is re-parsed
+   /// from the mapping when a later face references it again. Faces must not
+   /// reference attributes that are defined after them.
+   ObjStreamStats StreamObj(std::filesystem::path const& path, ObjStreamOptions const& options,
+                            ObjBatchConsumer const& consumer);
+
+} // namespace vertexsim
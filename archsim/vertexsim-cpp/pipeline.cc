@@ -0,0 +1,153 @@
+#include "pipeline.h"
+
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "hash.h"
+#include "mapped_file.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      constexpr std::array<char, 8> kPsoMagic = {'V', 'S', 'P', 'S', 'O', '\0', '\0', '\0'};
+      constexpr std::uint32_t kPsoVersion = 3;
+
+      struct PsoHeader {
+         std::array<char, 8> magic;
+         std::uint32_t version;
+         // Guards against layout changes that forgot to bump the version
+         std::uint32_t record_size;
+         std::uint64_t count;
+         std::uint64_t records_hash;
+      };
+      static_assert(std::endian::native == std::endian::little,
+                    "Pipeline cache files are little-endian and read without conversion");
+
+      constexpr std::uint32_t kPositionStreams = 0b111;
+      constexpr std::uint32_t kNormalStreams = 0b111000;
+
+      void Require(bool condition, char const* what) {
+         if (!condition) throw std::invalid_argument(std::string{"Invalid pipeline: "} + what);
+      }
+
+   } // namespace
+
+   std::uint64_t PipelineKey(PipelineDesc const& desc) {
+      return Hash64(std::as_bytes(std::span{&desc, 1}));
+   }
+
+   Pipeline CompilePipeline(PipelineDesc const& desc) {
+      auto const state = [&](RenderState s) { return desc[s]; };
+      Require(desc.vertex_streams < (1u << kMaxVertexBuffers), "unknown vertex stream");
+      Require((desc.vertex_streams & kPositionStreams) == kPositionStreams,
+              "positions are not fetched");
+      Require(desc.shader <= VertexShader::kTransformLit, "unknown shader");
+      Require(desc.shader != VertexShader::kTransformLit ||
+                    (desc.vertex_streams & kNormalStreams) == kNormalStreams,
+              "lighting needs normals");
+      Require(state(RenderState::kTopology) <=
+                    static_cast<std::uint32_t>(PrimitiveTopology::kTriangleStripWithAdjacency),
+              "unknown topology");
+      Require(state(RenderState::kCullMode) <= static_cast<std::uint32_t>(CullMode::kBack),
+              "unknown cull mode");
+      Require(state(RenderState::kFrontFace) <= static_cast<std::uint32_t>(FrontFace::kClockwise),
+              "unknown front face");
+      Require(state(RenderState::kDepthTestEnable) <= 1 &&
+                    state(RenderState::kDepthWriteEnable) <= 1 &&
+                    state(RenderState::kBlendEnable) <= 1 &&
+                    state(RenderState::kPrimitiveRestartEnable) <= 1,
+              "enables must be 0 or 1");
+      Require(state(RenderState::kDepthCompare) <= static_cast<std::uint32_t>(CompareOp::kAlways),
+              "unknown depth compare");
+      Require(state(RenderState::kColorWriteMask) <= 0xF, "color write mask has more than RGBA");
+      Require(state(RenderState::kProvokingVertex) <=
+                    static_cast<std::uint32_t>(ProvokingVertex::kFirst),
+              "unknown provoking vertex");
+
+      Pipeline pipeline{};
+      pipeline.key = PipelineKey(desc);
+      pipeline.desc = desc;
+      pipeline.topology = static_cast<PrimitiveTopology>(state(RenderState::kTopology));
+      pipeline.provoking_vertex =
+            static_cast<ProvokingVertex>(state(RenderState::kProvokingVertex));
+      if (state(RenderState::kPrimitiveRestartEnable)) pipeline.flags |= kPipelinePrimitiveRestart;
+      return pipeline;
+   }
+
+   PipelineCache::PipelineCache(std::filesystem::path path) : path_{std::move(path)} {
+      std::error_code ec;
+      if (path_.empty() || !std::filesystem::is_regular_file(path_, ec)) return;
+      std::ifstream ifs{path_, std::ios::binary};
+      PsoHeader header;
+      if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+          header.magic != kPsoMagic || header.version != kPsoVersion ||
+          header.record_size != sizeof(Pipeline) ||
+          header.count > std::filesystem::file_size(path_, ec) / sizeof(Pipeline))
+         return;
+      std::vector<Pipeline> pipelines(header.count);
+      // Only a complete, intact file is used
+      if (!ifs.read(reinterpret_cast<char*>(pipelines.data()),
+                    static_cast<std::streamsize>(std::span{pipelines}.size_bytes())) ||
+          Hash64(std::as_bytes(std::span{pipelines})) != header.records_hash)
+         return;
+      for (auto const& pipeline : pipelines) {
+         // Records that no longer compile to themselves are stale or were
+         // edited by hand, and are dropped
+         Pipeline compiled;
+         try {
+            compiled = CompilePipeline(pipeline.desc);
+         } catch (std::invalid_argument const&) {
+            continue;
+         }
+         compiled.key = pipeline.key;
+         if (std::memcmp(&compiled, &pipeline, sizeof(Pipeline)) == 0)
+            entries_.try_emplace(pipeline.key, pipeline, true);
+      }
+   }
+
+   Pipeline const& PipelineCache::Get(PipelineDesc const& desc) {
+      std::lock_guard lock{mutex_};
+      std::uint64_t key = PipelineKey(desc);
+      for (auto it = entries_.find(key); it != entries_.end(); it = entries_.find(++key)) {
+         Entry& entry = it->second;
+         if (entry.pipeline.desc != desc) continue;
+         if (entry.from_disk) {
+            entry.from_disk = false;
+            ++stats_.disk_hits;
+         } else {
+            ++stats_.memory_hits;
+         }
+         return entry.pipeline;
+      }
+      Pipeline pipeline = CompilePipeline(desc);
+      pipeline.key = key;
+      ++stats_.compiles;
+      dirty_ = true;
+      return entries_.try_emplace(key, pipeline, false).first->second.pipeline;
+   }
+
+   void PipelineCache::Save() {
+      std::lock_guard lock{mutex_};
+      if (path_.empty() || !dirty_) return;
+      std::vector<Pipeline> pipelines;
+      pipelines.reserve(entries_.size());
+      for (auto const& [key, entry] : entries_) pipelines.push_back(entry.pipeline);
+      PsoHeader const header{kPsoMagic, kPsoVersion, sizeof(Pipeline), pipelines.size(),
+                             Hash64(std::as_bytes(std::span{pipelines}))};
+      ReplaceFile(path_, "pipeline cache",
+                  {std::as_bytes(std::span{&header, 1}), std::as_bytes(std::span{pipelines})});
+      dirty_ = false;
+   }
+
+   PipelineCacheStats PipelineCache::stats() const {
+      std::lock_guard lock{mutex_};
+      return stats_;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+#include "gpu_command.h"
+
+namespace vertexsim {
+
+   /// Vertex programs run by the simulated shader core.
+   enum class VertexShader : std::uint32_t {
+      // Positions are already in clip space
+      kPassthrough,
+      // Positions times the model-view-projection matrix
+      kTransform,
+      // Also transforms normals, for per-vertex lighting
+      kTransformLit,
+   };
+
+   /// Everything a pipeline fixes at creation: vertex layout, shader, raster
+   /// and blend state. Descriptions are hashed byte for byte, so they hold no
+   /// padding and unused fields must stay zero.
+   struct PipelineDesc {
+      // Bit i set when VertexStream i is fetched; strides come with the
+      // vertex buffer bindings
+      std::uint32_t vertex_streams = 0b111;
+      VertexShader shader = VertexShader::kPassthrough;
+      // Raster and blend registers, indexed by RenderState
+      std::array<std::uint32_t, kRenderStateCount> state = {
+            static_cast<std::uint32_t>(PrimitiveTopology::kTriangleList)};
+
+      std::uint32_t& operator[](RenderState s) { return state[static_cast<std::size_t>(s)]; }
+      std::uint32_t operator[](RenderState s) const {
+         return state[static_cast<std::size_t>(s)];
+      }
+
+      bool operator==(PipelineDesc const&) const = default;
+   };
+   static_assert(std::has_unique_object_representations_v<PipelineDesc>);
+
+   inline constexpr std::uint32_t kPipelinePrimitiveRestart = 1 << 0;
+
+   /// A pipeline compiled into the form the simulator runs directly, so
+   /// draws never decode the state registers they depend on. Only what the
+   /// vertex pipeline models is decoded; raster and blend state stays in
+   /// `desc`. Plain data, stored as is in the on-disk cache.
+   struct Pipeline {
+      // Cache key: PipelineKey(desc), probed forward past collisions
+      std::uint64_t key;
+      PipelineDesc desc;
+      PrimitiveTopology topology;
+      ProvokingVertex provoking_vertex;
+      // kPipeline* bits
+      std::uint32_t flags;
+      std::uint32_t reserved;
+   };
+   static_assert(std::has_unique_object_representations_v<Pipeline>);
+
+   std::uint64_t PipelineKey(PipelineDesc const& desc);
+
+   /// Validates `desc` and specializes it. Throws std::invalid_argument for
+   /// invalid descriptions.
+   Pipeline CompilePipeline(PipelineDesc const& desc);
+
+   struct PipelineCacheStats {
+      std::uint64_t memory_hits = 0;
+      std::uint64_t disk_hits = 0;
+      std::uint64_t compiles = 0;
+   };
+
+   /// Compiled pipelines keyed by the hash of their description, like a
+   /// VkPipelineCache. When given a file, the cache starts from its contents
+   /// and Save() writes back what was compiled since, so repeated runs skip
+   /// compilation.
+   class PipelineCache {
+   public:
+      /// A missing, malformed or outdated file leaves the cache empty;
+      /// records that CompilePipeline() would not reproduce are skipped.
+      explicit PipelineCache(std::filesystem::path path = {});
+
+      /// The compiled form of `desc`, compiled at most once. The reference
+      /// stays valid for the cache's lifetime. Thread-safe.
+      Pipeline const& Get(PipelineDesc const& desc);
+
+      /// Replaces the file atomically if anything was compiled since it was
+      /// loaded. Does nothing without a file.
+      void Save();
+
+      PipelineCacheStats stats() const;
+
+   private:
+      struct Entry {
+         Pipeline pipeline;
+         // Loaded from the file and not asked for yet
+         bool from_disk;
+      };
+
+      std::filesystem::path path_;
+      mutable std::mutex mutex_;
+      // Node-based, so entries never move
+      std::unordered_map<std::uint64_t, Entry> entries_;
+      PipelineCacheStats stats_;
+      bool dirty_ = false;
+   };
+
+} // namespace vertexsim
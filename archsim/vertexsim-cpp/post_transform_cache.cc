@@ -0,0 +1,113 @@
+#include "post_transform_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+namespace vertexsim {
+
+   PostTransformCache::PostTransformCache(PostTransformCacheConfig const& config)
+         : config_{config},
+           ways_{config.associativity == 0 ? config.entries : config.associativity},
+           sets_{ways_ == 0 ? 0 : config.entries / ways_},
+           entries_(config.entries) {
+      if (config.entries < 3) throw std::invalid_argument("Vertex cache must hold a triangle");
+      if (ways_ > config.entries || config.entries % ways_ != 0)
+         throw std::invalid_argument("Vertex cache entries must split evenly into sets");
+   }
+
+   template <typename IndexAt>
+   PostTransformCacheStats PostTransformCache::Run(std::uint64_t count, IndexAt&& index_at) {
+      std::fill(entries_.begin(), entries_.end(), Entry{});
+      PostTransformCacheStats stats;
+      // Cycle of the current lookup, and when the shader takes another vertex
+      std::uint64_t cycle = 0;
+      std::uint64_t shader_free = 0;
+      std::uint64_t last_ready = 0;
+      for (std::uint64_t i = 0; i < count; ++i, ++cycle) {
+         // Restart indices take their cycle in the index stream but are no
+         // vertex to look up
+         std::optional<std::uint32_t> const index = index_at(i);
+         if (!index) continue;
+         std::uint32_t const vertex = *index;
+         ++stats.indices;
+         Entry* const set = &entries_[std::size_t{vertex % sets_} * ways_];
+         Entry* const end = set + ways_;
+         Entry* const hit = std::find_if(
+               set, end, [&](Entry const& e) { return e.valid && e.vertex == vertex; });
+         if (hit != end) {
+            ++stats.hits;
+            hit->used = cycle;
+            continue;
+         }
+
+         // Free ways first, then the policy's victim
+         Entry* victim = std::find_if(set, end, [](Entry const& e) { return !e.valid; });
+         if (victim == end) {
+            victim = config_.policy == VertexCachePolicy::kFifo
+                           ? std::min_element(set, end, [](auto const& a, auto const& b) {
+                                return a.inserted < b.inserted;
+                             })
+                           : std::min_element(set, end, [](auto const& a, auto const& b) {
+                                return a.used < b.used;
+                             });
+            if (victim->ready > cycle) {
+               stats.stall_cycles += victim->ready - cycle;
+               cycle = victim->ready;
+            }
+         }
+         std::uint64_t const dispatch = std::max(cycle, shader_free);
+         shader_free = dispatch + config_.cycles_per_vertex;
+         *victim = {vertex, true, cycle, cycle, dispatch + config_.shade_latency};
+         last_ready = std::max(last_ready, victim->ready);
+         ++stats.shaded;
+      }
+      stats.cycles = std::max(cycle, last_ready);
+      return stats;
+   }
+
+   PostTransformCacheStats PostTransformCache::Draw(std::span<std::uint16_t const> indices,
+                                                    std::int32_t vertex_offset) {
+      return Run(indices.size(), [&](std::uint64_t i) {
+         return std::optional{static_cast<std::uint32_t>(indices[i] + vertex_offset)};
+      });
+   }
+
+   PostTransformCacheStats PostTransformCache::Draw(std::span<std::uint32_t const> indices,
+                                                    std::int32_t vertex_offset) {
+      return Run(indices.size(), [&](std::uint64_t i) {
+         return std::optional{indices[i] + static_cast<std::uint32_t>(vertex_offset)};
+      });
+   }
+
+   PostTransformCacheStats PostTransformCache::Draw(DrawCall const& draw) {
+      PostTransformCacheStats stats;
+      if (draw.index_buffer) {
+         // Bound offsets need not be aligned to the index size
+         auto const* data = draw.index_buffer->data.data();
+         auto const offset = static_cast<std::uint32_t>(draw.vertex_offset);
+         bool const restart = draw.primitive_restart();
+         auto const run = [&]<typename Index>(Index) {
+            return Run(draw.count, [&](std::uint64_t i) -> std::optional<std::uint32_t> {
+               Index index;
+               std::memcpy(&index, data + (draw.first + i) * sizeof index, sizeof index);
+               // Restart indices are all ones before the vertex offset
+               if (restart && index == static_cast<Index>(~Index{0})) return std::nullopt;
+               return index + offset;
+            });
+         };
+         stats = draw.index_buffer->format == IndexFormat::kUint16 ? run(std::uint16_t{})
+                                                                   : run(std::uint32_t{});
+      } else {
+         stats = Run(draw.count, [&](std::uint64_t i) {
+            return std::optional{draw.first + static_cast<std::uint32_t>(i)};
+         });
+      }
+      // Every instance starts from an empty cache and behaves the same
+      PostTransformCacheStats total;
+      for (std::uint32_t i = 0; i < draw.instance_count; ++i) total += stats;
+      return total;
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "command_processor.h"
+
+namespace vertexsim {
+
+   enum class VertexCachePolicy {
+      // Replaces the oldest insertion; hits do not refresh an entry
+      kFifo,
+      kLru,
+   };
+
+   struct PostTransformCacheConfig {
+      std::uint32_t entries = 32;
+      // Ways per set; zero makes the cache fully associative
+      std::uint32_t associativity = 0;
+      VertexCachePolicy policy = VertexCachePolicy::kFifo;
+      // From dispatching a vertex to the shader until its result is cached
+      std::uint32_t shade_latency = 32;
+      // Shader throughput, as cycles between vertex dispatches
+      std::uint32_t cycles_per_vertex = 1;
+   };
+
+   struct PostTransformCacheStats {
+      std::uint64_t indices = 0;
+      std::uint64_t hits = 0;
+      // Misses, each of which shades a vertex
+      std::uint64_t shaded = 0;
+      // Cycles the index stream waited for a victim entry to finish shading
+      std::uint64_t stall_cycles = 0;
+      // From the first lookup until the last shaded vertex is cached
+      std::uint64_t cycles = 0;
+
+      double hit_rate() const { return indices ? static_cast<double>(hits) / indices : 0; }
+
+      PostTransformCacheStats& operator+=(PostTransformCacheStats const& other) {
+         indices += other.indices;
+         hits += other.hits;
+         shaded += other.shaded;
+         stall_cycles += other.stall_cycles;
+         cycles += other.cycles;
+         return *this;
+      }
+   };
+
+   /// Cycle-approximate model of the post-transform vertex cache. The index
+   /// stream looks up one index per cycle. A miss allocates an entry and
+   /// dispatches the vertex to the shader, and the entry stays pending
+   /// until the shaded result returns. A pending entry cannot be evicted, so
+   /// when the victim is still pending the index stream stalls; that is how
+   /// shader latency and throughput limit a draw. The cache starts every
+   /// draw empty, as hardware invalidates it between draws.
+   class PostTransformCache {
+   public:
+      /// Throws std::invalid_argument unless the entries split evenly into
+      /// sets and the cache holds at least a triangle.
+      explicit PostTransformCache(PostTransformCacheConfig const& config = {});
+
+      PostTransformCacheStats Draw(std::span<std::uint16_t const> indices,
+                                   std::int32_t vertex_offset = 0);
+      PostTransformCacheStats Draw(std::span<std::uint32_t const> indices,
+                                   std::int32_t vertex_offset = 0);
+      /// Runs a draw from the front-end. Non-indexed draws never reuse a
+      /// vertex, and each instance shades its vertices again. Primitive
+      /// restart indices are skipped and do not count as indices.
+      PostTransformCacheStats Draw(DrawCall const& draw);
+
+      PostTransformCacheConfig const& config() const { return config_; }
+
+   private:
+      struct Entry {
+         std::uint32_t vertex = 0;
+         bool valid = false;
+         std::uint64_t inserted = 0;
+         std::uint64_t used = 0;
+         // Cycle at which the shaded vertex is in the cache
+         std::uint64_t ready = 0;
+      };
+
+      /// Looks up `index_at(i)` for i in [0, count), skipping those that
+      /// return no vertex.
+      template <typename IndexAt>
+      PostTransformCacheStats Run(std::uint64_t count, IndexAt&& index_at);
+
+      PostTransformCacheConfig config_;
+      std::uint32_t ways_;
+      std::uint32_t sets_;
+      std::vector<Entry> entries_;
+   };
+
+} // namespace vertexsim
@@ -0,0 +1,192 @@
+#include "primitive_assembler.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vertexsim {
+
+   namespace {
+
+      std::uint32_t VerticesPerPrimitive(PrimitiveTopology topology) {
+         switch (topology) {
+            case PrimitiveTopology::kPointList:
+               return 1;
+            case PrimitiveTopology::kLineList:
+            case PrimitiveTopology::kLineStrip:
+            case PrimitiveTopology::kLineListWithAdjacency:
+            case PrimitiveTopology::kLineStripWithAdjacency:
+               return 2;
+            default:
+               return 3;
+         }
+      }
+
+      /// Collects primitives into packets for one draw.
+      class PacketBuilder {
+      public:
+         PacketBuilder(PrimitiveTopology topology, ProvokingVertex provoking,
+                       PrimitivePacketHandler const& on_packet, PrimitiveAssemblyStats& stats)
+               : first_{provoking == ProvokingVertex::kFirst}, on_packet_{on_packet},
+                 stats_{stats} {
+            packet_.vertices_per_primitive = VerticesPerPrimitive(topology);
+            packet_.provoking_slot = first_ ? 0 : packet_.vertices_per_primitive - 1;
+         }
+
+         void BeginInstance(std::uint32_t instance) {
+            packet_.instance = instance;
+            packet_.first_primitive = 0;
+            packet_.count = 0;
+         }
+
+         /// Adds a primitive given in specification order, in which its
+         /// provoking vertex is the last for ProvokingVertex::kLast and at
+         /// `first_slot` for ProvokingVertex::kFirst.
+         void Add(std::uint32_t v0, std::uint32_t v1, std::uint32_t v2,
+                  std::uint32_t first_slot = 0) {
+            std::array<std::uint32_t, 3> v{v0, v1, v2};
+            // Rotating keeps the winding
+            if (first_ && first_slot != 0) std::rotate(v.begin(), v.begin() + first_slot, v.end());
+            for (std::uint32_t slot = 0; slot < 3; ++slot)
+               packet_.vertices[slot][packet_.count] = v[slot];
+            if (++packet_.count == kPrimitivePacketSize) Flush();
+         }
+
+         void Flush() {
+            if (packet_.count == 0) return;
+            stats_.primitives += packet_.count;
+            ++stats_.packets;
+            if (on_packet_) on_packet_(packet_);
+            packet_.first_primitive += packet_.count;
+            packet_.count = 0;
+         }
+
+      private:
+         bool first_;
+         PrimitivePacketHandler const& on_packet_;
+         PrimitiveAssemblyStats& stats_;
+         PrimitivePacket packet_;
+      };
+
+      /// Assembles `n` vertices up to a restart or the end of the draw;
+      /// `v(k)` is the k-th of them.
+      template <typename VertexAt>
+      void AssembleRun(PrimitiveTopology topology, std::uint32_t n, VertexAt const& v,
+                       PacketBuilder& out, PrimitiveAssemblyStats& stats) {
+         // Vertices consumed by complete primitives
+         std::uint32_t used = n;
+         switch (topology) {
+            case PrimitiveTopology::kPointList:
+               for (std::uint32_t p = 0; p < n; ++p) out.Add(v(p), 0, 0);
+               break;
+            case PrimitiveTopology::kLineList:
+               used = n / 2 * 2;
+               for (std::uint32_t p = 0; p < n / 2; ++p) out.Add(v(2 * p), v(2 * p + 1), 0);
+               break;
+            case PrimitiveTopology::kLineStrip:
+               if (n < 2) used = 0;
+               for (std::uint32_t p = 0; p + 1 < n; ++p) out.Add(v(p), v(p + 1), 0);
+               break;
+            case PrimitiveTopology::kTriangleList:
+               used = n / 3 * 3;
+               for (std::uint32_t p = 0; p < n / 3; ++p)
+                  out.Add(v(3 * p), v(3 * p + 1), v(3 * p + 2));
+               break;
+            case PrimitiveTopology::kTriangleStrip:
+               // Odd triangles swap their first two vertices to keep the
+               // winding; the first provoking vertex is then in slot 1
+               if (n < 3) used = 0;
+               for (std::uint32_t p = 0; p + 2 < n; ++p) {
+                  if (p % 2 == 0)
+                     out.Add(v(p), v(p + 1), v(p + 2));
+                  else
+                     out.Add(v(p + 1), v(p), v(p + 2), 1);
+               }
+               break;
+            case PrimitiveTopology::kTriangleFan:
+               if (n < 3) used = 0;
+               for (std::uint32_t p = 0; p + 2 < n; ++p) out.Add(v(0), v(p + 1), v(p + 2), 1);
+               break;
+            case PrimitiveTopology::kLineListWithAdjacency:
+               used = n / 4 * 4;
+               for (std::uint32_t p = 0; p < n / 4; ++p) out.Add(v(4 * p + 1), v(4 * p + 2), 0);
+               break;
+            case PrimitiveTopology::kLineStripWithAdjacency:
+               if (n < 4) used = 0;
+               for (std::uint32_t p = 0; p + 3 < n; ++p) out.Add(v(p + 1), v(p + 2), 0);
+               break;
+            case PrimitiveTopology::kTriangleListWithAdjacency:
+               used = n / 6 * 6;
+               for (std::uint32_t p = 0; p < n / 6; ++p)
+                  out.Add(v(6 * p), v(6 * p + 2), v(6 * p + 4));
+               break;
+            case PrimitiveTopology::kTriangleStripWithAdjacency:
+               // Even vertices form the strip, odd ones are adjacent; a
+               // trailing odd vertex belongs to no primitive
+               used = n < 6 ? 0 : n / 2 * 2;
+               for (std::uint32_t p = 0; n >= 6 && p < (n - 4) / 2; ++p) {
+                  if (p % 2 == 0)
+                     out.Add(v(2 * p), v(2 * p + 2), v(2 * p + 4));
+                  else
+                     out.Add(v(2 * p + 2), v(2 * p), v(2 * p + 4), 1);
+               }
+               break;
+         }
+         stats.dropped_vertices += n - used;
+      }
+
+      template <typename Index>
+      Index LoadIndex(std::byte const* indices, std::uint64_t i) {
+         Index index;
+         std::memcpy(&index, indices + i * sizeof(Index), sizeof index);
+         return index;
+      }
+
+      template <typename Index>
+      void AssembleIndexed(DrawCall const& draw, PrimitiveTopology topology, bool restart,
+                           PacketBuilder& out, PrimitiveAssemblyStats& stats) {
+         auto const* indices = draw.index_buffer->data.data() + draw.first * sizeof(Index);
+         auto const offset = static_cast<std::uint32_t>(draw.vertex_offset);
+         constexpr Index kRestart = static_cast<Index>(~Index{0});
+         auto const run = [&](std::uint32_t begin, std::uint32_t end) {
+            AssembleRun(
+                  topology, end - begin,
+                  [&](std::uint32_t k) { return LoadIndex<Index>(indices, begin + k) + offset; },
+                  out, stats);
+         };
+         std::uint32_t begin = 0;
+         if (restart) {
+            for (std::uint32_t i = 0; i < draw.count; ++i) {
+               if (LoadIndex<Index>(indices, i) != kRestart) continue;
+               run(begin, i);
+               ++stats.restarts;
+               begin = i + 1;
+            }
+         }
+         run(begin, draw.count);
+      }
+
+   } // namespace
+
+   PrimitiveAssemblyStats AssemblePrimitives(DrawCall const& draw,
+                                             PrimitivePacketHandler const& on_packet) {
+      PrimitiveTopology const topology = draw.topology();
+      bool const restart = draw.primitive_restart();
+      PrimitiveAssemblyStats stats;
+      PacketBuilder out{topology, draw.provoking_vertex(), on_packet, stats};
+      for (std::uint32_t i = 0; i < draw.instance_count; ++i) {
+         out.BeginInstance(draw.first_instance + i);
+         if (!draw.index_buffer) {
+            AssembleRun(
+                  topology, draw.count, [&](std::uint32_t k) { return draw.first + k; }, out,
+                  stats);
+         } else if (draw.index_buffer->format == IndexFormat::kUint16) {
+            AssembleIndexed<std::uint16_t>(draw, topology, restart, out, stats);
+         } else {
+            AssembleIndexed<std::uint32_t>(draw, topology, restart, out, stats);
+         }
+         out.Flush();
+      }
+      return stats;
+   }
+
+} // namespace vertexsim
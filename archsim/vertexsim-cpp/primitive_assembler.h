@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include "command_processor.h"
+
+namespace vertexsim {
+
+   inline constexpr std::uint32_t kPrimitivePacketSize = 32;
+
+   /// Up to kPrimitivePacketSize assembled primitives of one instance, with
+   /// one array of vertex indices per primitive vertex so later stages can
+   /// work on the whole packet at once. Vertices keep the winding of the
+   /// input but are rotated so every primitive's provoking vertex is in
+   /// `provoking_slot`.
+   struct PrimitivePacket {
+      std::uint32_t instance = 0;
+      // Primitive ID of the first primitive; the rest follow consecutively
+      std::uint32_t first_primitive = 0;
+      std::uint32_t count = 0;
+      // 1, 2 or 3
+      std::uint32_t vertices_per_primitive = 0;
+      std::uint32_t provoking_slot = 0;
+      // vertices[slot][i] is vertex `slot` of primitive i, with the vertex
+      // offset applied; slots past vertices_per_primitive are unused
+      std::array<std::array<std::uint32_t, kPrimitivePacketSize>, 3> vertices;
+   };
+
+   using PrimitivePacketHandler = std::function<void(PrimitivePacket const&)>;
+
+   struct PrimitiveAssemblyStats {
+      std::uint64_t primitives = 0;
+      std::uint64_t packets = 0;
+      std::uint64_t restarts = 0;
+      // Vertices left over from incomplete primitives
+      std::uint64_t dropped_vertices = 0;
+
+      PrimitiveAssemblyStats& operator+=(PrimitiveAssemblyStats const& other) {
+         primitives += other.primitives;
+         packets += other.packets;
+         restarts += other.restarts;
+         dropped_vertices += other.dropped_vertices;
+         return *this;
+      }
+   };
+
+   /// Assembles the vertices of `draw` into primitives following OpenGL:
+   /// vertex order, strip winding and provoking vertex are those of the GL
+   /// specification, so results match stdref-cpp. With primitive restart
+   /// enabled, an index of all ones (0xFFFF or 0xFFFFFFFF, before the vertex
+   /// offset) ends the current strip, fan or list. Primitive IDs count from
+   /// zero per instance and continue across restarts. Packets never span
+   /// instances; a packet is only partly filled at the end of an instance.
+   PrimitiveAssemblyStats AssemblePrimitives(DrawCall const& draw,
+                                             PrimitivePacketHandler const& on_packet);
+
+} // namespace vertexsim
@@ -0,0 +1,218 @@
+#include "quantized_mesh.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace vertexsim {
+
+   namespace {
+
+      constexpr float kUnorm16Max = 65535.0f;
+      constexpr float kSnorm16Max = 32767.0f;
+
+      std::int16_t ToSnorm16(float value) {
+         float const clamped = std::clamp(value, -1.0f, 1.0f);
+         return static_cast<std::int16_t>(std::lround(clamped * kSnorm16Max));
+      }
+
+      /// Maps the unit sphere onto the [-1, 1] square: the upper hemisphere
+      /// projects onto the inner diamond and the lower one folds over the
+      /// corners.
+      std::array<std::int16_t, 2> EncodeOctahedral(glm::vec3 n) {
+         float const l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+         if (l1 == 0.0f) return {0, 0};
+         n /= l1;
+         if (n.z < 0.0f) {
+            float const x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            float const y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+            n.x = x;
+            n.y = y;
+         }
+         return {ToSnorm16(n.x), ToSnorm16(n.y)};
+      }
+
+      glm::vec3 DecodeOctahedral(std::int16_t u, std::int16_t v) {
+         float x = u * (1.0f / kSnorm16Max);
+         float y = v * (1.0f / kSnorm16Max);
+         float const z = 1.0f - std::abs(x) - std::abs(y);
+         float const t = std::max(-z, 0.0f);
+         x += x >= 0.0f ? -t : t;
+         y += y >= 0.0f ? -t : t;
+         float const inv = 1.0f / std::sqrt(x * x + y * y + z * z);
+         return {x * inv, y * inv, z * inv};
+      }
+
+      void DecodeScalar(QuantizedMesh const& mesh, std::uint32_t first, std::uint32_t i,
+                        DecodedStreams const& out) {
+         std::uint32_t const v = first + i;
+         for (int axis = 0; axis < 3; ++axis) {
+            out[static_cast<std::size_t>(VertexStream::kPositionX) + axis][i] =
+                  mesh.position_min[axis] + mesh.positions[axis][v] * mesh.position_scale[axis];
+         }
+         if (mesh.has_normals()) {
+            glm::vec3 const n = DecodeOctahedral(mesh.normals[0][v], mesh.normals[1][v]);
+            out[static_cast<std::size_t>(VertexStream::kNormalX)][i] = n.x;
+            out[static_cast<std::size_t>(VertexStream::kNormalY)][i] = n.y;
+            out[static_cast<std::size_t>(VertexStream::kNormalZ)][i] = n.z;
+         }
+         if (mesh.has_texcoords()) {
+            out[static_cast<std::size_t>(VertexStream::kTexcoordU)][i] =
+                  HalfToFloat(mesh.texcoords[0][v]);
+            out[static_cast<std::size_t>(VertexStream::kTexcoordV)][i] =
+                  HalfToFloat(mesh.texcoords[1][v]);
+         }
+      }
+
+#if defined(__AVX2__)
+      __m128i Load8(void const* p) { return _mm_loadu_si128(static_cast<__m128i const*>(p)); }
+
+      void Store(std::span<float> const& out, std::uint32_t i, __m256 value) {
+         _mm256_storeu_ps(out.data() + i, value);
+      }
+
+      /// Decodes 8 vertices starting at `first + i`.
+      void Decode8(QuantizedMesh const& mesh, std::uint32_t first, std::uint32_t i,
+                   DecodedStreams const& out) {
+         std::uint32_t const v = first + i;
+         for (int axis = 0; axis < 3; ++axis) {
+            __m256 const q =
+                  _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(Load8(&mesh.positions[axis][v])));
+            __m256 const p =
+                  _mm256_add_ps(_mm256_set1_ps(mesh.position_min[axis]),
+                                _mm256_mul_ps(q, _mm256_set1_ps(mesh.position_scale[axis])));
+            Store(out[static_cast<std::size_t>(VertexStream::kPositionX) + axis], i, p);
+         }
+         if (mesh.has_normals()) {
+            __m256 const scale = _mm256_set1_ps(1.0f / kSnorm16Max);
+            __m256 const sign = _mm256_set1_ps(-0.0f);
+            __m256 x = _mm256_mul_ps(
+                  _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(Load8(&mesh.normals[0][v]))), scale);
+            __m256 y = _mm256_mul_ps(
+                  _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(Load8(&mesh.normals[1][v]))), scale);
+            __m256 const z = _mm256_sub_ps(
+                  _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_andnot_ps(sign, x)),
+                  _mm256_andnot_ps(sign, y));
+            __m256 const t = _mm256_max_ps(_mm256_xor_ps(z, sign), _mm256_setzero_ps());
+            // x -= copysign(t, x), likewise for y
+            x = _mm256_sub_ps(x, _mm256_or_ps(t, _mm256_and_ps(x, sign)));
+            y = _mm256_sub_ps(y, _mm256_or_ps(t, _mm256_and_ps(y, sign)));
+            __m256 const len2 = _mm256_add_ps(
+                  _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+            __m256 const inv = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len2));
+            Store(out[static_cast<std::size_t>(VertexStream::kNormalX)], i, _mm256_mul_ps(x, inv));
+            Store(out[static_cast<std::size_t>(VertexStream::kNormalY)], i, _mm256_mul_ps(y, inv));
+            Store(out[static_cast<std::size_t>(VertexStream::kNormalZ)], i, _mm256_mul_ps(z, inv));
+         }
+         if (mesh.has_texcoords()) {
+            Store(out[static_cast<std::size_t>(VertexStream::kTexcoordU)], i,
+                  _mm256_cvtph_ps(Load8(&mesh.texcoords[0][v])));
+            Store(out[static_cast<std::size_t>(VertexStream::kTexcoordV)], i,
+                  _mm256_cvtph_ps(Load8(&mesh.texcoords[1][v])));
+         }
+      }
+#endif
+
+   } // namespace
+
+   std::size_t QuantizedMesh::vertex_bytes() const {
+      std::size_t per_vertex = 3 * sizeof(std::uint16_t);
+      if (has_normals()) per_vertex += 2 * sizeof(std::int16_t);
+      if (has_texcoords()) per_vertex += 2 * sizeof(std::uint16_t);
+      return per_vertex * vertex_count;
+   }
+
+   QuantizedMesh QuantizeVertices(IndexedMesh const& mesh) {
+      QuantizedMesh q;
+      q.vertex_count = mesh.vertex_count();
+      std::size_t const count = q.vertex_count;
+      for (int axis = 0; axis < 3; ++axis) {
+         auto const src = mesh.stream(static_cast<VertexStream>(
+               static_cast<int>(VertexStream::kPositionX) + axis));
+         auto const [lo, hi] = std::minmax_element(src.begin(), src.end());
+         float const min = lo == src.end() ? 0.0f : *lo;
+         float const extent = lo == src.end() ? 0.0f : *hi - *lo;
+         q.position_min[axis] = min;
+         q.position_scale[axis] = extent / kUnorm16Max;
+         auto& dst = q.positions[axis];
+         dst.resize(count);
+         for (std::size_t i = 0; i < count; ++i) {
+            float const unit =
+                  extent > 0.0f ? std::clamp((src[i] - min) / extent, 0.0f, 1.0f) : 0.0f;
+            dst[i] = static_cast<std::uint16_t>(std::lround(unit * kUnorm16Max));
+         }
+      }
+      if (mesh.has_normals()) {
+         auto const nx = mesh.stream(VertexStream::kNormalX);
+         auto const ny = mesh.stream(VertexStream::kNormalY);
+         auto const nz = mesh.stream(VertexStream::kNormalZ);
+         q.normals[0].resize(count);
+         q.normals[1].resize(count);
+         for (std::size_t i = 0; i < count; ++i) {
+            auto const [u, v] = EncodeOctahedral({nx[i], ny[i], nz[i]});
+            q.normals[0][i] = u;
+            q.normals[1][i] = v;
+         }
+      }
+      if (mesh.has_texcoords()) {
+         for (int c = 0; c < 2; ++c) {
+            auto const src =
+                  mesh.stream(c == 0 ? VertexStream::kTexcoordU : VertexStream::kTexcoordV);
+            q.texcoords[c].resize(count);
+            std::transform(src.begin(), src.end(), q.texcoords[c].begin(), FloatToHalf);
+         }
+      }
+      return q;
+   }
+
+   void DecodeVertices(QuantizedMesh const& mesh, std::uint32_t first, std::uint32_t count,
+                       DecodedStreams const& out) {
+      if (std::uint64_t{first} + count > mesh.vertex_count)
+         throw std::out_of_range("Decoded vertex range exceeds the mesh");
+      std::uint32_t i = 0;
+#if defined(__AVX2__)
+      for (; i + 8 <= count; i += 8) Decode8(mesh, first, i, out);
+#endif
+      for (; i < count; ++i) DecodeScalar(mesh, first, i, out);
+   }
+
+   std::uint16_t FloatToHalf(float value) {
+      std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+      std::uint32_t const sign = (bits >> 16) & 0x8000;
+      bits &= 0x7FFFFFFF;
+      // Infinity and NaN keep their class
+      if (bits >= 0x7F800000)
+         return static_cast<std::uint16_t>(sign | 0x7C00 | (bits > 0x7F800000 ? 0x200 : 0));
+      // At or above 65520 rounds to infinity
+      if (bits >= 0x477FF000) return static_cast<std::uint16_t>(sign | 0x7C00);
+      if (bits < 0x38800000) {
+         // Subnormal or zero: adding 0.5 lines the half subnormal step up
+         // with the float ulp, so the FPU does the round-to-nearest-even
+         float const shifted = std::bit_cast<float>(bits) + 0.5f;
+         return static_cast<std::uint16_t>(
+               sign | (std::bit_cast<std::uint32_t>(shifted) - std::bit_cast<std::uint32_t>(0.5f)));
+      }
+      // Rebias the exponent and round to nearest even on the dropped 13 bits
+      std::uint32_t const odd = (bits >> 13) & 1;
+      bits += 0xC8000FFF + odd;
+      return static_cast<std::uint16_t>(sign | (bits >> 13));
+   }
+
+   float HalfToFloat(std::uint16_t half) {
+      std::uint32_t const sign = std::uint32_t{half & 0x8000u} << 16;
+      std::uint32_t const exponent = (half >> 10) & 0x1F;
+      std::uint32_t const mantissa = half & 0x3FF;
+      if (exponent == 0) {
+         float const magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+         return sign ? -magnitude : magnitude;
+      }
+      if (exponent == 0x1F) return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+      return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "indexed_mesh.h"
+
+namespace vertexsim {
+
+   /// Compressed copy of the vertex streams of an IndexedMesh, as a compact
+   /// GPU vertex format would store them:
+   ///  - positions as 16-bit unorm fractions of the mesh bounding box,
+   ///  - normals as octahedral-mapped 16-bit snorm pairs,
+   ///  - texture coordinates as half floats.
+   /// That is 14 bytes per vertex instead of 32. Streams stay SoA so decode
+   /// can process a batch of vertices per instruction.
+   struct QuantizedMesh {
+      std::uint32_t vertex_count = 0;
+      // p = position_min + q * position_scale, per axis
+      glm::vec3 position_min{0.0f};
+      glm::vec3 position_scale{0.0f};
+      std::array<std::vector<std::uint16_t>, 3> positions;
+      // Empty if the mesh has no normals
+      std::array<std::vector<std::int16_t>, 2> normals;
+      // Empty if the mesh has no texture coordinates
+      std::array<std::vector<std::uint16_t>, 2> texcoords;
+
+      bool has_normals() const { return !normals[0].empty(); }
+      bool has_texcoords() const { return !texcoords[0].empty(); }
+      /// Size of the vertex data, for comparison with IndexedMesh streams.
+      std::size_t vertex_bytes() const;
+   };
+
+   QuantizedMesh QuantizeVertices(IndexedMesh const& mesh);
+
+   /// Decoded streams, indexed by VertexStream. Each span must hold the
+   /// decoded vertex count; streams of absent attributes are left alone.
+   using DecodedStreams = std::array<std::span<float>, kVertexStreamCount>;
+
+   /// Decodes vertices [first, first + count) into `out`, eight at a time
+   /// with AVX2 when available.
+   void DecodeVertices(QuantizedMesh const& mesh, std::uint32_t first, std::uint32_t count,
+                       DecodedStreams const& out);
+
+   std::uint16_t FloatToHalf(float value);
+   float HalfToFloat(std::uint16_t half);
+
+} // namespace vertexsim
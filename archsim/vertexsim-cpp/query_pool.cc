@@ -0,0 +1,41 @@
+#include "query_pool.h"
+
+#include <stdexcept>
+
+namespace vertexsim {
+
+   QueryPool::QueryPool(QueryType type, std::uint32_t size)
+         : type_{type}, size_{size}, slots_{std::make_unique<Slot[]>(size)} {
+      if (type > QueryType::kPipelineStatistics) throw std::invalid_argument("Unknown query type");
+   }
+
+   void QueryPool::Invalidate(std::uint32_t query) {
+      slots_[query].available.store(false, std::memory_order_relaxed);
+   }
+
+   void QueryPool::Write(std::uint32_t query, std::span<std::uint64_t const> values) {
+      Slot& slot = slots_[query];
+      for (std::uint32_t i = 0; i < QueryValueCount(type_); ++i)
+         slot.values[i].store(values[i], std::memory_order_relaxed);
+      slot.available.store(true, std::memory_order_release);
+   }
+
+   bool QueryPool::Read(std::uint32_t first, std::uint32_t count,
+                        std::span<std::uint64_t> out) const {
+      std::uint32_t const values = QueryValueCount(type_);
+      if (first > size_ || count > size_ - first || out.size() < std::size_t{count} * values)
+         throw std::out_of_range("Query results are out of range");
+      bool all_available = true;
+      for (std::uint32_t i = 0; i < count; ++i) {
+         Slot const& slot = slots_[first + i];
+         if (!slot.available.load(std::memory_order_acquire)) {
+            all_available = false;
+            continue;
+         }
+         for (std::uint32_t v = 0; v < values; ++v)
+            out[i * values + v] = slot.values[v].load(std::memory_order_relaxed);
+      }
+      return all_available;
+   }
+
+} // namespace vertexsim
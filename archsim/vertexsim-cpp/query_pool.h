@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace vertexsim {
+
+   enum class QueryType : std::uint32_t {
+      // The queue's cycle counter when the query is written
+      kTimestamp,
+      // Input primitives drawn between begin and end, before culling or
+      // clipping. Until the pipeline counts samples this is a conservative
+      // result: non-zero whenever anything may have been visible
+      kOcclusion,
+      // The PipelineStatistics counters accumulated between begin and end
+      kPipelineStatistics,
+   };
+
+   /// Pipeline counters, reported by statistics queries in member order.
+   struct PipelineStatistics {
+      std::uint64_t input_vertices = 0;
+      std::uint64_t input_primitives = 0;
+      // Without post-transform vertex reuse every input vertex is shaded
+      std::uint64_t vertex_shader_invocations = 0;
+   };
+   inline constexpr std::uint32_t kPipelineStatisticsCount = 3;
+
+   /// Number of uint64 values one query of `type` produces.
+   constexpr std::uint32_t QueryValueCount(QueryType type) {
+      return type == QueryType::kPipelineStatistics ? kPipelineStatisticsCount : 1;
+   }
+
+   /// Fixed-size array of queries of one type, like a VkQueryPool. Queues
+   /// write results while the host reads them, so every slot is atomic and
+   /// a result only counts once it is marked available.
+   class QueryPool {
+   public:
+      QueryPool(QueryType type, std::uint32_t size);
+
+      QueryType type() const { return type_; }
+      std::uint32_t size() const { return size_; }
+
+      /// GPU side: marks `query` unavailable while it is being counted.
+      void Invalidate(std::uint32_t query);
+      /// GPU side: stores QueryValueCount(type()) values and makes the
+      /// result available.
+      void Write(std::uint32_t query, std::span<std::uint64_t const> values);
+
+      /// Copies the results of `count` queries starting at `first` into
+      /// `out`, QueryValueCount(type()) values each. Returns false, like
+      /// VK_NOT_READY, if any of them is unavailable; its values are left
+      /// untouched. Throws std::out_of_range for a bad range.
+      bool Read(std::uint32_t first, std::uint32_t count, std::span<std::uint64_t> out) const;
+
+   private:
+      struct Slot {
+         std::array<std::atomic<std::uint64_t>, kPipelineStatisticsCount> values{};
+         std::atomic<bool> available{false};
+      };
+
+      QueryType type_;
+      std::uint32_t size_;
+      std::unique_ptr<Slot[]> slots_;
+   };
+
+} // namespace vertexsim
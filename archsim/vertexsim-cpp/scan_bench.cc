@@ -0,0 +1,131 @@
+// Microbenchmark for the OBJ number scanners against std::from_chars.
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "mapped_file.h"
+#include "number_scan.h"
+
+using namespace vertexsim;
+
+namespace {
+
+   struct ScanResult {
+      std::size_t numbers = 0;
+      // Folds every parsed bit pattern so the two scanners can be compared
+      std::uint64_t checksum = 0;
+   };
+
+   struct Token {
+      std::size_t offset;
+      bool index;
+   };
+
+   bool IsNumberStart(char c) { return (c >= '0' && c <= '9') || c == '-' || c == '.'; }
+
+   /// Finds the start of every number on `v`, `vn`, `vt` and `f` lines so the
+   /// timed loops measure number parsing only, not the line scan around it.
+   std::vector<Token> FindTokens(std::string_view text) {
+      std::vector<Token> tokens;
+      char const* const begin = text.data();
+      char const* const end = begin + text.size();
+      char const* p = begin;
+      while (p != end) {
+         char const* eol = static_cast<char const*>(std::memchr(p, '\n', end - p));
+         eol = eol ? eol : end;
+         bool const face = *p == 'f';
+         if (face || *p == 'v') {
+            for (++p; p != eol; ++p) {
+               if (!IsNumberStart(*p)) continue;
+               tokens.push_back({static_cast<std::size_t>(p - begin), face});
+               while (p + 1 != eol && !(p[1] == ' ' || p[1] == '/' || p[1] == '\r')) ++p;
+            }
+         }
+         p = eol == end ? end : eol + 1;
+      }
+      return tokens;
+   }
+
+   /// Parses every token with `scan_float` for attributes and `scan_int` for
+   /// face indices.
+   template <typename ScanFloatFn, typename ScanIntFn>
+   ScanResult ScanAll(std::string_view text, std::vector<Token> const& tokens,
+                      ScanFloatFn scan_float, ScanIntFn scan_int) {
+      ScanResult result;
+      char const* const end = text.data() + text.size();
+      for (Token const& token : tokens) {
+         char const* const p = text.data() + token.offset;
+         if (token.index) {
+            std::int64_t value = 0;
+            scan_int(p, end, value);
+            result.checksum = result.checksum * 31 + static_cast<std::uint64_t>(value);
+         } else {
+            float value = 0;
+            scan_float(p, end, value);
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            result.checksum = result.checksum * 31 + bits;
+         }
+         ++result.numbers;
+      }
+      return result;
+   }
+
+   template <typename Fn>
+   ScanResult Run(char const* name, std::string_view text, int iterations, Fn&& fn) {
+      ScanResult result;
+      double best = 0;
+      for (int i = 0; i < iterations; ++i) {
+         auto const start = std::chrono::steady_clock::now();
+         result = fn();
+         std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+         double const mbps = static_cast<double>(text.size()) / (1 << 20) / elapsed.count();
+         best = std::max(best, mbps);
+      }
+      std::cout << name << ": " << best << " MB/s\n";
+      return result;
+   }
+
+} // namespace
+
+int main(int argc, char** argv) {
+   std::filesystem::path const path = argc > 1 ? argv[1] : VERTEXSIM_SPONZA_OBJ;
+   int const iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+   try {
+      MappedFile const file{path};
+      std::string_view const text = file.view();
+      auto const tokens = FindTokens(text);
+      std::cout << path.string() << ": " << text.size() / (1 << 20) << " MB, " << tokens.size()
+                << " numbers\n";
+
+      auto const baseline = Run("std::from_chars", text, iterations, [&] {
+         return ScanAll(
+               text, tokens,
+               [](char const* p, char const* end, float& v) {
+                  auto [ptr, ec] = std::from_chars(p, end, v);
+                  return ec == std::errc{} ? ptr : nullptr;
+               },
+               [](char const* p, char const* end, std::int64_t& v) {
+                  auto [ptr, ec] = std::from_chars(p, end, v);
+                  return ec == std::errc{} ? ptr : nullptr;
+               });
+      });
+      auto const simd = Run("vertexsim::ScanFloat/ScanInt", text, iterations,
+                            [&] { return ScanAll(text, tokens, ScanFloat, ScanInt); });
+
+      if (simd.checksum != baseline.checksum || simd.numbers != baseline.numbers) {
+         std::cerr << "Mismatch between scanners!" << std::endl;
+         return 1;
+      }
+   } catch (std::exception const& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+}
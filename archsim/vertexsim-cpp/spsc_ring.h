@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+
+namespace vertexsim {
+
+   /// Lock-free single-producer, single-consumer ring of variable-sized
+   /// records. Each record is contiguous in memory, so the consumer can
+   /// decode it in place. Both sides block with atomic waits rather than
+   /// spinning when the ring is full or empty.
+   ///
+   /// Records are framed by an 8-byte length. A record that would straddle
+   /// the end of the buffer is moved to the start instead, and a wrap marker
+   /// tells the consumer to skip the unused tail.
+   class SpscRing {
+   public:
+      static constexpr std::size_t kAlignment = 8;
+
+      /// `capacity` must be a power of two.
+      explicit SpscRing(std::size_t capacity)
+            : capacity_{capacity}, buffer_{std::make_unique<std::byte[]>(capacity)} {
+         if (!std::has_single_bit(capacity) || capacity < 64)
+            throw std::invalid_argument("SpscRing capacity must be a power of two");
+      }
+
+      SpscRing(SpscRing const&) = delete;
+      SpscRing& operator=(SpscRing const&) = delete;
+
+      /// Largest record that is guaranteed to fit.
+      std::size_t max_record_size() const { return capacity_ / 2 - kFrameSize; }
+
+      /// Producer: returns `size` bytes to fill, blocking while the ring is
+      /// too full. The record becomes visible at EndWrite().
+      std::span<std::byte> BeginWrite(std::size_t size) {
+         if (size > max_record_size()) throw std::length_error("SpscRing record is too large");
+         std::size_t const framed = kFrameSize + AlignUp(size);
+         std::uint64_t pos = head_.load(std::memory_order_relaxed) & ~kClosedBit;
+         std::size_t const offset = pos & (capacity_ - 1);
+         // Records never straddle the end; the skipped tail counts as used
+         std::size_t const skip = offset + framed > capacity_ ? capacity_ - offset : 0;
+         WaitForSpace(pos, skip + framed);
+         if (skip) {
+            WriteFrame(offset, kWrapMarker);
+            pos += skip;
+         }
+         pending_pos_ = pos;
+         pending_size_ = size;
+         WriteFrame(pos & (capacity_ - 1), size);
+         return {buffer_.get() + (pos & (capacity_ - 1)) + kFrameSize, size};
+      }
+
+      void EndWrite() {
+         std::uint64_t const head = pending_pos_ + kFrameSize + AlignUp(pending_size_);
+         head_.store(head, std::memory_order_release);
+         head_.notify_one();
+      }
+
+      /// Consumer: returns the next record, blocking while the ring is empty.
+      /// Returns an empty span once the ring is closed and drained.
+      std::span<std::byte const> BeginRead() {
+         for (;;) {
+            std::uint64_t const head = WaitForData();
+            if ((head & ~kClosedBit) == tail_cache_) return {};
+            std::size_t const offset = tail_cache_ & (capacity_ - 1);
+            std::uint64_t size;
+            std::memcpy(&size, buffer_.get() + offset, sizeof(size));
+            if (size == kWrapMarker) {
+               tail_cache_ += capacity_ - offset;
+               continue;
+            }
+            read_size_ = size;
+            return {buffer_.get() + offset + kFrameSize, size};
+         }
+      }
+
+      void EndRead() {
+         tail_cache_ += kFrameSize + AlignUp(read_size_);
+         tail_.store(tail_cache_, std::memory_order_release);
+         tail_.notify_one();
+      }
+
+      /// Producer: no more records will be written. Wakes the consumer.
+      void Close() {
+         head_.fetch_or(kClosedBit, std::memory_order_release);
+         head_.notify_one();
+      }
+
+   private:
+      static constexpr std::size_t kFrameSize = 8;
+      static constexpr std::uint64_t kWrapMarker = ~std::uint64_t{0};
+      static constexpr std::uint64_t kClosedBit = std::uint64_t{1} << 63;
+
+      static std::size_t AlignUp(std::size_t size) {
+         return (size + kAlignment - 1) & ~(kAlignment - 1);
+      }
+
+      void WriteFrame(std::size_t offset, std::uint64_t size) {
+         std::memcpy(buffer_.get() + offset, &size, sizeof(size));
+      }
+
+      void WaitForSpace(std::uint64_t head, std::size_t bytes) {
+         // The cached tail only moves forward, so it is refreshed only when
+         // the ring looks full
+         while (head + bytes - tail_for_producer_ > capacity_) {
+            std::uint64_t const tail = tail_.load(std::memory_order_acquire);
+            if (tail == tail_for_producer_) {
+               tail_.wait(tail, std::memory_order_acquire);
+               continue;
+            }
+            tail_for_producer_ = tail;
+         }
+      }
+
+      std::uint64_t WaitForData() {
+         for (;;) {
+            std::uint64_t const head = head_.load(std::memory_order_acquire);
+            if ((head & ~kClosedBit) != tail_cache_ || (head & kClosedBit)) return head;
+            head_.wait(head, std::memory_order_acquire);
+         }
+      }
+
+      std::size_t const capacity_;
+      std::unique_ptr<std::byte[]> buffer_;
+
+      // Producer side
+      alignas(64) std::atomic<std::uint64_t> head_{0};
+      std::uint64_t tail_for_producer_ = 0;
+      std::uint64_t pending_pos_ = 0;
+      std::size_t pending_size_ = 0;
+
+      // Consumer side
+      alignas(64) std::atomic<std::uint64_t> tail_{0};
+      std::uint64_t tail_cache_ = 0;
+      std::size_t read_size_ = 0;
+   };
+
+} // namespace vertexsim
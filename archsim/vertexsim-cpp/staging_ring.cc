@@ -0,0 +1,35 @@
+#include "staging_ring.h"
+
+namespace vertexsim {
+
+   std::optional<std::size_t> StagingRing::TryAllocate(std::size_t size,
+                                                       std::uint64_t fence_value) {
+      if (size == 0 || size > size_) return std::nullopt;
+      std::optional<std::size_t> begin;
+      if (live_.empty()) {
+         begin = 0;
+      } else {
+         std::size_t const tail = live_.front().begin;
+         if (head_ > tail) {
+            // Free space is [head, size) and [0, tail)
+            if (size_ - head_ >= size)
+               begin = head_;
+            else if (tail >= size)
+               begin = 0;
+         } else if (tail - head_ >= size) {
+            // Wrapped: the only free space is [head, tail)
+            begin = head_;
+         }
+      }
+      if (!begin) return std::nullopt;
+      head_ = *begin + size;
+      live_.push_back({*begin, head_, fence_value});
+      return begin;
+   }
+
+   void StagingRing::Retire(std::uint64_t completed) {
+      while (!live_.empty() && live_.front().fence_value <= completed) live_.pop_front();
+      if (live_.empty()) head_ = 0;
+   }
+
+} // namespace vertexsim
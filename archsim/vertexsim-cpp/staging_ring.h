@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+namespace vertexsim {
+
+   /// Ring allocator over a persistent staging buffer. Every allocation is
+   /// tagged with the copy fence value after which the copy engine is done
+   /// reading it, and Retire() frees allocations in order as that fence
+   /// advances. Allocations are contiguous; a request that does not fit
+   /// before the end of the buffer wraps around to its start. Not
+   /// thread-safe.
+   class StagingRing {
+   public:
+      explicit StagingRing(std::size_t size) : size_{size} {}
+
+      std::size_t size() const { return size_; }
+
+      /// Offset of `size` free bytes, or nullopt until older allocations
+      /// are retired.
+      std::optional<std::size_t> TryAllocate(std::size_t size, std::uint64_t fence_value);
+
+      /// Frees the allocations whose fence value is at most `completed`.
+      void Retire(std::uint64_t completed);
+
+      /// Fence value that frees the oldest allocation.
+      std::optional<std::uint64_t> oldest_fence_value() const {
+         if (live_.empty()) return std::nullopt;
+         return live_.front().fence_value;
+      }
+
+   private:
+      struct Allocation {
+         std::size_t begin;
+         std::size_t end;
+         std::uint64_t fence_value;
+      };
+
+      std::size_t size_;
+      // Where the next allocation goes when it fits before the end
+      std::size_t head_ = 0;
+      std::deque<Allocation> live_;
+   };
+
+} // namespace vertexsim
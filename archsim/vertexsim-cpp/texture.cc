@@ -0,0 +1,274 @@
+#include "texture.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "mapped_file.h"
+
+namespace vertexsim {
+
+   namespace {
+
+      constexpr std::array<char, 8> kGtexMagic = {'V', 'S', 'G', 'T', 'E', 'X', '\0', '\0'};
+      constexpr std::uint32_t kGtexVersion = 1;
+      constexpr std::size_t kGtexPayloadOffset = 64;
+
+      struct GtexHeader {
+         std::array<char, 8> magic;
+         std::uint32_t version;
+         std::uint32_t width;
+         std::uint32_t height;
+         std::uint32_t reserved;
+         std::uint64_t source_size;
+         std::int64_t source_mtime;
+         std::uint64_t texel_count;
+      };
+      static_assert(sizeof(GtexHeader) <= kGtexPayloadOffset);
+      static_assert(std::endian::native == std::endian::little,
+                    ".gtex files are little-endian and mapped without conversion");
+
+      struct TextureSource {
+         std::uint64_t size;
+         std::int64_t mtime;
+      };
+
+      TextureSource SourceOf(std::filesystem::path const& image_path) {
+         return {std::filesystem::file_size(image_path),
+                 std::filesystem::last_write_time(image_path).time_since_epoch().count()};
+      }
+
+      std::size_t TexelCount(std::span<TextureLevel const> levels) {
+         TextureLevel const& last = levels.back();
+         return last.offset + std::size_t{last.tiles_x} * last.tiles_y * kTextureTileTexels;
+      }
+
+      std::uint32_t Average(std::uint32_t a, std::uint32_t b, std::uint32_t c, std::uint32_t d) {
+         std::uint32_t result = 0;
+         for (int shift = 0; shift < 32; shift += 8) {
+            std::uint32_t const sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) +
+                                      ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+            result |= ((sum + 2) / 4) << shift;
+         }
+         return result;
+      }
+
+      std::vector<std::uint32_t> Downsample(std::uint32_t width, std::uint32_t height,
+                                            std::span<std::uint32_t const> src) {
+         std::uint32_t const w = std::max(width / 2, 1u);
+         std::uint32_t const h = std::max(height / 2, 1u);
+         std::vector<std::uint32_t> dst(std::size_t{w} * h);
+         for (std::uint32_t y = 0; y < h; ++y) {
+            std::size_t const y0 = std::size_t{2 * y} * width;
+            std::size_t const y1 = std::size_t{std::min(2 * y + 1, height - 1)} * width;
+            for (std::uint32_t x = 0; x < w; ++x) {
+               std::uint32_t const x0 = 2 * x;
+               std::uint32_t const x1 = std::min(2 * x + 1, width - 1);
+               dst[std::size_t{y} * w + x] =
+                     Average(src[y0 + x0], src[y0 + x1], src[y1 + x0], src[y1 + x1]);
+            }
+         }
+         return dst;
+      }
+
+      /// Copies a row-major image into `level`. Texels of partial edge tiles
+      /// repeat the nearest edge texel so filtering across them stays sane.
+      void Tile(TextureLevel const& level, std::span<std::uint32_t const> src,
+                std::uint32_t* dst) {
+         for (std::uint32_t ty = 0; ty < level.tiles_y; ++ty) {
+            for (std::uint32_t tx = 0; tx < level.tiles_x; ++tx) {
+               for (std::uint32_t i = 0; i < kTextureTileTexels; ++i) {
+                  std::uint32_t const x =
+                        std::min(tx * kTextureTileSize + i % kTextureTileSize, level.width - 1);
+                  std::uint32_t const y =
+                        std::min(ty * kTextureTileSize + i / kTextureTileSize, level.height - 1);
+                  *dst++ = src[std::size_t{y} * level.width + x];
+               }
+            }
+         }
+      }
+
+   } // namespace
+
+   Texture::Texture(std::uint32_t width, std::uint32_t height, std::vector<std::uint32_t> texels) {
+      auto owned = std::make_shared<std::vector<std::uint32_t>>(std::move(texels));
+      std::span<std::uint32_t const> const view = *owned;
+      *this = Texture{width, height, view, std::move(owned)};
+   }
+
+   Texture::Texture(std::uint32_t width, std::uint32_t height,
+                    std::span<std::uint32_t const> texels, std::shared_ptr<void const> owner)
+         : width_{width},
+           height_{height},
+           levels_{Levels(width, height)},
+           texels_{texels},
+           owner_{std::move(owner)} {
+      if (texels.size() != TexelCount(levels_))
+         throw std::invalid_argument("Texel count does not match the texture size");
+   }
+
+   std::vector<TextureLevel> Texture::Levels(std::uint32_t width, std::uint32_t height) {
+      if (width == 0 || height == 0) throw std::invalid_argument("Texture has no texels");
+      std::vector<TextureLevel> levels;
+      std::size_t offset = 0;
+      for (;;) {
+         TextureLevel level;
+         level.width = width;
+         level.height = height;
+         level.tiles_x = (width + kTextureTileSize - 1) / kTextureTileSize;
+         level.tiles_y = (height + kTextureTileSize - 1) / kTextureTileSize;
+         level.offset = offset;
+         levels.push_back(level);
+         offset += std::size_t{level.tiles_x} * level.tiles_y * kTextureTileTexels;
+         if (width == 1 && height == 1) return levels;
+         width = std::max(width / 2, 1u);
+         height = std::max(height / 2, 1u);
+      }
+   }
+
+   Texture Texture::FromImage(std::uint32_t width, std::uint32_t height,
+                              std::span<std::uint32_t const> rgba) {
+      auto const levels = Levels(width, height);
+      if (rgba.size() != std::size_t{width} * height)
+         throw std::invalid_argument("Image size does not match its dimensions");
+      std::vector<std::uint32_t> texels(TexelCount(levels));
+      std::vector<std::uint32_t> image;
+      std::span<std::uint32_t const> src = rgba;
+      for (std::size_t i = 0; i < levels.size(); ++i) {
+         if (i > 0) {
+            image = Downsample(levels[i - 1].width, levels[i - 1].height, src);
+            src = image;
+         }
+         Tile(levels[i], src, texels.data() + levels[i].offset);
+      }
+      return Texture{width, height, std::move(texels)};
+   }
+
+   std::filesystem::path TextureCachePath(std::filesystem::path const& image_path) {
+      auto path = image_path;
+      path += ".gtex";
+      return path;
+   }
+
+   std::optional<Texture> ReadTextureCache(std::filesystem::path const& image_path) {
+      auto const cache_path = TextureCachePath(image_path);
+      std::error_code ec;
+      if (!std::filesystem::is_regular_file(cache_path, ec)) return std::nullopt;
+
+      auto file = std::make_shared<MappedFile>(cache_path);
+      if (file->size() < kGtexPayloadOffset) return std::nullopt;
+      GtexHeader header;
+      std::memcpy(&header, file->data(), sizeof(header));
+      if (header.magic != kGtexMagic || header.version != kGtexVersion) return std::nullopt;
+      TextureSource const source = SourceOf(image_path);
+      if (header.source_size != source.size || header.source_mtime != source.mtime)
+         return std::nullopt;
+      if (header.width == 0 || header.height == 0 ||
+          header.texel_count != TexelCount(Texture::Levels(header.width, header.height)) ||
+          (file->size() - kGtexPayloadOffset) / sizeof(std::uint32_t) < header.texel_count)
+         return std::nullopt;
+
+      auto const* texels =
+            reinterpret_cast<std::uint32_t const*>(file->data() + kGtexPayloadOffset);
+      return Texture{header.width, header.height, {texels, header.texel_count}, std::move(file)};
+   }
+
+   void WriteTextureCache(std::filesystem::path const& image_path, Texture const& texture) {
+      TextureSource const source = SourceOf(image_path);
+      GtexHeader header{};
+      header.magic = kGtexMagic;
+      header.version = kGtexVersion;
+      header.width = texture.width();
+      header.height = texture.height();
+      header.source_size = source.size;
+      header.source_mtime = source.mtime;
+      header.texel_count = texture.texels().size();
+
+      std::array<char, kGtexPayloadOffset> prefix{};
+      std::memcpy(prefix.data(), &header, sizeof(header));
+
+      ReplaceFile(TextureCachePath(image_path), "texture cache",
+                  {std::as_bytes(std::span{prefix}), std::as_bytes(texture.texels())});
+   }
+
+   Texture DecodeTexture(std::filesystem::path const& image_path) {
+      MappedFile const file{image_path};
+      if (file.size() > INT32_MAX) throw std::runtime_error(image_path.string() + ": too large");
+      int width, height, channels;
+      // stbi_load_from_memory is reentrant; only its flip and conversion
+      // settings are global, and those are left at their defaults
+      stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(file.data()),
+                                              static_cast<int>(file.size()), &width, &height,
+                                              &channels, 4);
+      if (!pixels)
+         throw std::runtime_error(image_path.string() + ": " + stbi_failure_reason());
+      std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> owner{pixels, &stbi_image_free};
+
+      std::vector<std::uint32_t> rgba(static_cast<std::size_t>(width) * height);
+      std::memcpy(rgba.data(), pixels, rgba.size() * sizeof(std::uint32_t));
+      return Texture::FromImage(static_cast<std::uint32_t>(width),
+                                static_cast<std::uint32_t>(height), rgba);
+   }
+
+   std::vector<Texture> LoadTextures(std::span<std::filesystem::path const> paths,
+                                     unsigned threads, TextureLoadStats* stats) {
+      if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+      threads = static_cast<unsigned>(std::clamp<std::size_t>(paths.size(), 1, threads));
+
+      std::vector<Texture> textures(paths.size());
+      std::vector<std::exception_ptr> errors(paths.size());
+      std::atomic<std::size_t> next{0};
+      std::atomic<std::size_t> decoded{0};
+      std::mutex warn_mutex;
+      {
+         // Images vary wildly in size, so workers pull them one at a time
+         // instead of taking fixed shares
+         std::vector<std::jthread> workers;
+         for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&] {
+               for (std::size_t i; (i = next.fetch_add(1)) < paths.size();) {
+                  try {
+                     if (auto cached = ReadTextureCache(paths[i])) {
+                        textures[i] = std::move(*cached);
+                        continue;
+                     }
+                     textures[i] = DecodeTexture(paths[i]);
+                     decoded.fetch_add(1);
+                     try {
+                        WriteTextureCache(paths[i], textures[i]);
+                     } catch (std::exception const& e) {
+                        std::lock_guard lock{warn_mutex};
+                        std::cerr << "Warning: " << e.what() << std::endl;
+                     }
+                  } catch (...) {
+                     errors[i] = std::current_exception();
+                  }
+               }
+            });
+         }
+      }
+      // Report the first failing path in input order, so errors are stable
+      for (auto const& error : errors)
+         if (error) std::rethrow_exception(error);
+
+      if (stats) {
+         stats->decoded = decoded;
+         stats->cached = paths.size() - decoded;
+         stats->bytes = 0;
+         for (Texture const& texture : textures) stats->bytes += texture.texels().size_bytes();
+      }
+      return textures;
+   }
+
+} // namespace vertexsim
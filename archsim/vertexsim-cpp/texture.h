@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace vertexsim {
+
+   /// Texels are stored in 4x4 tiles of 64 bytes, so a bilinear footprint
+   /// usually touches a single cache line.
+   inline constexpr std::uint32_t kTextureTileSize = 4;
+   inline constexpr std::uint32_t kTextureTileTexels = kTextureTileSize * kTextureTileSize;
+
+   struct TextureLevel {
+      std::uint32_t width = 0;
+      std::uint32_t height = 0;
+      std::uint32_t tiles_x = 0;
+      std::uint32_t tiles_y = 0;
+      // In texels from the start of the texture
+      std::size_t offset = 0;
+   };
+
+   /// RGBA8 image with its full mip chain down to 1x1. Each level is a
+   /// row-major grid of tiles, and texels within a tile are row-major too.
+   /// Texels pack R in the low byte. Copies share the texel storage.
+   class Texture {
+   public:
+      Texture() = default;
+      /// Takes texels laid out as described by Levels(width, height).
+      Texture(std::uint32_t width, std::uint32_t height, std::vector<std::uint32_t> texels);
+      /// Views externally owned texels, e.g. a mapped cache file. `owner` is
+      /// kept alive for the lifetime of the texture.
+      Texture(std::uint32_t width, std::uint32_t height, std::span<std::uint32_t const> texels,
+              std::shared_ptr<void const> owner);
+
+      /// Mip chain layout of a `width` x `height` texture.
+      static std::vector<TextureLevel> Levels(std::uint32_t width, std::uint32_t height);
+
+      /// Builds the tiled mip chain from a row-major RGBA8 image. Each level
+      /// halves the previous one, rounding down, with a 2x2 box filter.
+      static Texture FromImage(std::uint32_t width, std::uint32_t height,
+                               std::span<std::uint32_t const> rgba);
+
+      std::uint32_t width() const { return width_; }
+      std::uint32_t height() const { return height_; }
+      std::span<TextureLevel const> levels() const { return levels_; }
+      std::span<std::uint32_t const> texels() const { return texels_; }
+
+      std::uint32_t Texel(std::size_t level, std::uint32_t x, std::uint32_t y) const {
+         TextureLevel const& l = levels_[level];
+         std::size_t const tile =
+               std::size_t{y / kTextureTileSize} * l.tiles_x + x / kTextureTileSize;
+         return texels_[l.offset + tile * kTextureTileTexels +
+                        (y % kTextureTileSize) * kTextureTileSize + x % kTextureTileSize];
+      }
+
+   private:
+      std::uint32_t width_ = 0;
+      std::uint32_t height_ = 0;
+      std::vector<TextureLevel> levels_;
+      std::span<std::uint32_t const> texels_;
+      std::shared_ptr<void const> owner_;
+   };
+
+   /// `bricks.png` caches to `bricks.png.gtex` next to it, so images that
+   /// differ only in extension do not collide.
+   std::filesystem::path TextureCachePath(std::filesystem::path const& image_path);
+
+   /// Maps the cache for `image_path` and returns the texture stored in it.
+   /// Returns nullopt if the cache is missing, malformed, from another format
+   /// version or older than the image.
+   std::optional<Texture> ReadTextureCache(std::filesystem::path const& image_path);
+
+   /// Writes `texture` as the cache for `image_path`, replacing the file
+   /// atomically.
+   void WriteTextureCache(std::filesystem::path const& image_path, Texture const& texture);
+
+   /// Decodes an image file (PNG, JPEG, TGA, BMP, ...) into a texture.
+   Texture DecodeTexture(std::filesystem::path const& image_path);
+
+   struct TextureLoadStats {
+      std::size_t decoded = 0;
+      std::size_t cached = 0;
+      std::size_t bytes = 0;
+   };
+
+   /// Loads every image through its .gtex cache, decoding and caching the
+   /// ones that miss. Images are spread over `threads` workers (zero picks the
+   /// hardware concurrency); the result is in the order of `paths`. Failing
+   /// to write a cache is not an error.
+   std::vector<Texture> LoadTextures(std::span<std::filesystem::path const> paths,
+                                     unsigned threads = 0, TextureLoadStats* stats = nullptr);
+
+} // namespace vertexsim
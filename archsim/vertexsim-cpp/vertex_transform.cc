@@ -0,0 +1,131 @@
+#include "vertex_transform.h"
+
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace vertexsim {
+
+   namespace {
+
+      /// The viewport as a per-axis scale and offset from NDC.
+      struct ViewportScale {
+         std::array<float, 3> scale;
+         std::array<float, 3> offset;
+      };
+
+      ViewportScale ScaleOf(Viewport const& v) {
+         return {{v.width * 0.5f, v.height * 0.5f, (v.max_depth - v.min_depth) * 0.5f},
+                 {v.x + v.width * 0.5f, v.y + v.height * 0.5f,
+                  (v.max_depth + v.min_depth) * 0.5f}};
+      }
+
+      float* Out(TransformedStreams const& out, TransformedStream s) {
+         return out[static_cast<std::size_t>(s)].data();
+      }
+
+      void TransformScalar(glm::mat4 const& m, ViewportScale const& vp,
+                           PositionStreams const& in, std::size_t i,
+                           TransformedStreams const& out) {
+         glm::vec4 const clip = m * glm::vec4{in[0][i], in[1][i], in[2][i], 1.0f};
+         float const inv_w = 1.0f / clip.w;
+         Out(out, TransformedStream::kClipX)[i] = clip.x;
+         Out(out, TransformedStream::kClipY)[i] = clip.y;
+         Out(out, TransformedStream::kClipZ)[i] = clip.z;
+         Out(out, TransformedStream::kClipW)[i] = clip.w;
+         Out(out, TransformedStream::kWindowX)[i] = clip.x * inv_w * vp.scale[0] + vp.offset[0];
+         Out(out, TransformedStream::kWindowY)[i] = clip.y * inv_w * vp.scale[1] + vp.offset[1];
+         Out(out, TransformedStream::kWindowZ)[i] = clip.z * inv_w * vp.scale[2] + vp.offset[2];
+         Out(out, TransformedStream::kInvW)[i] = inv_w;
+      }
+
+#if defined(__AVX512F__)
+      constexpr std::size_t kBatch = 16;
+
+      /// Transforms the 16 vertices starting at `i`. Once this is inlined into
+      /// the batch loop the matrix and viewport broadcasts are hoisted out.
+      void Transform16(glm::mat4 const& m, ViewportScale const& vp, PositionStreams const& in,
+                       std::size_t i, TransformedStreams const& out) {
+         __m512 const x = _mm512_loadu_ps(in[0].data() + i);
+         __m512 const y = _mm512_loadu_ps(in[1].data() + i);
+         __m512 const z = _mm512_loadu_ps(in[2].data() + i);
+         // Row r of the clip position: m[0][r] x + m[1][r] y + m[2][r] z + m[3][r]
+         auto const row = [&](int r) {
+            __m512 v = _mm512_fmadd_ps(_mm512_set1_ps(m[2][r]), z, _mm512_set1_ps(m[3][r]));
+            v = _mm512_fmadd_ps(_mm512_set1_ps(m[1][r]), y, v);
+            return _mm512_fmadd_ps(_mm512_set1_ps(m[0][r]), x, v);
+         };
+         __m512 const cx = row(0), cy = row(1), cz = row(2), cw = row(3);
+         __m512 const inv_w = _mm512_div_ps(_mm512_set1_ps(1.0f), cw);
+         auto const window = [&](__m512 c, int axis) {
+            return _mm512_fmadd_ps(_mm512_mul_ps(c, inv_w), _mm512_set1_ps(vp.scale[axis]),
+                                   _mm512_set1_ps(vp.offset[axis]));
+         };
+         _mm512_storeu_ps(Out(out, TransformedStream::kClipX) + i, cx);
+         _mm512_storeu_ps(Out(out, TransformedStream::kClipY) + i, cy);
+         _mm512_storeu_ps(Out(out, TransformedStream::kClipZ) + i, cz);
+         _mm512_storeu_ps(Out(out, TransformedStream::kClipW) + i, cw);
+         _mm512_storeu_ps(Out(out, TransformedStream::kWindowX) + i, window(cx, 0));
+         _mm512_storeu_ps(Out(out, TransformedStream::kWindowY) + i, window(cy, 1));
+         _mm512_storeu_ps(Out(out, TransformedStream::kWindowZ) + i, window(cz, 2));
+         _mm512_storeu_ps(Out(out, TransformedStream::kInvW) + i, inv_w);
+      }
+#elif defined(__AVX2__)
+      constexpr std::size_t kBatch = 8;
+
+      /// Transforms the 8 vertices starting at `i`.
+      void Transform8(glm::mat4 const& m, ViewportScale const& vp, PositionStreams const& in,
+                      std::size_t i, TransformedStreams const& out) {
+         __m256 const x = _mm256_loadu_ps(in[0].data() + i);
+         __m256 const y = _mm256_loadu_ps(in[1].data() + i);
+         __m256 const z = _mm256_loadu_ps(in[2].data() + i);
+         auto const row = [&](int r) {
+            __m256 v = _mm256_fmadd_ps(_mm256_set1_ps(m[2][r]), z, _mm256_set1_ps(m[3][r]));
+            v = _mm256_fmadd_ps(_mm256_set1_ps(m[1][r]), y, v);
+            return _mm256_fmadd_ps(_mm256_set1_ps(m[0][r]), x, v);
+         };
+         __m256 const cx = row(0), cy = row(1), cz = row(2), cw = row(3);
+         __m256 const inv_w = _mm256_div_ps(_mm256_set1_ps(1.0f), cw);
+         auto const window = [&](__m256 c, int axis) {
+            return _mm256_fmadd_ps(_mm256_mul_ps(c, inv_w), _mm256_set1_ps(vp.scale[axis]),
+                                   _mm256_set1_ps(vp.offset[axis]));
+         };
+         _mm256_storeu_ps(Out(out, TransformedStream::kClipX) + i, cx);
+         _mm256_storeu_ps(Out(out, TransformedStream::kClipY) + i, cy);
+         _mm256_storeu_ps(Out(out, TransformedStream::kClipZ) + i, cz);
+         _mm256_storeu_ps(Out(out, TransformedStream::kClipW) + i, cw);
+         _mm256_storeu_ps(Out(out, TransformedStream::kWindowX) + i, window(cx, 0));
+         _mm256_storeu_ps(Out(out, TransformedStream::kWindowY) + i, window(cy, 1));
+         _mm256_storeu_ps(Out(out, TransformedStream::kWindowZ) + i, window(cz, 2));
+         _mm256_storeu_ps(Out(out, TransformedStream::kInvW) + i, inv_w);
+      }
+#else
+      constexpr std::size_t kBatch = 1;
+#endif
+
+   } // namespace
+
+   std::size_t TransformBatchWidth() { return kBatch; }
+
+   void TransformVertices(glm::mat4 const& mvp, Viewport const& viewport,
+                          PositionStreams const& positions, TransformedStreams const& out) {
+      std::size_t const count = positions[0].size();
+      if (positions[1].size() != count || positions[2].size() != count)
+         throw std::invalid_argument("Position streams differ in length");
+      for (auto const& stream : out)
+         if (stream.size() < count)
+            throw std::invalid_argument("Transformed stream is too small");
+
+      ViewportScale const vp = ScaleOf(viewport);
+      std::size_t i = 0;
+#if defined(__AVX512F__)
+      for (; i + kBatch <= count; i += kBatch) Transform16(mvp, vp, positions, i, out);
+#elif defined(__AVX2__)
+      for (; i + kBatch <= count; i += kBatch) Transform8(mvp, vp, positions, i, out);
+#endif
+      for (; i < count; ++i) TransformScalar(mvp, vp, positions, i, out);
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+
+namespace vertexsim {
+
+   /// Window rectangle and depth range, OpenGL-style: y points up and NDC
+   /// depth [-1, 1] maps onto [min_depth, max_depth].
+   struct Viewport {
+      float x = 0;
+      float y = 0;
+      float width = 1;
+      float height = 1;
+      float min_depth = 0;
+      float max_depth = 1;
+   };
+
+   /// Output streams of the transform stage. Clip coordinates are kept for
+   /// clipping; window coordinates and 1/w are only meaningful for vertices
+   /// with w > 0, the clipper owns primitives with any other vertex.
+   enum class TransformedStream : std::uint8_t {
+      kClipX,
+      kClipY,
+      kClipZ,
+      kClipW,
+      kWindowX,
+      kWindowY,
+      kWindowZ,
+      // For perspective-correct interpolation
+      kInvW,
+   };
+   inline constexpr std::size_t kTransformedStreamCount = 8;
+
+   /// Object-space positions, one stream per axis.
+   using PositionStreams = std::array<std::span<float const>, 3>;
+   /// Indexed by TransformedStream. Each span must hold as many vertices as
+   /// the input.
+   using TransformedStreams = std::array<std::span<float>, kTransformedStreamCount>;
+
+   /// Vertices processed per instruction by TransformVertices() in this
+   /// build: 16 with AVX-512, 8 with AVX2, otherwise 1.
+   std::size_t TransformBatchWidth();
+
+   /// Transforms `positions` by `mvp`, then applies the perspective divide
+   /// and the viewport transform. Works on whole SIMD batches of the SoA
+   /// streams and finishes the remainder one vertex at a time.
+   void TransformVertices(glm::mat4 const& mvp, Viewport const& viewport,
+                          PositionStreams const& positions, TransformedStreams const& out);
+
+} // namespace vertexsim
@@ -0,0 +1,139 @@
+#include "welder.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <vector>
+
+namespace vertexsim {
+
+   namespace {
+
+      std::uint32_t HashCorner(ObjCorner const& c) {
+         std::uint64_t h = static_cast<std::uint32_t>(c.v) * 0x9E3779B97F4A7C15u;
+         h ^= static_cast<std::uint32_t>(c.vt) * 0xC2B2AE3D27D4EB4Fu;
+         h ^= static_cast<std::uint32_t>(c.vn) * 0x165667B19E3779F9u;
+         h ^= h >> 32;
+         return static_cast<std::uint32_t>(h);
+      }
+
+      bool operator==(ObjCorner const& a, ObjCorner const& b) {
+         return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+      }
+
+      constexpr std::uint64_t kEmpty = ~std::uint64_t{0};
+
+      std::uint64_t Pack(std::uint32_t hash, std::uint32_t vertex) {
+         return (std::uint64_t{hash} << 32) | vertex;
+      }
+
+   } // namespace
+
+   VertexWelder::VertexWelder(std::size_t expected_vertices)
+         : slots_(std::bit_ceil(std::max<std::size_t>(expected_vertices * 2, 64)), kEmpty) {
+      vertices_.reserve(expected_vertices);
+   }
+
+   std::uint32_t VertexWelder::Add(ObjCorner const& corner) {
+      std::uint32_t const hash = HashCorner(corner);
+      std::size_t const mask = slots_.size() - 1;
+      for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+         std::uint64_t const slot = slots_[i];
+         if (slot == kEmpty) {
+            if (vertices_.size() >= UINT32_MAX)
+               throw std::runtime_error("Mesh has too many unique vertices");
+            auto const vertex = static_cast<std::uint32_t>(vertices_.size());
+            vertices_.push_back(corner);
+            slots_[i] = Pack(hash, vertex);
+            // Keep the load factor at or below 1/2
+            if (vertices_.size() * 2 > slots_.size()) Grow();
+            return vertex;
+         }
+         auto const vertex = static_cast<std::uint32_t>(slot);
+         if (static_cast<std::uint32_t>(slot >> 32) == hash && vertices_[vertex] == corner)
+            return vertex;
+      }
+   }
+
+   void VertexWelder::Clear() {
+      std::fill(slots_.begin(), slots_.end(), kEmpty);
+      vertices_.clear();
+   }
+
+   void VertexWelder::Grow() {
+      std::vector<std::uint64_t> old(slots_.size() * 2, kEmpty);
+      old.swap(slots_);
+      std::size_t const mask = slots_.size() - 1;
+      for (std::uint64_t const slot : old) {
+         if (slot == kEmpty) continue;
+         std::size_t i = (slot >> 32) & mask;
+         while (slots_[i] != kEmpty) i = (i + 1) & mask;
+         slots_[i] = slot;
+      }
+   }
+
+   IndexedMesh PackWeldedMesh(std::span<ObjCorner const> vertices,
+                              std::span<std::uint32_t const> indices,
+                              std::span<glm::vec3 const> positions,
+                              std::span<glm::vec3 const> normals,
+                              std::span<glm::vec2 const> texcoords,
+                              std::optional<IndexFormat> format) {
+      if (vertices.size() > UINT32_MAX)
+         throw std::runtime_error("Mesh has too many unique vertices");
+      auto const vertex_count = static_cast<std::uint32_t>(vertices.size());
+      if (!format)
+         format = vertex_count < kMaxUint16Vertices ? IndexFormat::kUint16 : IndexFormat::kUint32;
+      else if (*format == IndexFormat::kUint16 && vertex_count >= kMaxUint16Vertices)
+         throw std::invalid_argument("Mesh has too many vertices for 16-bit indices");
+
+      bool const has_normals = !normals.empty();
+      bool const has_texcoords = !texcoords.empty();
+      IndexedMesh mesh{MeshLayout::Compute(vertex_count, indices.size(), *format, has_normals,
+                                           has_texcoords)};
+      auto px = mesh.stream(VertexStream::kPositionX);
+      auto py = mesh.stream(VertexStream::kPositionY);
+      auto pz = mesh.stream(VertexStream::kPositionZ);
+      auto nx = mesh.stream(VertexStream::kNormalX);
+      auto ny = mesh.stream(VertexStream::kNormalY);
+      auto nz = mesh.stream(VertexStream::kNormalZ);
+      auto tu = mesh.stream(VertexStream::kTexcoordU);
+      auto tv = mesh.stream(VertexStream::kTexcoordV);
+      for (std::size_t i = 0; i < vertices.size(); ++i) {
+         ObjCorner const& c = vertices[i];
+         glm::vec3 const p = positions[c.v];
+         px[i] = p.x;
+         py[i] = p.y;
+         pz[i] = p.z;
+         // Corners without the attribute keep the zero-initialized default
+         if (has_normals && c.vn >= 0) {
+            glm::vec3 const n = normals[c.vn];
+            nx[i] = n.x;
+            ny[i] = n.y;
+            nz[i] = n.z;
+         }
+         if (has_texcoords && c.vt >= 0) {
+            glm::vec2 const t = texcoords[c.vt];
+            tu[i] = t.x;
+            tv[i] = t.y;
+         }
+      }
+      mesh.VisitIndices([&](auto out) {
+         using T = typename decltype(out)::value_type;
+         for (std::size_t i = 0; i < indices.size(); ++i) out[i] = static_cast<T>(indices[i]);
+      });
+      return mesh;
+   }
+
+   IndexedMesh WeldMesh(ObjMesh const& obj, std::optional<IndexFormat> format) {
+      // Every position is normally used at least once and most meshes have
+      // few seams, so this estimate usually avoids growing the table at all
+      std::size_t const expected =
+            std::max({obj.positions.size(), obj.texcoords.size(), obj.normals.size()}) * 5 / 4;
+      VertexWelder welder{expected};
+      std::vector<std::uint32_t> indices(obj.corners.size());
+      for (std::size_t i = 0; i < obj.corners.size(); ++i) indices[i] = welder.Add(obj.corners[i]);
+      return PackWeldedMesh(welder.vertices(), indices, obj.positions, obj.normals, obj.texcoords,
+                            format);
+   }
+
+} // namespace vertexsim
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "indexed_mesh.h"
+#include "obj_loader.h"
+
+namespace vertexsim {
+
+   /// Index value reserved for primitive restart in 16-bit index buffers, so
+   /// meshes only get 16-bit indices if they have fewer vertices than this.
+   inline constexpr std::uint32_t kMaxUint16Vertices = 0xFFFF;
+
+   /// Open-addressing set of unique (v, vt, vn) triples with linear probing.
+   /// Each slot packs the 32-bit hash next to the vertex number, so probing
+   /// rarely touches the corner array and growing never rehashes a key.
+   class VertexWelder {
+   public:
+      explicit VertexWelder(std::size_t expected_vertices = 0);
+
+      /// Returns the vertex number of `corner`. New corners are numbered in
+      /// order of first use, so a result equal to the previous vertices()
+      /// size means the corner was just added.
+      std::uint32_t Add(ObjCorner const& corner);
+      /// Forgets all vertices but keeps the table allocated.
+      void Clear();
+
+      std::vector<ObjCorner> const& vertices() const { return vertices_; }
+
+   private:
+      void Grow();
+
+      std::vector<std::uint64_t> slots_;
+      std::vector<ObjCorner> vertices_;
+   };
+
+   /// Packs welded vertices into an IndexedMesh: vertex i takes the attributes
+   /// `vertices[i]` points at in `positions`, `normals` and `texcoords`. Empty
+   /// attribute arrays leave the attribute out of the mesh. Without an
+   /// explicit `format` the narrowest index type that fits is picked.
+   IndexedMesh PackWeldedMesh(std::span<ObjCorner const> vertices,
+                              std::span<std::uint32_t const> indices,
+                              std::span<glm::vec3 const> positions,
+                              std::span<glm::vec3 const> normals,
+                              std::span<glm::vec2 const> texcoords,
+                              std::optional<IndexFormat> format = std::nullopt);
+
+   /// Merges OBJ corners that reference the same (v, vt, vn) triple into a
+   /// single vertex, like an input assembler expects, and emits the matching
+   /// index buffer.
+   ///
+   /// Vertices are numbered in order of first use, so the output depends only
+   /// on the corner sequence.
+   IndexedMesh WeldMesh(ObjMesh const& obj, std::optional<IndexFormat> format = std::nullopt);
+
+} // namespace vertexsim